@@ -0,0 +1,167 @@
+#ifndef BACKED_VECTOR_HPP
+#define BACKED_VECTOR_HPP
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <new>
+
+namespace memory {
+namespace map {
+
+/*
+ * Allocator of memory aligned to alignment bytes (e.g. whole cache lines).
+ */
+template <typename T, std::size_t alignment>
+struct aligned_allocator
+{
+    using value_type = T;
+    template <typename U>
+    struct rebind {using other = aligned_allocator<U, alignment>;};
+
+    aligned_allocator() noexcept = default;
+    template <typename U>
+    aligned_allocator([[maybe_unused]] aligned_allocator<U, alignment> const& other) noexcept {}
+
+    T* allocate(std::size_t n) {return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));}
+    void deallocate(T* p, [[maybe_unused]] std::size_t n) noexcept {::operator delete(p, std::align_val_t(alignment));}
+
+    friend bool operator==(aligned_allocator const&, aligned_allocator const&) noexcept {return true;}
+    friend bool operator!=(aligned_allocator const&, aligned_allocator const&) noexcept {return false;}
+};
+
+/*
+ * Contiguous array of trivially copyable elements with the interface of std::vector, which either owns its elements
+ * or is a read-only view over memory owned by someone else (typically a memory-mapped file, kept alive by owner).
+ * Views are never written: the first non-const access copies them into owned storage.
+ * data(), size() and the const accessors do not branch on the mode, ptr and len always describe the elements.
+ * A larger alignment (e.g. 64 for cache lines) applies to the owned elements; views keep the alignment of the
+ * memory they are built on (io::aligned_saver pads vectors to io::alignment bytes).
+ */
+template <typename T, std::size_t alignment = alignof(T)>
+class backed_vector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "[backed_vector] elements must be trivially copyable");
+
+    public:
+        using allocator_type = std::conditional_t<alignment == alignof(T), std::allocator<T>, aligned_allocator<T, alignment>>;
+        using value_type = T;
+        using size_type = std::size_t;
+        using reference = T&;
+        using const_reference = T const&;
+        using iterator = T*;
+        using const_iterator = T const*;
+
+        backed_vector() noexcept : ptr(nullptr), len(0) {}
+        explicit backed_vector(std::size_t n) : owned(n) {sync();}
+        explicit backed_vector(std::size_t n, T const& val) : owned(n, val) {sync();}
+        backed_vector(std::vector<T, allocator_type>&& other) noexcept : owned(std::move(other)) {sync();}
+        backed_vector(T const* data, std::size_t n, std::shared_ptr<void const> owner) noexcept : ptr(data), len(n), owner(std::move(owner)) {} // view
+        backed_vector(backed_vector const& other);
+        backed_vector(backed_vector&& other) noexcept;
+        backed_vector& operator=(backed_vector other) noexcept {swap(other); return *this;}
+
+        bool is_view() const noexcept {return static_cast<bool>(owner);}
+        std::size_t size() const noexcept {return len;}
+        bool empty() const noexcept {return len == 0;}
+        std::size_t capacity() const noexcept {return is_view() ? len : owned.capacity();}
+        std::size_t max_size() const noexcept {return owned.max_size();}
+
+        T const* data() const noexcept {return ptr;}
+        T* data() {detach(); return owned.data();}
+        T const& operator[](std::size_t idx) const noexcept {return ptr[idx];}
+        T& operator[](std::size_t idx) {return data()[idx];}
+        T const& at(std::size_t idx) const;
+        T& at(std::size_t idx);
+        T const& front() const noexcept {return ptr[0];}
+        T& front() {return data()[0];}
+        T const& back() const noexcept {return ptr[len - 1];}
+        T& back() {return data()[len - 1];}
+
+        const_iterator cbegin() const noexcept {return ptr;}
+        const_iterator cend() const noexcept {return ptr + len;}
+        const_iterator begin() const noexcept {return cbegin();}
+        const_iterator end() const noexcept {return cend();}
+        iterator begin() {return data();}
+        iterator end() {return data() + len;}
+
+        void reserve(std::size_t capacity) {detach(); owned.reserve(capacity); sync();}
+        void resize(std::size_t size) {detach(); owned.resize(size); sync();}
+        void resize(std::size_t size, T const& val) {detach(); owned.resize(size, val); sync();}
+        void push_back(T const& val) {detach(); owned.push_back(val); sync();}
+        void clear() noexcept {owned.clear(); owner.reset(); sync();}
+        void shrink_to_fit() {detach(); owned.shrink_to_fit(); sync();}
+        void swap(backed_vector& other) noexcept;
+
+    private:
+        std::vector<T, allocator_type> owned;
+        T const* ptr;
+        std::size_t len;
+        std::shared_ptr<void const> owner; // empty iff the elements are owned
+
+        void sync() noexcept {ptr = owned.data(); len = owned.size();}
+        void detach();
+
+        friend bool operator==(backed_vector const& a, backed_vector const& b) {return a.size() == b.size() and std::equal(a.begin(), a.end(), b.begin());}
+        friend bool operator!=(backed_vector const& a, backed_vector const& b) {return not (a == b);}
+        friend bool operator==(backed_vector const& a, std::vector<T> const& b) {return a.size() == b.size() and std::equal(a.begin(), a.end(), b.begin());}
+        friend bool operator!=(backed_vector const& a, std::vector<T> const& b) {return not (a == b);}
+};
+
+template <typename T, std::size_t alignment>
+backed_vector<T, alignment>::backed_vector(backed_vector const& other) : owned(other.owned), ptr(other.ptr), len(other.len), owner(other.owner)
+{
+    if (not is_view()) sync(); // views are shared, owned elements are copied
+}
+
+template <typename T, std::size_t alignment>
+backed_vector<T, alignment>::backed_vector(backed_vector&& other) noexcept : owned(std::move(other.owned)), ptr(other.ptr), len(other.len), owner(std::move(other.owner))
+{
+    other.owned.clear();
+    other.sync();
+}
+
+template <typename T, std::size_t alignment>
+T const&
+backed_vector<T, alignment>::at(std::size_t idx) const
+{
+    if (idx >= len) throw std::out_of_range("[backed_vector] index out of range");
+    return ptr[idx];
+}
+
+template <typename T, std::size_t alignment>
+T&
+backed_vector<T, alignment>::at(std::size_t idx)
+{
+    if (idx >= len) throw std::out_of_range("[backed_vector] index out of range");
+    return data()[idx];
+}
+
+template <typename T, std::size_t alignment>
+void
+backed_vector<T, alignment>::swap(backed_vector& other) noexcept
+{
+    owned.swap(other.owned);
+    std::swap(ptr, other.ptr);
+    std::swap(len, other.len);
+    owner.swap(other.owner);
+}
+
+template <typename T, std::size_t alignment>
+void
+backed_vector<T, alignment>::detach()
+{
+    if (not is_view()) return;
+    owned.assign(ptr, ptr + len);
+    owner.reset();
+    sync();
+}
+
+} // namespace map
+} // namespace memory
+
+#endif // BACKED_VECTOR_HPP
@@ -21,6 +21,11 @@ extern "C" {
 #include <intrin.h>
 #endif
 
+#include "cpu_features.hpp"
+#ifdef BIOLIB_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace bit {
 
 typedef
@@ -325,9 +330,10 @@ constexpr int rank0(T x, std::size_t pos)
     return rank1(~x, pos);
 }
 
-inline int select1(uint64_t x, std::size_t th)
+namespace detail {
+
+inline int select1_broadword(uint64_t x, std::size_t th)
 {
-#ifndef __BMI2__
     // Modified from: Bit Twiddling Hacks
     // https://graphics.stanford.edu/~seander/bithacks.html#SelectPosFromMSBRank
     unsigned int s;       // Output: Resulting position of bit with rank r [1-64]
@@ -361,11 +367,41 @@ inline int select1(uint64_t x, std::size_t th)
     t = (x >> (s - 1)) & 0x1;
     s -= ((t - th) & 256) >> 8;
     return s - 1;
-#else
+}
+
+#ifdef BIOLIB_X86_DISPATCH
+__attribute__((target("bmi,bmi2")))
+inline int select1_pdep(uint64_t x, std::size_t th) noexcept
+{
+    return static_cast<int>(_tzcnt_u64(_pdep_u64(1ULL << th, x)));
+}
+
+/* 
+ * Resolved during static initialization, so that select1 pays a predictable branch and no guard.
+ * Static initializers of other translation units may run first and see false: they fall back to the broadword code.
+ */
+inline const bool use_pdep = cpu::has_fast_pdep();
+#endif
+
+} // namespace detail
+
+/*
+ * Position of the th (0-based) one of x.
+ * Builds with BMI2 enabled use pdep/tzcnt directly.
+ * Portable x86-64 builds select pdep/tzcnt at start-up if the host has them (and they are fast), broadword code otherwise.
+ */
+inline int select1(uint64_t x, std::size_t th)
+{
+#if defined(__BMI2__)
     uint64_t i = 1ULL << th;
     asm("pdep %[x], %[mask], %[x]" : [x] "+r"(x) : [mask] "r"(i));
     asm("tzcnt %[bit], %[index]" : [index] "=r"(i) : [bit] "g"(x) : "cc");
     return i;
+#elif defined(BIOLIB_X86_DISPATCH)
+    if (detail::use_pdep) return detail::select1_pdep(x, th);
+    return detail::select1_broadword(x, th);
+#else
+    return detail::select1_broadword(x, th);
 #endif
 }
 
@@ -376,6 +412,280 @@ inline int select0(uint64_t x, std::size_t th)
 
 // ------------------------------------- Vectors -------------------------------------------
 
+namespace detail {
+
+typedef std::size_t (*popcount_kernel_t)(uint64_t const*, std::size_t);
+
+inline std::size_t popcount_words_scalar(uint64_t const* words, std::size_t n) noexcept
+{
+    std::size_t popc = 0;
+    for (std::size_t i = 0; i < n; ++i) popc += popcount(words[i]);
+    return popc;
+}
+
+#ifdef BIOLIB_X86_DISPATCH
+__attribute__((target("popcnt")))
+inline std::size_t popcount_words_popcnt(uint64_t const* words, std::size_t n) noexcept
+{
+    std::size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0; // independent chains (popcnt has a false dependency on its output on some cores)
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        c0 += __builtin_popcountll(words[i]);
+        c1 += __builtin_popcountll(words[i + 1]);
+        c2 += __builtin_popcountll(words[i + 2]);
+        c3 += __builtin_popcountll(words[i + 3]);
+    }
+    for (; i < n; ++i) c0 += __builtin_popcountll(words[i]);
+    return c0 + c1 + c2 + c3;
+}
+
+__attribute__((target("popcnt")))
+inline std::size_t intersect_count_words_popcnt(uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    std::size_t c0 = 0, c1 = 0;
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        c0 += __builtin_popcountll(a[i] & b[i]);
+        c1 += __builtin_popcountll(a[i + 1] & b[i + 1]);
+    }
+    if (i < n) c0 += __builtin_popcountll(a[i] & b[i]);
+    return c0 + c1;
+}
+
+/* Per-byte popcounts: nibble look-up with vpshufb */
+__attribute__((target("avx2")))
+inline __m256i popcount_bytes_avx2(__m256i v) noexcept
+{
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+    return _mm256_add_epi8(lo, hi);
+}
+
+/* 
+ * Byte counts summed into 64-bit lanes by vpsadbw.
+ * W. Mula, N. Kurz, D. Lemire, Faster Population Counts Using AVX2 Instructions, The Computer Journal 61(1), 2018.
+ */
+__attribute__((target("avx2,popcnt")))
+inline std::size_t popcount_words_avx2(uint64_t const* words, std::size_t n) noexcept
+{
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    while (i + 4 <= n) { // up to 16 byte counts (at most 8 each) are added before widening them with vpsadbw
+        __m256i local = _mm256_setzero_si256();
+        for (std::size_t j = 0; j < 16 and i + 4 <= n; ++j, i += 4) {
+            local = _mm256_add_epi8(local, popcount_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(words + i))));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+    }
+    std::size_t popc = 
+        static_cast<std::size_t>(_mm256_extract_epi64(acc, 0)) + static_cast<std::size_t>(_mm256_extract_epi64(acc, 1)) + 
+        static_cast<std::size_t>(_mm256_extract_epi64(acc, 2)) + static_cast<std::size_t>(_mm256_extract_epi64(acc, 3));
+    for (; i < n; ++i) popc += __builtin_popcountll(words[i]);
+    return popc;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline std::size_t popcount_words_avx512(uint64_t const* words, std::size_t n) noexcept
+{
+    __m512i acc = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(words + i)));
+    if (i < n) acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(static_cast<__mmask8>((1U << (n - i)) - 1), words + i)));
+    alignas(64) uint64_t lanes[8]; // _mm512_reduce_add_epi64 trips GCC bug 105593 (-Wuninitialized)
+    _mm512_store_si512(lanes, acc);
+    std::size_t popc = 0;
+    for (auto lane : lanes) popc += lane;
+    return popc;
+}
+#endif
+
+inline popcount_kernel_t select_popcount_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx512_vpopcnt()) return popcount_words_avx512;
+    if (cpu::has_avx2()) return popcount_words_avx2;
+    if (cpu::has_popcnt()) return popcount_words_popcnt;
+#endif
+    return popcount_words_scalar;
+}
+
+} // namespace detail
+
+/* Number of ones in words[0, n), with the best kernel available on the host */
+inline std::size_t popcount_words(uint64_t const* words, std::size_t n) noexcept
+{
+    static const detail::popcount_kernel_t kernel = detail::select_popcount_kernel();
+    return kernel(words, n);
+}
+
+enum class bulk_op {and_op, or_op, xor_op, and_not_op}; // and_not: a & ~b
+
+template <bulk_op Op, typename T>
+constexpr T bulk_apply(T a, T b) noexcept
+{
+    if constexpr (Op == bulk_op::and_op) return a & b;
+    else if constexpr (Op == bulk_op::or_op) return a | b;
+    else if constexpr (Op == bulk_op::xor_op) return a ^ b;
+    else return a & static_cast<T>(~b);
+}
+
+namespace detail {
+
+typedef void (*bulk_kernel_t)(uint64_t*, uint64_t const*, uint64_t const*, std::size_t);
+typedef std::size_t (*intersect_kernel_t)(uint64_t const*, uint64_t const*, std::size_t);
+
+template <bulk_op Op>
+void bulk_words_scalar(uint64_t* dst, uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i) dst[i] = bulk_apply<Op>(a[i], b[i]);
+}
+
+inline std::size_t intersect_count_words_scalar(uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    std::size_t popc = 0;
+    for (std::size_t i = 0; i < n; ++i) popc += popcount(a[i] & b[i]);
+    return popc;
+}
+
+#ifdef BIOLIB_X86_DISPATCH
+template <bulk_op Op>
+__attribute__((target("avx2")))
+inline __m256i apply_avx2(__m256i a, __m256i b) noexcept
+{
+    if constexpr (Op == bulk_op::and_op) return _mm256_and_si256(a, b);
+    else if constexpr (Op == bulk_op::or_op) return _mm256_or_si256(a, b);
+    else if constexpr (Op == bulk_op::xor_op) return _mm256_xor_si256(a, b);
+    else return _mm256_andnot_si256(b, a);
+}
+
+/* dst may alias a or b (in-place operations), since every word is read before being written */
+template <bulk_op Op>
+__attribute__((target("avx2")))
+void bulk_words_avx2(uint64_t* dst, uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i + 4));
+        __m256i y0 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+        __m256i y1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i + 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), apply_avx2<Op>(x0, y0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 4), apply_avx2<Op>(x1, y1));
+    }
+    bulk_words_scalar<Op>(dst + i, a + i, b + i, n - i);
+}
+
+// GCC < 13 warns about the undefined source operand of unmasked AVX-512 logic instructions (GCC bug 105593)
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template <bulk_op Op>
+__attribute__((target("avx512f")))
+void bulk_words_avx512(uint64_t* dst, uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        __m512i r;
+        if constexpr (Op == bulk_op::and_op) r = _mm512_and_si512(x, y);
+        else if constexpr (Op == bulk_op::or_op) r = _mm512_or_si512(x, y);
+        else if constexpr (Op == bulk_op::xor_op) r = _mm512_xor_si512(x, y);
+        else r = _mm512_andnot_si512(y, x);
+        _mm512_storeu_si512(dst + i, r);
+    }
+    bulk_words_scalar<Op>(dst + i, a + i, b + i, n - i);
+}
+
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+__attribute__((target("avx2,popcnt")))
+inline std::size_t intersect_count_words_avx2(uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    while (i + 4 <= n) { // same accumulation scheme as popcount_words_avx2
+        __m256i local = _mm256_setzero_si256();
+        for (std::size_t j = 0; j < 16 and i + 4 <= n; ++j, i += 4) {
+            __m256i x = _mm256_and_si256(
+                _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i)), 
+                _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i))
+            );
+            local = _mm256_add_epi8(local, popcount_bytes_avx2(x));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+    }
+    std::size_t popc = 
+        static_cast<std::size_t>(_mm256_extract_epi64(acc, 0)) + static_cast<std::size_t>(_mm256_extract_epi64(acc, 1)) + 
+        static_cast<std::size_t>(_mm256_extract_epi64(acc, 2)) + static_cast<std::size_t>(_mm256_extract_epi64(acc, 3));
+    for (; i < n; ++i) popc += __builtin_popcountll(a[i] & b[i]);
+    return popc;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline std::size_t intersect_count_words_avx512(uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    __m512i acc = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+    if (i < n) {
+        const __mmask8 mask = static_cast<__mmask8>((1U << (n - i)) - 1);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i))));
+    }
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, acc);
+    std::size_t popc = 0;
+    for (auto lane : lanes) popc += lane;
+    return popc;
+}
+#endif
+
+template <bulk_op Op>
+bulk_kernel_t select_bulk_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx512()) return bulk_words_avx512<Op>;
+    if (cpu::has_avx2()) return bulk_words_avx2<Op>;
+#endif
+    return bulk_words_scalar<Op>;
+}
+
+inline intersect_kernel_t select_intersect_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx512_vpopcnt()) return intersect_count_words_avx512;
+    if (cpu::has_avx2()) return intersect_count_words_avx2;
+    if (cpu::has_popcnt()) return intersect_count_words_popcnt;
+#endif
+    return intersect_count_words_scalar;
+}
+
+} // namespace detail
+
+/* dst[i] = a[i] Op b[i] for i in [0, n). dst can be a or b. */
+template <bulk_op Op>
+inline void bulk_words(uint64_t* dst, uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    static const detail::bulk_kernel_t kernel = detail::select_bulk_kernel<Op>();
+    kernel(dst, a, b, n);
+}
+
+/* Number of ones in (a & b)[0, n), without materializing the intersection */
+inline std::size_t intersect_count_words(uint64_t const* a, uint64_t const* b, std::size_t n) noexcept
+{
+    static const detail::intersect_kernel_t kernel = detail::select_intersect_kernel();
+    return kernel(a, b, n);
+}
+
 template <class Vector>
 inline std::size_t popcount(Vector vec, std::size_t idx)
 {
@@ -3,13 +3,18 @@
 
 #include <vector>
 #include <tuple>
+#include <type_traits>
 #include <stdexcept>
 #include <cassert>
 
 #include "bit_operations.hpp"
+#include "backed_vector.hpp"
 
 namespace bit {
 
+template <typename UnsignedIntegerType>
+class concurrent_vector;
+
 template <typename UnsignedIntegerType>
 class vector
 {
@@ -70,14 +75,20 @@ class vector
 
                 template <typename I>
                 one_position_iterator operator+(I delta_on_the_actual_sequence_of_bits) noexcept;
+
+                // Write the positions of the next (at most max) ones, starting from the current one, and move past them.
+                // Returns the number of positions written.
+                std::size_t decode_ones(std::size_t* out, std::size_t max) noexcept;
             
             private:
                 vector const* parent_vector;
                 std::size_t idx;
-                // TODO add buffer
+                UnsignedIntegerType buffer; // ones of the current block after idx
 
                 void find_next_one() noexcept;
                 void find_prev_one() noexcept;
+                void next_block() noexcept;
+                void end_of_vector() noexcept {idx = parent_vector->size(); buffer = 0;}
 
                 friend bool operator==(one_position_iterator const& a, one_position_iterator const& b) 
                 {
@@ -124,7 +135,7 @@ class vector
         one_position_iterator pos_end() const {return cpos_end();}
 
         UnsignedIntegerType const* data() const noexcept;
-        std::vector<UnsignedIntegerType> const& vector_data() const noexcept;
+        memory::map::backed_vector<UnsignedIntegerType> const& vector_data() const noexcept;
         std::size_t block_size() const noexcept;
         std::size_t size() const noexcept;
         std::size_t bit_size() const noexcept;
@@ -133,6 +144,15 @@ class vector
         std::size_t max_size() const noexcept;
         void swap(vector& other);
 
+        // Whole-vector operations. Operands must have the same size.
+        vector& operator&=(vector const& other);
+        vector& operator|=(vector const& other);
+        vector& operator^=(vector const& other);
+        vector& and_not(vector const& other); // *this &= ~other
+        std::size_t count() const noexcept; // number of ones
+        std::size_t count_range(std::size_t start, std::size_t stop) const; // number of ones in [start, stop)
+        std::size_t intersect_count(vector const& other) const; // (*this & other).count() without building the intersection
+
         template <class Visitor>
         void visit(Visitor& visitor) const;
 
@@ -144,12 +164,19 @@ class vector
         
     private:
         static constexpr std::size_t block_bit_size = 8 * sizeof(UnsignedIntegerType);
-        std::vector<UnsignedIntegerType> _data;
+        memory::map::backed_vector<UnsignedIntegerType> _data; // can be a view over a memory-mapped file (see io::mapped_loader)
         std::size_t bsize;
 
         std::size_t bit_to_byte_size(std::size_t bit_size) const noexcept;
         std::tuple<std::size_t, std::size_t> idx_to_coordinates(std::size_t idx) const noexcept;
         void check_coordinates(std::size_t idx) const;
+        std::size_t count_blocks(std::size_t start, std::size_t stop) const noexcept;
+        void clear_unused_bits() noexcept;
+
+        template <bulk_op Op>
+        vector& bulk_assign(vector const& a, vector const& b);
+
+        friend class concurrent_vector<UnsignedIntegerType>; // atomic writes to the blocks
 
         friend bool operator==(vector const& a, vector const& b) 
         {
@@ -157,6 +184,11 @@ class vector
             return same_size and (a._data == b._data);
         };
         friend bool operator!=(vector const& a, vector const& b) {return not (a == b);};
+
+        friend vector operator&(vector const& a, vector const& b) {vector r(a.size()); r.template bulk_assign<bulk_op::and_op>(a, b); return r;}
+        friend vector operator|(vector const& a, vector const& b) {vector r(a.size()); r.template bulk_assign<bulk_op::or_op>(a, b); return r;}
+        friend vector operator^(vector const& a, vector const& b) {vector r(a.size()); r.template bulk_assign<bulk_op::xor_op>(a, b); return r;}
+        friend vector and_not(vector const& a, vector const& b) {vector r(a.size()); r.template bulk_assign<bulk_op::and_not_op>(a, b); return r;}
 };
 
 template <typename UnsignedIntegerType>
@@ -166,9 +198,9 @@ vector<UnsignedIntegerType>::vector() noexcept
 
 template <typename UnsignedIntegerType>
 vector<UnsignedIntegerType>::vector(std::size_t size, bool val) 
-    : bsize(size)
+    : bsize(0)
 {
-    _data.resize(bit_to_byte_size(bsize), static_cast<UnsignedIntegerType>(val));
+    resize(size, val);
 }
 
 template <typename UnsignedIntegerType>
@@ -184,6 +216,7 @@ vector<UnsignedIntegerType>::resize(std::size_t size)
 {
     _data.resize(bit_to_byte_size(size));
     bsize = size;
+    clear_unused_bits();
 }
 
 template <typename UnsignedIntegerType>
@@ -197,6 +230,7 @@ vector<UnsignedIntegerType>::resize(std::size_t size, bool value)
             : static_cast<UnsignedIntegerType>(0)
     );
     bsize = size;
+    clear_unused_bits(); // push_back relies on the bits after the end being 0
 }
 
 template <typename UnsignedIntegerType>
@@ -240,6 +274,7 @@ vector<UnsignedIntegerType>::pop_back()
 {
     if (bsize == 0) throw std::out_of_range("[bit::vector::pop_back]");
     bool res = at(bsize - 1);
+    clear(bsize - 1);
     --bsize;
     return res;
 }
@@ -346,7 +381,7 @@ vector<UnsignedIntegerType>::data() const noexcept
 }
 
 template <typename UnsignedIntegerType>
-std::vector<UnsignedIntegerType> const& 
+memory::map::backed_vector<UnsignedIntegerType> const& 
 vector<UnsignedIntegerType>::vector_data() const noexcept
 {
     return _data;
@@ -403,6 +438,120 @@ vector<UnsignedIntegerType>::swap(vector& other)
     std::swap(bsize, other.bsize);
 }
 
+template <typename UnsignedIntegerType>
+vector<UnsignedIntegerType>&
+vector<UnsignedIntegerType>::operator&=(vector const& other)
+{
+    return bulk_assign<bulk_op::and_op>(*this, other);
+}
+
+template <typename UnsignedIntegerType>
+vector<UnsignedIntegerType>&
+vector<UnsignedIntegerType>::operator|=(vector const& other)
+{
+    return bulk_assign<bulk_op::or_op>(*this, other);
+}
+
+template <typename UnsignedIntegerType>
+vector<UnsignedIntegerType>&
+vector<UnsignedIntegerType>::operator^=(vector const& other)
+{
+    return bulk_assign<bulk_op::xor_op>(*this, other);
+}
+
+template <typename UnsignedIntegerType>
+vector<UnsignedIntegerType>&
+vector<UnsignedIntegerType>::and_not(vector const& other)
+{
+    return bulk_assign<bulk_op::and_not_op>(*this, other);
+}
+
+template <typename UnsignedIntegerType>
+std::size_t
+vector<UnsignedIntegerType>::count() const noexcept
+{
+    return count_range(0, bsize);
+}
+
+template <typename UnsignedIntegerType>
+std::size_t
+vector<UnsignedIntegerType>::count_range(std::size_t start, std::size_t stop) const
+{
+    if (start > stop or stop > bsize) throw std::out_of_range("[bit::vector::count_range]");
+    if (start == stop) return 0;
+    auto [first_block, first_bit] = idx_to_coordinates(start);
+    auto [last_block, last_bit] = idx_to_coordinates(stop - 1);
+    auto prefix_mask = [](std::size_t len) { // len in [1, block_bit_size]
+        return static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0)) >> (block_bit_size - len);
+    };
+    const UnsignedIntegerType first = static_cast<UnsignedIntegerType>(_data[first_block] >> first_bit);
+    if (first_block == last_block) return popcount(static_cast<UnsignedIntegerType>(first & prefix_mask(last_bit - first_bit + 1)));
+    return 
+        popcount(first) + 
+        count_blocks(first_block + 1, last_block) + 
+        popcount(static_cast<UnsignedIntegerType>(_data[last_block] & prefix_mask(last_bit + 1)));
+}
+
+template <typename UnsignedIntegerType>
+std::size_t
+vector<UnsignedIntegerType>::intersect_count(vector const& other) const
+{
+    if (bsize != other.bsize) throw std::invalid_argument("[bit::vector] operands of different sizes");
+    if (bsize == 0) return 0;
+    const std::size_t full_blocks = bsize / block_bit_size;
+    std::size_t popc = 0;
+    if constexpr (std::is_same<UnsignedIntegerType, uint64_t>::value) {
+        popc = intersect_count_words(_data.data(), other._data.data(), full_blocks);
+    } else {
+        for (std::size_t i = 0; i < full_blocks; ++i) popc += popcount(static_cast<UnsignedIntegerType>(_data[i] & other._data[i]));
+    }
+    if (full_blocks != _data.size()) { // partial last block, bits after size() are not part of the vector
+        const UnsignedIntegerType mask = static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0)) >> (block_bit_size - bsize % block_bit_size);
+        popc += popcount(static_cast<UnsignedIntegerType>(_data.back() & other._data.back() & mask));
+    }
+    return popc;
+}
+
+template <typename UnsignedIntegerType>
+std::size_t
+vector<UnsignedIntegerType>::count_blocks(std::size_t start, std::size_t stop) const noexcept
+{
+    if constexpr (std::is_same<UnsignedIntegerType, uint64_t>::value) {
+        return popcount_words(_data.data() + start, stop - start);
+    } else {
+        std::size_t popc = 0;
+        for (std::size_t i = start; i < stop; ++i) popc += popcount(_data[i]);
+        return popc;
+    }
+}
+
+template <typename UnsignedIntegerType>
+void
+vector<UnsignedIntegerType>::clear_unused_bits() noexcept
+{
+    if (bsize % block_bit_size) _data.back() &= static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0)) >> (block_bit_size - bsize % block_bit_size);
+}
+
+/* 
+ * *this = a Op b, with *this of the same size as the operands (it can be one of them).
+ * 64-bit blocks go through the dispatched word kernels of bit_operations.hpp.
+ */
+template <typename UnsignedIntegerType>
+template <bulk_op Op>
+vector<UnsignedIntegerType>&
+vector<UnsignedIntegerType>::bulk_assign(vector const& a, vector const& b)
+{
+    if (a.bsize != b.bsize) throw std::invalid_argument("[bit::vector] operands of different sizes");
+    assert(bsize == a.bsize and _data.size() == a._data.size());
+    if constexpr (std::is_same<UnsignedIntegerType, uint64_t>::value) {
+        bulk_words<Op>(_data.data(), a._data.data(), b._data.data(), _data.size());
+    } else {
+        for (std::size_t i = 0; i < _data.size(); ++i) _data[i] = bulk_apply<Op>(a._data[i], b._data[i]);
+    }
+    clear_unused_bits();
+    return *this;
+}
+
 template <typename UnsignedIntegerType>
 std::size_t
 vector<UnsignedIntegerType>::bit_to_byte_size(std::size_t bit_size) const noexcept 
@@ -524,7 +673,7 @@ vector<UnsignedIntegerType>::const_iterator::operator+(I inc) const
 
 template <class UnsignedIntegerType>
 vector<UnsignedIntegerType>::one_position_iterator::one_position_iterator(vector const& vec, std::size_t ref_idx)
-    : parent_vector(&vec), idx(ref_idx)
+    : parent_vector(&vec), idx(ref_idx), buffer(0)
 {
     if (idx >= parent_vector->size()) idx = parent_vector->size();
     find_next_one();
@@ -541,8 +690,16 @@ template <class UnsignedIntegerType>
 typename vector<UnsignedIntegerType>::one_position_iterator const&
 vector<UnsignedIntegerType>::one_position_iterator::operator++() noexcept
 {
-    ++idx;
-    find_next_one();
+    if (idx == ~decltype(idx)(0)) { // before the first position
+        idx = 0;
+        find_next_one();
+    } else if (buffer) {
+        idx = idx - idx % block_bit_size + __builtin_ctzll(buffer);
+        buffer &= buffer - 1;
+        if (idx >= parent_vector->size()) end_of_vector();
+    } else if (idx < parent_vector->size()) {
+        next_block();
+    }
     return *this;
 }
 
@@ -575,19 +732,89 @@ vector<UnsignedIntegerType>::one_position_iterator::operator--(int) noexcept
     return current;
 }
 
+template <class UnsignedIntegerType>
+std::size_t
+vector<UnsignedIntegerType>::one_position_iterator::decode_ones(std::size_t* out, std::size_t max) noexcept
+{
+    const std::size_t size = parent_vector->size();
+    if (idx == ~decltype(idx)(0)) operator++();
+    std::size_t n = 0;
+    while (n < max and idx < size) {
+        out[n++] = idx;
+        std::size_t base = idx - idx % block_bit_size;
+        while (buffer and n < max) { // ones of the current block, without touching the iterator state
+            std::size_t pos = base + __builtin_ctzll(buffer);
+            if (pos >= size) break;
+            out[n++] = pos;
+            buffer &= buffer - 1;
+        }
+        operator++();
+    }
+    return n;
+}
+
 template <class UnsignedIntegerType>
 void
 vector<UnsignedIntegerType>::one_position_iterator::find_next_one() noexcept
 {
-    while(idx < parent_vector->size() and not parent_vector->at(idx)) ++idx;
+    if (idx >= parent_vector->size()) {
+        end_of_vector();
+        return;
+    }
+    auto [block_idx, bit_idx] = parent_vector->idx_to_coordinates(idx);
+    const UnsignedIntegerType ones = static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0));
+    UnsignedIntegerType block = parent_vector->_data[block_idx] & static_cast<UnsignedIntegerType>(ones << bit_idx);
+    if (block) {
+        idx = block_idx * block_bit_size + __builtin_ctzll(block);
+        buffer = block & (block - 1);
+        if (idx >= parent_vector->size()) end_of_vector();
+    } else {
+        idx = block_idx * block_bit_size;
+        next_block();
+    }
 }
 
+/* first one in the blocks following the one of idx */
+template <class UnsignedIntegerType>
+void
+vector<UnsignedIntegerType>::one_position_iterator::next_block() noexcept
+{
+    auto const& data = parent_vector->_data;
+    std::size_t block_idx = idx / block_bit_size + 1;
+    while (block_idx < data.size() and not data[block_idx]) ++block_idx;
+    if (block_idx < data.size()) {
+        UnsignedIntegerType block = data[block_idx];
+        idx = block_idx * block_bit_size + __builtin_ctzll(block);
+        buffer = block & (block - 1);
+        if (idx >= parent_vector->size()) end_of_vector();
+    } else {
+        end_of_vector();
+    }
+}
+
+/* last one at or before idx, ~0 if there is none */
 template <class UnsignedIntegerType>
 void
 vector<UnsignedIntegerType>::one_position_iterator::find_prev_one() noexcept
 {
-    while(idx != 0 and not parent_vector->at(idx)) --idx;
-    if (not parent_vector->at(0)) --idx; // underflow
+    auto const& data = parent_vector->_data;
+    if (idx != ~decltype(idx)(0) and idx >= parent_vector->size()) idx = parent_vector->size() - 1; // ~0 for empty vectors
+    if (idx == ~decltype(idx)(0)) {
+        buffer = 0;
+        return;
+    }
+    auto [block_idx, bit_idx] = parent_vector->idx_to_coordinates(idx);
+    const UnsignedIntegerType ones = static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0));
+    UnsignedIntegerType block = data[block_idx] & static_cast<UnsignedIntegerType>(ones >> (block_bit_size - 1 - bit_idx));
+    while (not block and block_idx) block = data[--block_idx];
+    if (block) {
+        std::size_t pos = 63 - __builtin_clzll(static_cast<unsigned long long>(block));
+        idx = block_idx * block_bit_size + pos;
+        buffer = pos + 1 < block_bit_size ? static_cast<UnsignedIntegerType>(data[block_idx] & static_cast<UnsignedIntegerType>(ones << (pos + 1))) : 0;
+    } else {
+        idx = ~decltype(idx)(0); // underflow
+        buffer = 0;
+    }
 }
 
 template <class UnsignedIntegerType>
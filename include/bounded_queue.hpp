@@ -0,0 +1,90 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+namespace concurrent {
+
+/*
+ * Blocking multi-producer multi-consumer FIFO queue of bounded capacity.
+ * Producers wait while the queue is full, consumers wait while it is empty.
+ * After close(), push() fails and pop() returns the remaining items before failing.
+ */
+template <typename T>
+class bounded_queue
+{
+    public:
+        bounded_queue(std::size_t capacity);
+        bool push(T item); // false if the queue has been closed
+        bool pop(T& item); // false if the queue has been closed and drained
+        void close();
+        std::size_t capacity() const noexcept;
+
+    private:
+        std::deque<T> items;
+        std::size_t max_size;
+        bool closed;
+        std::mutex mtx;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+};
+
+template <typename T>
+bounded_queue<T>::bounded_queue(std::size_t capacity)
+    : max_size(capacity), closed(false)
+{
+    if (max_size == 0) throw std::invalid_argument("[bounded queue] capacity must be positive");
+}
+
+template <typename T>
+bool
+bounded_queue<T>::push(T item)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    not_full.wait(lock, [this] {return closed or items.size() < max_size;});
+    if (closed) return false;
+    items.push_back(std::move(item));
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+}
+
+template <typename T>
+bool
+bounded_queue<T>::pop(T& item)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    not_empty.wait(lock, [this] {return closed or not items.empty();});
+    if (items.empty()) return false;
+    item = std::move(items.front());
+    items.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+}
+
+template <typename T>
+void
+bounded_queue<T>::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+    }
+    not_full.notify_all();
+    not_empty.notify_all();
+}
+
+template <typename T>
+std::size_t
+bounded_queue<T>::capacity() const noexcept
+{
+    return max_size;
+}
+
+} // namespace concurrent
+
+#endif // BOUNDED_QUEUE_HPP
@@ -0,0 +1,111 @@
+#ifndef CONCURRENT_BIT_VECTOR_HPP
+#define CONCURRENT_BIT_VECTOR_HPP
+
+#include <utility>
+#include <stdexcept>
+#include "bit_vector.hpp"
+
+namespace bit {
+
+/*
+ * Fixed-size bit vector whose bits can be set by many threads at the same time,
+ * for parallel constructions (Bloom filters, MPHF levels, sets of seen k-mers).
+ * Writes are atomic read-modify-write operations on single blocks (GCC/clang __atomic builtins,
+ * since std::atomic_ref is C++20) with relaxed ordering: atomicity is enough to never lose a bit,
+ * and joining the writer threads makes every write visible to the reader.
+ * freeze() hands the storage over to an ordinary bit::vector without copying it.
+ */
+template <typename UnsignedIntegerType>
+class concurrent_vector
+{
+    public:
+        using value_type = UnsignedIntegerType;
+        using block_type = UnsignedIntegerType;
+
+        concurrent_vector() noexcept {}
+        concurrent_vector(std::size_t size) : bvec(size, false) {}
+        concurrent_vector(vector<UnsignedIntegerType>&& other) noexcept : bvec(std::move(other)) {}
+        concurrent_vector(concurrent_vector const&) = delete;
+        concurrent_vector(concurrent_vector&&) noexcept = default;
+        concurrent_vector& operator=(concurrent_vector const&) = delete;
+        concurrent_vector& operator=(concurrent_vector&&) noexcept = default;
+
+        void set(std::size_t idx); // thread-safe
+        bool test_and_set(std::size_t idx); // thread-safe, returns the previous value of the bit
+        UnsignedIntegerType fetch_or(std::size_t block_idx, UnsignedIntegerType mask); // thread-safe, returns the previous block
+        bool at(std::size_t idx) const; // thread-safe, may not see concurrent writes yet
+
+        std::size_t size() const noexcept {return bvec.size();}
+        std::size_t block_size() const noexcept {return bvec.block_size();}
+        vector<UnsignedIntegerType> freeze() noexcept; // not thread-safe, leaves this vector empty
+
+    private:
+        static constexpr std::size_t block_bit_size = 8 * sizeof(UnsignedIntegerType);
+        static_assert(__atomic_always_lock_free(sizeof(UnsignedIntegerType), 0), "[bit::concurrent_vector] blocks must be lock-free");
+        vector<UnsignedIntegerType> bvec;
+
+        UnsignedIntegerType* blocks() noexcept {return bvec._data.data();}
+        UnsignedIntegerType const* blocks() const noexcept {return bvec._data.data();}
+        void check_index(std::size_t idx) const;
+};
+
+template <typename UnsignedIntegerType>
+void
+concurrent_vector<UnsignedIntegerType>::set(std::size_t idx)
+{
+    check_index(idx);
+    const UnsignedIntegerType mask = static_cast<UnsignedIntegerType>(1) << (idx % block_bit_size);
+    UnsignedIntegerType* block = blocks() + idx / block_bit_size;
+    if (__atomic_load_n(block, __ATOMIC_RELAXED) & mask) return; // no exclusive ownership of the cache line if already set
+    __atomic_fetch_or(block, mask, __ATOMIC_RELAXED);
+}
+
+template <typename UnsignedIntegerType>
+bool
+concurrent_vector<UnsignedIntegerType>::test_and_set(std::size_t idx)
+{
+    check_index(idx);
+    const UnsignedIntegerType mask = static_cast<UnsignedIntegerType>(1) << (idx % block_bit_size);
+    UnsignedIntegerType* block = blocks() + idx / block_bit_size;
+    if (__atomic_load_n(block, __ATOMIC_RELAXED) & mask) return true;
+    return __atomic_fetch_or(block, mask, __ATOMIC_RELAXED) & mask;
+}
+
+template <typename UnsignedIntegerType>
+UnsignedIntegerType
+concurrent_vector<UnsignedIntegerType>::fetch_or(std::size_t block_idx, UnsignedIntegerType mask)
+{
+    if (block_idx >= bvec.block_size()) throw std::out_of_range("[bit::concurrent_vector] block index out of range");
+    if (block_idx == bvec.block_size() - 1 and size() % block_bit_size) { // bits after size() must stay 0
+        mask &= static_cast<UnsignedIntegerType>(~static_cast<UnsignedIntegerType>(0)) >> (block_bit_size - size() % block_bit_size);
+    }
+    return __atomic_fetch_or(blocks() + block_idx, mask, __ATOMIC_RELAXED);
+}
+
+template <typename UnsignedIntegerType>
+bool
+concurrent_vector<UnsignedIntegerType>::at(std::size_t idx) const
+{
+    check_index(idx);
+    return (__atomic_load_n(blocks() + idx / block_bit_size, __ATOMIC_RELAXED) >> (idx % block_bit_size)) & 1;
+}
+
+template <typename UnsignedIntegerType>
+vector<UnsignedIntegerType>
+concurrent_vector<UnsignedIntegerType>::freeze() noexcept
+{
+    vector<UnsignedIntegerType> r;
+    r.swap(bvec);
+    return r;
+}
+
+template <typename UnsignedIntegerType>
+void
+concurrent_vector<UnsignedIntegerType>::check_index(std::size_t idx) const
+{
+    if (idx >= bvec.size()) throw std::out_of_range("[bit::concurrent_vector] index out of range");
+}
+
+} // namespace bit
+
+#endif // CONCURRENT_BIT_VECTOR_HPP
@@ -0,0 +1,81 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+/*
+ * Run-time detection of the instruction set extensions used by the vectorized kernels.
+ * Kernels are compiled with function-level target attributes so that a single binary
+ * built for the baseline architecture can still pick the best implementation at start-up.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BIOLIB_X86_DISPATCH 1
+#endif
+
+namespace cpu {
+
+#ifdef BIOLIB_X86_DISPATCH
+inline bool has_popcnt() noexcept
+{
+    static const bool r = [] {__builtin_cpu_init(); return static_cast<bool>(__builtin_cpu_supports("popcnt"));}();
+    return r;
+}
+
+inline bool has_sse42() noexcept
+{
+    static const bool r = [] {__builtin_cpu_init(); return static_cast<bool>(__builtin_cpu_supports("sse4.2"));}();
+    return r;
+}
+
+inline bool has_avx2() noexcept
+{
+    static const bool r = [] {__builtin_cpu_init(); return static_cast<bool>(__builtin_cpu_supports("avx2"));}();
+    return r;
+}
+
+inline bool has_bmi2() noexcept
+{
+    static const bool r = [] {__builtin_cpu_init(); return static_cast<bool>(__builtin_cpu_supports("bmi2"));}();
+    return r;
+}
+
+/* 
+ * pdep/pext are micro-coded on AMD processors before Zen 3 (hundreds of cycles, depending on the mask).
+ * Those cores report BMI2 anyway, so kernels built around pdep must check this instead of has_bmi2().
+ */
+inline bool has_fast_pdep() noexcept
+{
+    static const bool r = [] {
+        __builtin_cpu_init();
+        bool slow = static_cast<bool>(__builtin_cpu_is("znver1")) or static_cast<bool>(__builtin_cpu_is("znver2"));
+        return has_bmi2() and not slow;
+    }();
+    return r;
+}
+
+inline bool has_avx512() noexcept // foundation + doubleword/quadword instructions
+{
+    static const bool r = [] {
+        __builtin_cpu_init(); 
+        return static_cast<bool>(__builtin_cpu_supports("avx512f")) and static_cast<bool>(__builtin_cpu_supports("avx512dq"));
+    }();
+    return r;
+}
+
+inline bool has_avx512_vpopcnt() noexcept // vpopcntq on 512-bit vectors
+{
+    static const bool r = [] {__builtin_cpu_init(); return has_avx512() and static_cast<bool>(__builtin_cpu_supports("avx512vpopcntdq"));}();
+    return r;
+}
+#else
+inline bool has_popcnt() noexcept {return false;}
+inline bool has_sse42() noexcept {return false;}
+inline bool has_avx2() noexcept {return false;}
+inline bool has_bmi2() noexcept {return false;}
+inline bool has_fast_pdep() noexcept {return false;}
+inline bool has_avx512() noexcept {return false;}
+inline bool has_avx512_vpopcnt() noexcept {return false;}
+#endif
+
+} // namespace cpu
+
+#endif // CPU_FEATURES_HPP
@@ -1,6 +1,7 @@
 #ifndef ELIAS_FANO_HPP
 #define ELIAS_FANO_HPP
 
+#include <utility>
 #include "bit_vector.hpp"
 #include "packed_vector.hpp"
 #include "rank_select.hpp"
@@ -94,6 +95,36 @@ class array
                 friend bool operator!=(diff_iterator const& a, diff_iterator const& b) {return not (a == b);};
         };
 
+        /*
+         * Single-pass construction from a stream of sorted values (e.g. the merge of an emem::external_memory_vector).
+         * n and u only fix the low-bit width and the initial allocation: if they are estimates the upper bits grow
+         * (or shrink in finish()) as needed, at the cost of a slightly sub-optimal width.
+         */
+        class builder
+        {
+            public:
+                builder(std::size_t n, std::size_t u);
+                void push_back(std::size_t v);
+
+                template <class Iterator>
+                void append(Iterator start, Iterator stop);
+
+                std::size_t size() const noexcept {return count;}
+                array finish(); // moves the encoding out, the builder starts over empty
+
+            private:
+                std::size_t u;
+                std::size_t l;
+                max_width_native_type low_mask;
+                bv_t msb;
+                pv_t lsb;
+                std::size_t count;
+                std::size_t prev;
+
+                build_t release();
+                friend class array;
+        };
+
         array() : msbrs(bv_t(0)), lsb(0) {}
 
         template <class Iterator>
@@ -116,6 +147,9 @@ class array
         std::size_t diff_at(std::size_t idx) const; // access difference
         std::size_t lt_find(std::size_t s, bool ignore_duplicates = false) const; // find the index of the largest element < s
         std::size_t gt_find(std::size_t s, bool ignore_duplicates = false) const; // find the index of the smallest element > s
+        std::pair<std::size_t, std::size_t> next_geq(std::size_t x) const; // (index, value) of the first element >= x, (size(), max) if none
+        std::pair<std::size_t, std::size_t> prev_leq(std::size_t x) const; // (index, value) of the last element <= x, (max, 0) if none
+        void decode(std::size_t from, std::size_t count, uint64_t* out) const; // out[i] = at(from + i), much faster than const_iterator
         std::size_t size() const noexcept;
         std::size_t bit_size() const noexcept;
 
@@ -145,8 +179,9 @@ class array
         pv_t lsb;
         std::size_t _size;
 
-        array(build_t pack) : msbrs(std::get<0>(pack)), lsb(std::get<1>(pack)), _size(std::get<2>(pack)) {} // dummy constructor for const members
+        array(build_t&& pack) : msbrs(std::move(std::get<0>(pack))), lsb(std::move(std::get<1>(pack))), _size(std::get<2>(pack)) {} // dummy constructor for const members
         std::size_t lsb_at(std::size_t idx) const;
+        std::size_t bucket_bound(std::size_t first, std::size_t last, std::size_t low, bool strict) const;
 
         template <class Iterator>
         static build_t build(Iterator start, std::size_t n, std::size_t u); // main construction function
@@ -180,31 +215,9 @@ BUILD_T
 array::build(Iterator start, std::size_t n, std::size_t u)
 {
     static_assert(not std::numeric_limits<typename Iterator::value_type>::is_signed, "[Elias-Fano] sequence must be unsigned");
-    ++n; // add 0 at the beginning for convenience
-    const std::size_t l = (n && u / n) ? static_cast<std::size_t>(std::ceil(std::log2(u / n))) : 0;
-    const max_width_native_type low_mask = (static_cast<max_width_native_type>(1) << l) - 1;
-
-    vector<max_width_native_type> msb;
-    msb.resize(n + (u >> l) + 1, false);
-    msb.set(0);
-    packed::vector loclsb(l);
-    if (l) {
-        loclsb.reserve(n);
-        loclsb.push_back(static_cast<std::size_t>(0));
-    }
-    --n; // restore true size
-
-    uint64_t prev = 0; // for convenience we added a virtual 0 at the beginning, so the first item is always 0.
-    for (size_t i = 0; i < n; ++i, ++start) {
-        auto v = *start;
-        if (i and v < prev) throw std::runtime_error("ef_sequence is not sorted");
-        if (l) loclsb.push_back(v & low_mask);
-        msb.set((v >> l) + i + 1); // +1 because n+1 before
-        prev = v;
-    }
-    if (l) assert(loclsb.size() == (n + (l ? 1 : 0)));
-    rs_t temp(std::move(msb));
-    return std::make_tuple(temp, loclsb, n);
+    builder b(n, u);
+    for (std::size_t i = 0; i < n; ++i, ++start) b.push_back(*start);
+    return b.release();
 }
 
 template <class Iterator>
@@ -263,6 +276,14 @@ array::build(Iterator start, Iterator stop)
     return build(start, stop, category());
 }
 
+template <class Iterator>
+void
+array::builder::append(Iterator start, Iterator stop)
+{
+    static_assert(not std::numeric_limits<typename std::iterator_traits<Iterator>::value_type>::is_signed, "[Elias-Fano] sequence must be unsigned");
+    for (; start != stop; ++start) push_back(*start);
+}
+
 template <class Visitor>
 void 
 array::visit(Visitor& visitor) const
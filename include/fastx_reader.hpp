@@ -0,0 +1,206 @@
+#ifndef FASTX_READER_HPP
+#define FASTX_READER_HPP
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+#include "memory_mapped_file.hpp"
+
+namespace io {
+namespace fastx {
+
+struct record_t {
+    std::string_view name; // header up to the first white space
+    std::string_view comment; // rest of the header line
+    std::string_view sequence;
+    std::string_view quality; // empty for FASTA records
+};
+
+/*
+ * FASTA/FASTQ parser over a range of memory holding whole records.
+ * Records are returned as views into the range, except for sequences (and qualities) spanning multiple lines:
+ * those are compacted, removing end of lines, into the buffers given by the caller.
+ * Windows end of lines (\r\n) are supported.
+ */
+class range_parser
+{
+    public:
+        range_parser(char const* start, char const* stop) noexcept;
+        bool next(record_t& record, std::string& sequence_buffer, std::string& quality_buffer); // false at the end of the range
+        void rewind() noexcept;
+
+    private:
+        char const* range_start;
+        char const* range_end;
+        char const* cursor;
+
+        char const* find_line_end(char const* p) const noexcept; // position of the next '\n' or range_end
+        char const* next_line(char const* p) const noexcept; // start of the next line or range_end
+        std::string_view strip_cr(char const* start, char const* stop) const noexcept;
+        std::string_view compact(char const* start, char const* stop, std::string& buffer) const;
+        void parse_header(record_t& record);
+};
+
+/*
+ * Zero-copy FASTA/FASTQ reader over a memory-mapped (uncompressed) file.
+ * Records are returned as views into the mapped file, so they can be passed as they are
+ * to the views (e.g. kmer_view_from_cstr(rec.sequence.data(), rec.sequence.size(), ...)).
+ * Sequences spanning multiple lines cannot be views of the file: they are compacted into an internal buffer
+ * only when this happens, so returned views are valid until the next call to next() (compacted records)
+ * or until the reader is destroyed.
+ */
+class mapped_reader
+{
+    public:
+        mapped_reader(std::string const& filename);
+        bool next(record_t& record); // false at the end of the file
+        void rewind() noexcept;
+        std::size_t bytes() const noexcept;
+
+    private:
+        memory::map::file_source<char> mapped;
+        range_parser parser;
+        std::string sequence_buffer;
+        std::string quality_buffer;
+};
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline range_parser::range_parser(char const* start, char const* stop) noexcept
+    : range_start(start), range_end(stop), cursor(start)
+{}
+
+inline bool
+range_parser::next(record_t& record, std::string& sequence_buffer, std::string& quality_buffer)
+{
+    // jump to the next header line, ignoring anything before it
+    while (cursor < range_end and *cursor != '>' and *cursor != '@') cursor = next_line(cursor);
+    if (cursor == range_end) return false;
+    const bool fastq = (*cursor == '@');
+    parse_header(record);
+    record.quality = std::string_view();
+
+    // sequence lines, up to the next header ('>' or '@') for FASTA or the separator ('+') for FASTQ
+    char const* seq_start = cursor;
+    std::size_t nlines = 0;
+    while (cursor < range_end and not (fastq ? *cursor == '+' : (*cursor == '>' or *cursor == '@'))) {
+        cursor = next_line(cursor);
+        ++nlines;
+    }
+    char const* seq_stop = cursor;
+    if (seq_stop > seq_start and seq_stop[-1] == '\n') --seq_stop;
+    if (nlines <= 1) record.sequence = strip_cr(seq_start, seq_stop);
+    else record.sequence = compact(seq_start, seq_stop, sequence_buffer);
+    if (not fastq) return true;
+
+    if (cursor >= range_end or *cursor != '+') throw std::runtime_error("[fastx reader] no quality string for " + std::string(record.name));
+    cursor = next_line(cursor); // skip the '+' line
+    // quality lines, until the quality string is as long as the sequence
+    char const* qual_start = cursor;
+    std::size_t qual_length = 0;
+    nlines = 0;
+    while (cursor < range_end and qual_length < record.sequence.size()) {
+        qual_length += strip_cr(cursor, find_line_end(cursor)).size();
+        cursor = next_line(cursor);
+        ++nlines;
+    }
+    char const* qual_stop = cursor;
+    if (qual_stop > qual_start and qual_stop[-1] == '\n') --qual_stop;
+    if (nlines <= 1) record.quality = strip_cr(qual_start, qual_stop);
+    else record.quality = compact(qual_start, qual_stop, quality_buffer);
+    if (record.quality.size() != record.sequence.size()) throw std::runtime_error("[fastx reader] quality string of different length for " + std::string(record.name));
+    return true;
+}
+
+inline void
+range_parser::rewind() noexcept
+{
+    cursor = range_start;
+}
+
+inline char const*
+range_parser::find_line_end(char const* p) const noexcept
+{
+    auto eol = static_cast<char const*>(std::memchr(p, '\n', range_end - p));
+    return eol ? eol : range_end;
+}
+
+inline char const*
+range_parser::next_line(char const* p) const noexcept
+{
+    char const* eol = find_line_end(p);
+    return eol < range_end ? eol + 1 : range_end;
+}
+
+inline std::string_view
+range_parser::strip_cr(char const* start, char const* stop) const noexcept
+{
+    if (stop > start and stop[-1] == '\r') --stop;
+    return std::string_view(start, stop - start);
+}
+
+inline std::string_view
+range_parser::compact(char const* start, char const* stop, std::string& buffer) const
+{
+    buffer.resize(stop - start);
+    std::size_t len = 0;
+    for (char const* p = start; p < stop;) {
+        char const* eol = static_cast<char const*>(std::memchr(p, '\n', stop - p));
+        if (not eol) eol = stop;
+        auto line = strip_cr(p, eol);
+        std::memcpy(&buffer[len], line.data(), line.size());
+        len += line.size();
+        p = eol + 1;
+    }
+    buffer.resize(len);
+    return std::string_view(buffer);
+}
+
+/*
+ * Same convention as kseq: the name ends at the first white space, the comment is the rest of the line.
+ */
+inline void
+range_parser::parse_header(record_t& record)
+{
+    char const* start = cursor + 1; // skip '>' or '@'
+    char const* eol = find_line_end(start);
+    auto header = strip_cr(std::min(start, eol), eol);
+    std::size_t name_length = 0;
+    while (name_length < header.size() and not std::isspace(static_cast<unsigned char>(header[name_length]))) ++name_length;
+    record.name = header.substr(0, name_length);
+    record.comment = name_length < header.size() ? header.substr(name_length + 1) : std::string_view();
+    cursor = next_line(eol);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline mapped_reader::mapped_reader(std::string const& filename)
+    : mapped(filename, memory::map::advice::sequential), parser(mapped.data(), mapped.data() + mapped.bytes())
+{}
+
+inline bool
+mapped_reader::next(record_t& record)
+{
+    return parser.next(record, sequence_buffer, quality_buffer);
+}
+
+inline void
+mapped_reader::rewind() noexcept
+{
+    parser.rewind();
+}
+
+inline std::size_t
+mapped_reader::bytes() const noexcept
+{
+    return mapped.bytes();
+}
+
+} // namespace fastx
+} // namespace io
+
+#endif // FASTX_READER_HPP
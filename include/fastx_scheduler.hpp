@@ -0,0 +1,208 @@
+#ifndef FASTX_SCHEDULER_HPP
+#define FASTX_SCHEDULER_HPP
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+#include "fastx_reader.hpp"
+#include "bounded_queue.hpp"
+
+namespace io {
+namespace fastx {
+
+struct batch_t {
+    std::size_t index; // rank of the chunk in the file
+    std::size_t offset; // byte offset of the chunk in the file
+    std::vector<record_t> records;
+};
+
+/*
+ * Parallel parsing of a large (uncompressed) FASTA/FASTQ file.
+ * The calling thread splits the memory-mapped file into byte ranges of about chunk_bytes bytes,
+ * moves the end of each range forward to the next record start, asks the kernel to prefetch it
+ * and pushes it into a bounded queue.
+ * Worker threads pop ranges, parse them and call fn(thread_id, batch) on the records of each range,
+ * so that the views (kmer_view, minimizer_view, ...) run on the workers.
+ * Batches, compaction buffers and queue slots are recycled, and the pages of a processed chunk are released,
+ * so memory usage does not grow with the size of the file.
+ *
+ * Records of a batch are only valid during the callback.
+ * The format is given by the first record: FASTQ files must have single-line sequences and qualities
+ * (record starts are recognized as lines starting with '@' followed by a line starting with '+' two lines below).
+ */
+class chunk_scheduler
+{
+    public:
+        chunk_scheduler(std::string const& filename, std::size_t nthreads, std::size_t chunk_bytes = 1 << 22, std::size_t queue_capacity = 0);
+
+        template <typename Worker>
+        void run(Worker&& fn);
+
+        std::size_t get_nthreads() const noexcept;
+        std::size_t bytes() const noexcept;
+
+    private:
+        struct range_t {
+            std::size_t index;
+            std::size_t start;
+            std::size_t stop;
+        };
+
+        memory::map::file_source<char> mapped;
+        std::size_t nthreads;
+        std::size_t chunk_size;
+        std::size_t max_queued;
+        bool fastq;
+
+        std::size_t line_start_after(std::size_t offset) const noexcept; // first line start >= offset
+        std::size_t next_line(std::size_t offset) const noexcept;
+        bool is_record_start(std::size_t offset) const noexcept;
+        std::size_t realign(std::size_t offset) const noexcept;
+        void advise(std::size_t start, std::size_t stop, int advice) const noexcept;
+};
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline chunk_scheduler::chunk_scheduler(std::string const& filename, std::size_t threads, std::size_t chunk_bytes, std::size_t queue_capacity)
+    : mapped(filename, memory::map::advice::sequential), nthreads(threads), chunk_size(chunk_bytes), max_queued(queue_capacity), fastq(false)
+{
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    if (chunk_size == 0) throw std::invalid_argument("[fastx scheduler] chunks must be at least one byte long");
+    if (max_queued == 0) max_queued = 2 * nthreads;
+    char const* data = mapped.data();
+    for (std::size_t i = 0; i < mapped.bytes(); i = next_line(i)) {
+        if (data[i] == '>' or data[i] == '@') {
+            fastq = (data[i] == '@');
+            break;
+        }
+    }
+}
+
+template <typename Worker>
+void
+chunk_scheduler::run(Worker&& fn)
+{
+    concurrent::bounded_queue<range_t> queue(max_queued);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+
+    auto worker = [&](std::size_t thread_id) {
+        batch_t batch;
+        std::deque<std::string> sequence_buffers, quality_buffers; // deque: growing does not move the buffers in use
+        range_t range;
+        while (queue.pop(range)) {
+            if (failed) continue; // drain the queue
+            try {
+                batch.index = range.index;
+                batch.offset = range.start;
+                batch.records.clear();
+                range_parser parser(mapped.data() + range.start, mapped.data() + range.stop);
+                std::size_t used_sequences = 0, used_qualities = 0;
+                record_t record;
+                while (true) {
+                    if (used_sequences == sequence_buffers.size()) sequence_buffers.emplace_back();
+                    if (used_qualities == quality_buffers.size()) quality_buffers.emplace_back();
+                    auto& sequence_buffer = sequence_buffers[used_sequences];
+                    auto& quality_buffer = quality_buffers[used_qualities];
+                    if (not parser.next(record, sequence_buffer, quality_buffer)) break;
+                    if (not record.sequence.empty() and record.sequence.data() == sequence_buffer.data()) ++used_sequences;
+                    if (not record.quality.empty() and record.quality.data() == quality_buffer.data()) ++used_qualities;
+                    batch.records.push_back(record);
+                }
+                fn(thread_id, static_cast<batch_t const&>(batch));
+                advise(range.start, range.stop, MADV_DONTNEED); // file-backed pages are read again from the page cache if needed
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (not error) error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads; ++t) threads.emplace_back(worker, t);
+    std::size_t start = 0;
+    for (std::size_t index = 0; start < mapped.bytes() and not failed; ++index) {
+        std::size_t stop = start + chunk_size >= mapped.bytes() ? mapped.bytes() : realign(start + chunk_size);
+        advise(start, stop, MADV_WILLNEED);
+        if (not queue.push({index, start, stop})) break;
+        start = stop;
+    }
+    queue.close();
+    for (auto& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+inline std::size_t
+chunk_scheduler::get_nthreads() const noexcept
+{
+    return nthreads;
+}
+
+inline std::size_t
+chunk_scheduler::bytes() const noexcept
+{
+    return mapped.bytes();
+}
+
+inline std::size_t
+chunk_scheduler::next_line(std::size_t offset) const noexcept
+{
+    auto eol = static_cast<char const*>(std::memchr(mapped.data() + offset, '\n', mapped.bytes() - offset));
+    return eol ? eol - mapped.data() + 1 : mapped.bytes();
+}
+
+inline std::size_t
+chunk_scheduler::line_start_after(std::size_t offset) const noexcept
+{
+    if (offset == 0 or mapped.data()[offset - 1] == '\n') return offset;
+    return next_line(offset);
+}
+
+inline bool
+chunk_scheduler::is_record_start(std::size_t offset) const noexcept
+{
+    char const* data = mapped.data();
+    if (not fastq) return data[offset] == '>';
+    if (data[offset] != '@') return false;
+    std::size_t separator = next_line(next_line(offset));
+    return separator < mapped.bytes() and data[separator] == '+';
+}
+
+/*
+ * Start of the first record beginning at or after offset (or the end of the file).
+ */
+inline std::size_t
+chunk_scheduler::realign(std::size_t offset) const noexcept
+{
+    std::size_t p = line_start_after(offset);
+    while (p < mapped.bytes() and not is_record_start(p)) p = next_line(p);
+    return p;
+}
+
+inline void
+chunk_scheduler::advise(std::size_t start, std::size_t stop, int advice) const noexcept
+{
+    if (start >= stop) return;
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto base = reinterpret_cast<uintptr_t>(mapped.data());
+    uintptr_t first = (base + start + page - 1) / page * page; // only pages entirely inside the range
+    uintptr_t last = (base + stop) / page * page;
+    if (advice == MADV_WILLNEED) first = (base + start) / page * page; // prefetching neighbour pages is harmless
+    if (first < last) ::madvise(reinterpret_cast<void*>(first), last - first, advice);
+}
+
+} // namespace fastx
+} // namespace io
+
+#endif // FASTX_SCHEDULER_HPP
@@ -0,0 +1,419 @@
+#ifndef GZ_READER_HPP
+#define GZ_READER_HPP
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+#include "bounded_queue.hpp"
+
+namespace io {
+namespace gz {
+
+/*
+ * Reader of gzip (or uncompressed) files decompressing ahead of the consumer on other threads.
+ * Decompressed data flows through a ring of reusable buffers:
+ *  - plain gzip (and uncompressed) files are inflated by one thread with gzread, so that with two or more
+ *    buffers decompression and parsing overlap;
+ *  - BGZF files (bgzip, samtools) are made of independent blocks: one thread reads groups of blocks into the
+ *    buffers and several workers inflate them in parallel, while the consumer reads the buffers in order.
+ * Memory usage is bounded by the number and size of the buffers.
+ * The read() function has the same interface as gzread so that the reader can be plugged into kseq:
+ *     KSEQ_INIT(io::gz::threaded_reader*, io::gz::read)
+ * Not thread-safe: only one consumer thread can read.
+ */
+class threaded_reader
+{
+    public:
+        threaded_reader(std::string const& filename, std::size_t nthreads = 0, std::size_t buffer_size = 1 << 20, std::size_t nbuffers = 0);
+        threaded_reader(threaded_reader const&) = delete;
+        threaded_reader& operator=(threaded_reader const&) = delete;
+        int read(void* buffer, unsigned len); // number of bytes read, 0 at the end of the file
+        bool is_bgzf() const noexcept;
+        ~threaded_reader();
+
+    private:
+        enum class state_t {free, filled, ready};
+
+        struct slot_t {
+            std::vector<uint8_t> compressed; // BGZF blocks (unused for plain gzip)
+            std::vector<char> data; // decompressed bytes
+            state_t state = state_t::free;
+            bool last = false; // no data after this slot
+            std::size_t sequence = 0;
+        };
+
+        bool bgzf;
+        std::size_t chunk_size;
+        std::vector<slot_t> slots;
+        std::size_t consumer_sequence;
+        std::size_t consumer_offset;
+        bool eof;
+        bool stopping;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+        concurrent::bounded_queue<std::size_t> to_inflate;
+        std::FILE* raw;
+        gzFile gzfp;
+        std::thread producer;
+        std::vector<std::thread> workers;
+
+        slot_t* acquire_free(std::size_t sequence);
+        void publish(slot_t& slot, state_t state, bool last);
+        void fail(std::exception_ptr exception);
+        void gzip_loop();
+        void bgzf_loop();
+        void inflate_loop();
+        bool read_bgzf_block(std::vector<uint8_t>& out);
+        static void inflate_blocks(z_stream& strm, std::vector<uint8_t> const& compressed, std::vector<char>& data);
+        static bool bgzf_header(uint8_t const* header, std::size_t len, std::size_t& block_size);
+        static bool is_bgzf_file(std::string const& filename);
+        static std::size_t thread_count(std::size_t nthreads) noexcept;
+        static std::size_t ring_size(std::size_t nbuffers, std::size_t nthreads, bool bgzf) noexcept;
+        void shutdown() noexcept;
+};
+
+inline int read(threaded_reader* reader, void* buffer, unsigned len)
+{
+    return reader->read(buffer, len);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline threaded_reader::threaded_reader(std::string const& filename, std::size_t nthreads, std::size_t buffer_size, std::size_t nbuffers)
+    : bgzf(is_bgzf_file(filename)),
+      chunk_size(buffer_size),
+      slots(ring_size(nbuffers, thread_count(nthreads), bgzf)),
+      consumer_sequence(0),
+      consumer_offset(0),
+      eof(false),
+      stopping(false),
+      error(nullptr),
+      to_inflate(slots.size()), // never full, slots are the real bound
+      raw(nullptr),
+      gzfp(nullptr)
+{
+    if (chunk_size == 0) throw std::invalid_argument("[gz reader] buffers must be at least one byte long");
+    if (bgzf) {
+        if ((raw = std::fopen(filename.c_str(), "rb")) == NULL) throw std::runtime_error("[gz reader] unable to open " + filename);
+    } else {
+        if ((gzfp = gzopen(filename.c_str(), "rb")) == NULL) throw std::runtime_error("[gz reader] unable to open " + filename);
+        gzbuffer(gzfp, 1 << 17);
+    }
+    try {
+        if (bgzf) {
+            producer = std::thread(&threaded_reader::bgzf_loop, this);
+            for (std::size_t i = 0; i < thread_count(nthreads); ++i) workers.emplace_back(&threaded_reader::inflate_loop, this);
+        } else {
+            producer = std::thread(&threaded_reader::gzip_loop, this);
+        }
+    } catch (...) { // the destructor does not run: stop and join the threads already started, close the file
+        shutdown();
+        throw;
+    }
+}
+
+inline int
+threaded_reader::read(void* buffer, unsigned len)
+{
+    unsigned copied = 0;
+    char* out = static_cast<char*>(buffer);
+    while (copied < len and not eof) {
+        slot_t& slot = slots[consumer_sequence % slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            auto ready = [&] {return slot.state == state_t::ready and slot.sequence == consumer_sequence;};
+            cv.wait(lock, [&] {return error or ready();});
+            if (not ready()) std::rethrow_exception(error); // data decompressed before the error is still returned
+        }
+        // the producer does not touch a ready slot, no need to hold the lock while copying
+        const std::size_t available = slot.data.size() - consumer_offset;
+        const std::size_t n = std::min(available, static_cast<std::size_t>(len - copied));
+        if (n) std::memcpy(out + copied, slot.data.data() + consumer_offset, n);
+        copied += n;
+        consumer_offset += n;
+        if (consumer_offset == slot.data.size()) {
+            std::lock_guard<std::mutex> lock(mtx);
+            eof = slot.last;
+            if (not eof) {
+                slot.state = state_t::free;
+                ++consumer_sequence;
+                consumer_offset = 0;
+                cv.notify_all();
+            }
+        }
+    }
+    return static_cast<int>(copied);
+}
+
+inline bool
+threaded_reader::is_bgzf() const noexcept
+{
+    return bgzf;
+}
+
+inline threaded_reader::~threaded_reader()
+{
+    shutdown();
+}
+
+inline void
+threaded_reader::shutdown() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    to_inflate.close();
+    if (producer.joinable()) producer.join();
+    for (auto& w : workers) if (w.joinable()) w.join();
+    if (raw) std::fclose(raw);
+    if (gzfp) gzclose(gzfp);
+}
+
+/*
+ * Waits for the slot of the given sequence number to be released by the consumer (nullptr if stopping).
+ */
+inline threaded_reader::slot_t*
+threaded_reader::acquire_free(std::size_t sequence)
+{
+    slot_t& slot = slots[sequence % slots.size()];
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] {return stopping or slot.state == state_t::free;});
+    if (stopping) return nullptr;
+    slot.sequence = sequence;
+    return &slot;
+}
+
+inline void
+threaded_reader::publish(slot_t& slot, state_t state, bool last)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        slot.state = state;
+        slot.last = last;
+    }
+    cv.notify_all();
+}
+
+inline void
+threaded_reader::fail(std::exception_ptr exception)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (not error) error = exception;
+        stopping = true;
+    }
+    cv.notify_all();
+    to_inflate.close();
+}
+
+inline void
+threaded_reader::gzip_loop()
+{
+    try {
+        for (std::size_t sequence = 0;; ++sequence) {
+            slot_t* slot = acquire_free(sequence);
+            if (not slot) return;
+            slot->data.resize(chunk_size);
+            std::size_t filled = 0;
+            while (filled < chunk_size) { // gzread may return less than asked
+                int n = gzread(gzfp, slot->data.data() + filled, static_cast<unsigned>(std::min(chunk_size - filled, std::size_t(1) << 30)));
+                if (n < 0) {
+                    int errnum;
+                    throw std::runtime_error(std::string("[gz reader] ") + gzerror(gzfp, &errnum));
+                }
+                if (n == 0) break;
+                filled += n;
+            }
+            slot->data.resize(filled);
+            const bool last = filled < chunk_size;
+            publish(*slot, state_t::ready, last);
+            if (last) return;
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+}
+
+/*
+ * Reads groups of whole BGZF blocks (about buffer_size decompressed bytes) into the free slots and
+ * queues them for the inflating workers. An empty group marks the end of the file.
+ */
+inline void
+threaded_reader::bgzf_loop()
+{
+    try {
+        for (std::size_t sequence = 0;; ++sequence) {
+            slot_t* slot = acquire_free(sequence);
+            if (not slot) return;
+            slot->compressed.clear();
+            bool more = true;
+            std::size_t decompressed_size = 0;
+            while (decompressed_size < chunk_size and (more = read_bgzf_block(slot->compressed))) {
+                uint32_t isize;
+                std::memcpy(&isize, slot->compressed.data() + slot->compressed.size() - 4, 4);
+                decompressed_size += isize;
+            }
+            if (slot->compressed.empty()) {
+                slot->data.clear();
+                publish(*slot, state_t::ready, true);
+                return;
+            }
+            publish(*slot, state_t::filled, false);
+            if (not to_inflate.push(sequence)) return;
+            if (not more) { // the next slot only signals the end of the file
+                slot = acquire_free(++sequence);
+                if (not slot) return;
+                slot->data.clear();
+                publish(*slot, state_t::ready, true);
+                return;
+            }
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+}
+
+inline void
+threaded_reader::inflate_loop()
+{
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -15) != Z_OK) { // raw deflate, headers are parsed by hand
+        fail(std::make_exception_ptr(std::runtime_error("[gz reader] inflateInit2 failed")));
+        return;
+    }
+    std::size_t sequence;
+    while (to_inflate.pop(sequence)) {
+        slot_t& slot = slots[sequence % slots.size()];
+        try {
+            inflate_blocks(strm, slot.compressed, slot.data);
+        } catch (...) {
+            fail(std::current_exception());
+            break;
+        }
+        publish(slot, state_t::ready, false);
+    }
+    inflateEnd(&strm);
+}
+
+/*
+ * Appends the next BGZF block to out, false at the end of the file.
+ */
+inline bool
+threaded_reader::read_bgzf_block(std::vector<uint8_t>& out)
+{
+    uint8_t header[18];
+    std::size_t n = std::fread(header, 1, sizeof(header), raw);
+    if (n == 0) return false;
+    std::size_t block_size;
+    if (not bgzf_header(header, n, block_size)) throw std::runtime_error("[gz reader] invalid BGZF block");
+    const std::size_t start = out.size();
+    out.resize(start + block_size);
+    std::memcpy(out.data() + start, header, sizeof(header));
+    if (std::fread(out.data() + start + sizeof(header), 1, block_size - sizeof(header), raw) != block_size - sizeof(header)) {
+        throw std::runtime_error("[gz reader] truncated BGZF block");
+    }
+    return true;
+}
+
+/*
+ * Inflates a sequence of whole BGZF blocks, checking sizes and CRC32s.
+ */
+inline void
+threaded_reader::inflate_blocks(z_stream& strm, std::vector<uint8_t> const& compressed, std::vector<char>& data)
+{
+    std::size_t total = 0;
+    for (std::size_t offset = 0; offset < compressed.size();) { // sizes first, to allocate once
+        std::size_t block_size = 0;
+        if (not bgzf_header(compressed.data() + offset, compressed.size() - offset, block_size) or block_size > compressed.size() - offset) {
+            throw std::runtime_error("[gz reader] invalid BGZF block");
+        }
+        uint32_t isize;
+        std::memcpy(&isize, compressed.data() + offset + block_size - 4, 4);
+        total += isize;
+        offset += block_size;
+    }
+    data.resize(total);
+    std::size_t out_offset = 0;
+    for (std::size_t offset = 0; offset < compressed.size();) {
+        std::size_t block_size = 0;
+        bgzf_header(compressed.data() + offset, compressed.size() - offset, block_size); // already checked above
+        uint8_t const* block = compressed.data() + offset;
+        uint16_t xlen = block[10] | (block[11] << 8);
+        uint32_t crc, isize;
+        std::memcpy(&crc, block + block_size - 8, 4);
+        std::memcpy(&isize, block + block_size - 4, 4);
+        if (inflateReset(&strm) != Z_OK) throw std::runtime_error("[gz reader] inflateReset failed");
+        strm.next_in = const_cast<Bytef*>(block + 12 + xlen);
+        strm.avail_in = static_cast<uInt>(block_size - 12 - xlen - 8);
+        Bytef dummy; // zlib rejects null output buffers (empty blocks)
+        strm.next_out = isize ? reinterpret_cast<Bytef*>(data.data() + out_offset) : &dummy;
+        strm.avail_out = isize;
+        int ret = inflate(&strm, Z_FINISH);
+        if (ret != Z_STREAM_END or strm.avail_out != 0) throw std::runtime_error("[gz reader] corrupted BGZF block");
+        if (crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<Bytef*>(data.data() + out_offset), isize) != crc) throw std::runtime_error("[gz reader] BGZF CRC mismatch");
+        out_offset += isize;
+        offset += block_size;
+    }
+}
+
+inline bool
+threaded_reader::is_bgzf_file(std::string const& filename)
+{
+    uint8_t header[18];
+    std::FILE* fp = std::fopen(filename.c_str(), "rb");
+    if (not fp) throw std::runtime_error("[gz reader] unable to open " + filename);
+    std::size_t len = std::fread(header, 1, sizeof(header), fp);
+    std::fclose(fp);
+    std::size_t block_size;
+    return bgzf_header(header, len, block_size);
+}
+
+inline std::size_t
+threaded_reader::thread_count(std::size_t nthreads) noexcept
+{
+    return nthreads ? nthreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*
+ * Two buffers are enough to overlap a single decompression thread with the consumer,
+ * BGZF needs a few buffers per worker to keep all of them busy.
+ */
+inline std::size_t
+threaded_reader::ring_size(std::size_t nbuffers, std::size_t nthreads, bool bgzf) noexcept
+{
+    if (nbuffers == 0) nbuffers = bgzf ? 2 * nthreads + 2 : 2;
+    return std::max(nbuffers, std::size_t(2));
+}
+
+/*
+ * Recognizes a BGZF block header (gzip member with a 'BC' extra subfield) and gets the total block size.
+ */
+inline bool
+threaded_reader::bgzf_header(uint8_t const* header, std::size_t len, std::size_t& block_size)
+{
+    if (len < 18 or header[0] != 31 or header[1] != 139 or header[2] != 8 or not (header[3] & 4)) return false;
+    const std::size_t xlen = header[10] | (header[11] << 8);
+    if (xlen < 6 or header[12] != 'B' or header[13] != 'C' or header[14] != 2 or header[15] != 0) return false; // bgzip always writes BC first
+    block_size = (header[16] | (header[17] << 8)) + 1;
+    return block_size >= 12 + xlen + 8;
+}
+
+} // namespace gz
+} // namespace io
+
+#endif // GZ_READER_HPP
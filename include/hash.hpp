@@ -4,7 +4,13 @@
 #include <cstddef>
 #include <optional>
 #include <array>
+#include <type_traits>
 #include "../bundled/MurmurHash3.hpp"
+#include "cpu_features.hpp"
+
+#ifdef BIOLIB_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 namespace hash {
 
@@ -40,6 +46,13 @@ class double_hash64
             // return operator()(reinterpret_cast<uint8_t*>(&val), sizeof(T), seed);
             return hash(val, seed);
         }
+
+        /**
+         * Hashes n keys at once, out[i] == hash(in[i], seed).
+         * 64-bit integer keys are processed 4 (AVX2) or 8 (AVX-512) at a time.
+         */
+        template <typename T>
+        static void hash_batch(T const* in, std::array<uint64_t, 2>* out, std::size_t n, uint64_t seed) noexcept;
 };
 
 class hash64
@@ -68,6 +81,13 @@ class hash64
         {
             return hash(reinterpret_cast<uint8_t*>(&val), sizeof(T), seed);
         }
+
+        /**
+         * Hashes n keys at once, out[i] == hash(in[i], seed).
+         * 64-bit integer keys are processed 4 (AVX2) or 8 (AVX-512) at a time.
+         */
+        template <typename T>
+        static void hash_batch(T const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept;
 };
 
 /** David Stafford's (http://zimbry.blogspot.com/2011/09/better-bit-mixing-improving-on.html)
@@ -84,6 +104,325 @@ uint64_t inline remix(uint64_t z) {
     return z ^ (z >> 31);
 }
 
+/**
+ * Inverse of remix: unremix(remix(z)) == z.
+ * Each xorshift is undone by repeating it until the shifted bits fall out of the word,
+ * each multiplication by multiplying by the inverse of the (odd) constant modulo 2^64.
+ */
+uint64_t inline unremix(uint64_t z) {
+    z = z ^ (z >> 31) ^ (z >> 62);
+    z *= 0x319642b2d24d8ec3;
+    z = z ^ (z >> 27) ^ (z >> 54);
+    z *= 0x96de1b173f119089;
+    return z ^ (z >> 30) ^ (z >> 60);
+}
+
+/**
+ * Seeded family of bijective 64-bit hash functions for integer keys (k-mers up to k = 32).
+ * hash(x, seed) = remix(x ^ key(seed)), which costs two multiplications instead of a full MurmurHash3 round,
+ * and can be inverted with invert(), so that sketches storing hashes can recover the original k-mers.
+ */
+class invertible_hash64
+{
+    public:
+        typedef uint64_t hash_type;
+
+        template <typename T>
+        static uint64_t hash(T val, uint64_t seed) noexcept
+        {
+            static_assert(std::is_integral<T>::value and sizeof(T) <= sizeof(uint64_t), "[invertible_hash64] keys must be integers of at most 64 bits");
+            return remix(static_cast<uint64_t>(val) ^ seed_key(seed));
+        }
+
+        static uint64_t invert(uint64_t hval, uint64_t seed) noexcept
+        {
+            return unremix(hval) ^ seed_key(seed);
+        }
+
+        template <typename T>
+        uint64_t operator()(T val, uint64_t seed) const noexcept
+        {
+            return hash(val, seed);
+        }
+
+        /**
+         * Hashes n keys at once, out[i] == hash(in[i], seed).
+         * 64-bit integer keys are processed 4 (AVX2) or 8 (AVX-512) at a time.
+         */
+        template <typename T>
+        static void hash_batch(T const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept;
+
+    private:
+        static uint64_t seed_key(uint64_t seed) noexcept
+        {
+            return remix(seed ^ 0x9e3779b97f4a7c15); // golden ratio, so that seed 0 does not give the identity key
+        }
+};
+
+/**
+ * Generic batch hashing for any hash function family: out[i] = hasher(in[i], seed).
+ */
+template <class HashFunction, typename T, typename HashType>
+void hash_batch(HashFunction const& hasher, T const* in, HashType* out, std::size_t n, uint64_t seed) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i) out[i] = hasher(in[i], seed);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+namespace detail {
+
+/* 
+ * Batch kernels work on 64-bit keys. 
+ * MurmurHash3_x64_128 is specialized for 8-byte keys (no body blocks, a single tail word).
+ * Kernels with Pair = true write both halves of the 128-bit hash (out[2i], out[2i+1]), otherwise only the first one.
+ */
+
+typedef void (*batch_kernel_t)(uint64_t const*, uint64_t*, std::size_t, uint64_t);
+
+static constexpr uint64_t murmur_c1 = 0x87c37b91114253d5ULL;
+static constexpr uint64_t murmur_c2 = 0x4cf5ad432745937fULL;
+static constexpr uint64_t fmix_c1 = 0xff51afd7ed558ccdULL;
+static constexpr uint64_t fmix_c2 = 0xc4ceb9fe1a85ec53ULL;
+static constexpr uint64_t remix_c1 = 0xbf58476d1ce4e5b9ULL;
+static constexpr uint64_t remix_c2 = 0x94d049bb133111ebULL;
+
+inline uint64_t fmix64(uint64_t k) noexcept
+{
+    k ^= k >> 33;
+    k *= fmix_c1;
+    k ^= k >> 33;
+    k *= fmix_c2;
+    return k ^ (k >> 33);
+}
+
+template <bool Pair>
+void murmur_batch_scalar(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        uint64_t k1 = in[i] * murmur_c1;
+        k1 = (k1 << 31) | (k1 >> 33);
+        k1 *= murmur_c2;
+        uint64_t h1 = (seed ^ k1) ^ sizeof(uint64_t);
+        uint64_t h2 = seed ^ sizeof(uint64_t);
+        h1 += h2;
+        h2 += h1;
+        h1 = fmix64(h1);
+        h2 = fmix64(h2);
+        h1 += h2;
+        if constexpr (Pair) {
+            out[2 * i] = h1;
+            out[2 * i + 1] = h2 + h1;
+        } else {
+            out[i] = h1;
+        }
+    }
+}
+
+inline void remix_batch_scalar(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t key) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i) out[i] = remix(in[i] ^ key);
+}
+
+#ifdef BIOLIB_X86_DISPATCH
+
+/* AVX2 has no 64-bit multiplication: combine three 32 x 32 -> 64 bit products (the high x high one overflows anyway) */
+__attribute__((target("avx2")))
+inline __m256i mul64_avx2(__m256i a, __m256i b) noexcept
+{
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+inline __m256i fmix64_avx2(__m256i k) noexcept
+{
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64_avx2(k, _mm256_set1_epi64x(static_cast<int64_t>(fmix_c1)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64_avx2(k, _mm256_set1_epi64x(static_cast<int64_t>(fmix_c2)));
+    return _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+}
+
+template <bool Pair>
+__attribute__((target("avx2")))
+void murmur_batch_avx2(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept
+{
+    const __m256i c1 = _mm256_set1_epi64x(static_cast<int64_t>(murmur_c1));
+    const __m256i c2 = _mm256_set1_epi64x(static_cast<int64_t>(murmur_c2));
+    const __m256i hseed = _mm256_set1_epi64x(static_cast<int64_t>(seed ^ sizeof(uint64_t)));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i k1 = mul64_avx2(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + i)), c1);
+        k1 = _mm256_or_si256(_mm256_slli_epi64(k1, 31), _mm256_srli_epi64(k1, 33));
+        k1 = mul64_avx2(k1, c2);
+        __m256i h1 = _mm256_xor_si256(hseed, k1);
+        __m256i h2 = hseed;
+        h1 = _mm256_add_epi64(h1, h2);
+        h2 = _mm256_add_epi64(h2, h1);
+        h1 = fmix64_avx2(h1);
+        h2 = fmix64_avx2(h2);
+        h1 = _mm256_add_epi64(h1, h2);
+        if constexpr (Pair) {
+            h2 = _mm256_add_epi64(h2, h1);
+            __m256i lo = _mm256_unpacklo_epi64(h1, h2);
+            __m256i hi = _mm256_unpackhi_epi64(h1, h2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h1);
+        }
+    }
+    murmur_batch_scalar<Pair>(in + i, out + (Pair ? 2 * i : i), n - i, seed);
+}
+
+__attribute__((target("avx2")))
+inline void remix_batch_avx2(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t key) noexcept
+{
+    const __m256i k = _mm256_set1_epi64x(static_cast<int64_t>(key));
+    const __m256i c1 = _mm256_set1_epi64x(static_cast<int64_t>(remix_c1));
+    const __m256i c2 = _mm256_set1_epi64x(static_cast<int64_t>(remix_c2));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i z = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + i)), k);
+        z = mul64_avx2(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), c1);
+        z = mul64_avx2(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(z, _mm256_srli_epi64(z, 31)));
+    }
+    remix_batch_scalar(in + i, out + i, n - i, key);
+}
+
+// GCC < 13 warns about the undefined source operand of unmasked AVX-512 shifts/rotations (GCC bug 105593)
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f,avx512dq")))
+inline __m512i fmix64_avx512(__m512i k) noexcept
+{
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(static_cast<int64_t>(fmix_c1)));
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(static_cast<int64_t>(fmix_c2)));
+    return _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+}
+
+template <bool Pair>
+__attribute__((target("avx512f,avx512dq")))
+void murmur_batch_avx512(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept
+{
+    const __m512i c1 = _mm512_set1_epi64(static_cast<int64_t>(murmur_c1));
+    const __m512i c2 = _mm512_set1_epi64(static_cast<int64_t>(murmur_c2));
+    const __m512i hseed = _mm512_set1_epi64(static_cast<int64_t>(seed ^ sizeof(uint64_t)));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i k1 = _mm512_mullo_epi64(_mm512_loadu_si512(in + i), c1);
+        k1 = _mm512_mullo_epi64(_mm512_rol_epi64(k1, 31), c2);
+        __m512i h1 = _mm512_xor_si512(hseed, k1);
+        __m512i h2 = hseed;
+        h1 = _mm512_add_epi64(h1, h2);
+        h2 = _mm512_add_epi64(h2, h1);
+        h1 = fmix64_avx512(h1);
+        h2 = fmix64_avx512(h2);
+        h1 = _mm512_add_epi64(h1, h2);
+        if constexpr (Pair) {
+            h2 = _mm512_add_epi64(h2, h1);
+            const __m512i first = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);
+            const __m512i second = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+            _mm512_storeu_si512(out + 2 * i, _mm512_permutex2var_epi64(h1, first, h2));
+            _mm512_storeu_si512(out + 2 * i + 8, _mm512_permutex2var_epi64(h1, second, h2));
+        } else {
+            _mm512_storeu_si512(out + i, h1);
+        }
+    }
+    murmur_batch_scalar<Pair>(in + i, out + (Pair ? 2 * i : i), n - i, seed);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline void remix_batch_avx512(uint64_t const* in, uint64_t* out, std::size_t n, uint64_t key) noexcept
+{
+    const __m512i k = _mm512_set1_epi64(static_cast<int64_t>(key));
+    const __m512i c1 = _mm512_set1_epi64(static_cast<int64_t>(remix_c1));
+    const __m512i c2 = _mm512_set1_epi64(static_cast<int64_t>(remix_c2));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i z = _mm512_xor_si512(_mm512_loadu_si512(in + i), k);
+        z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_srli_epi64(z, 30)), c1);
+        z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_srli_epi64(z, 27)), c2);
+        _mm512_storeu_si512(out + i, _mm512_xor_si512(z, _mm512_srli_epi64(z, 31)));
+    }
+    remix_batch_scalar(in + i, out + i, n - i, key);
+}
+
+#if defined(__GNUC__) and not defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+template <bool Pair>
+batch_kernel_t select_murmur_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx512()) return murmur_batch_avx512<Pair>;
+    if (cpu::has_avx2()) return murmur_batch_avx2<Pair>;
+#endif
+    return murmur_batch_scalar<Pair>;
+}
+
+inline batch_kernel_t select_remix_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx512()) return remix_batch_avx512;
+    if (cpu::has_avx2()) return remix_batch_avx2;
+#endif
+    return remix_batch_scalar;
+}
+
+template <typename T>
+constexpr bool is_batchable = std::is_integral<T>::value and sizeof(T) == sizeof(uint64_t);
+
+} // namespace detail
+
+template <typename T>
+void 
+double_hash64::hash_batch(T const* in, std::array<uint64_t, 2>* out, std::size_t n, uint64_t seed) noexcept
+{
+    static_assert(sizeof(std::array<uint64_t, 2>) == 2 * sizeof(uint64_t));
+    if constexpr (detail::is_batchable<T>) {
+        static const detail::batch_kernel_t kernel = detail::select_murmur_kernel<true>();
+        kernel(reinterpret_cast<uint64_t const*>(in), reinterpret_cast<uint64_t*>(out), n, static_cast<uint32_t>(seed));
+    } else {
+        for (std::size_t i = 0; i < n; ++i) out[i] = hash(in[i], seed);
+    }
+}
+
+template <typename T>
+void 
+hash64::hash_batch(T const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept
+{
+    if constexpr (detail::is_batchable<T>) {
+        static const detail::batch_kernel_t kernel = detail::select_murmur_kernel<false>();
+        kernel(reinterpret_cast<uint64_t const*>(in), out, n, static_cast<uint32_t>(seed)); // MurmurHash3 seeds are 32-bit
+    } else {
+        for (std::size_t i = 0; i < n; ++i) out[i] = hash(in[i], seed);
+    }
+}
+
+template <typename T>
+void 
+invertible_hash64::hash_batch(T const* in, uint64_t* out, std::size_t n, uint64_t seed) noexcept
+{
+    if constexpr (detail::is_batchable<T>) {
+        static const detail::batch_kernel_t kernel = detail::select_remix_kernel();
+        kernel(reinterpret_cast<uint64_t const*>(in), out, n, seed_key(seed));
+    } else {
+        for (std::size_t i = 0; i < n; ++i) out[i] = hash(in[i], seed);
+    }
+}
+
 }
 
 #endif // HASH_HPP
\ No newline at end of file
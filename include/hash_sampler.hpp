@@ -4,6 +4,9 @@
 #include <cstdint>
 #include <cstddef>
 #include <cassert>
+#include <optional>
+#include <limits>
+#include <stdexcept>
 
 namespace sampler {
 
@@ -8,6 +8,11 @@
 #include <vector>
 #include <utility> // std::pair
 #include <tuple> // TODO with variadic templates
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "backed_vector.hpp"
+#include "memory_mapped_file.hpp"
 
 namespace io {
 
@@ -134,6 +139,9 @@ class loader
         template <class T, class Allocator>
         void visit(std::vector<T, Allocator>& vec);
 
+        template <class T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A>& vec);
+
         template <class T1, class T2>
         void visit(std::pair<T1, T2>& p);
 
@@ -177,6 +185,19 @@ void loader::visit(std::vector<T, Allocator>& vec)
     for (auto& v : vec) visit(v); // because of this
 }
 
+/*
+ * Same format as std::vector, read in one go.
+ */
+template <class T, std::size_t A>
+void loader::visit(memory::map::backed_vector<T, A>& vec)
+{
+    static_assert(std::is_fundamental<T>::value);
+    std::size_t n;
+    basic_load(istrm, n);
+    vec = memory::map::backed_vector<T, A>(n);
+    istrm.read(reinterpret_cast<char*>(vec.data()), n * sizeof(T));
+}
+
 template <class T1, class T2>
 void loader::visit(std::pair<T1, T2>& p)
 {
@@ -197,6 +218,9 @@ class saver
         template <typename T, class Allocator>
         void visit(std::vector<T, Allocator> const& vec);
 
+        template <typename T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A> const& vec);
+
         template <class T1, class T2>
         void visit(std::pair<T1, T2> const& p);
 
@@ -231,6 +255,9 @@ class mut_saver : public saver
         template <typename T, class Allocator>
         void visit(std::vector<T, Allocator>& vec);
 
+        template <typename T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A>& vec);
+
         template <class T1, class T2>
         void visit(std::pair<T1, T2>& p);
 
@@ -256,6 +283,15 @@ void saver::visit(std::vector<T, Allocator> const& vec)
     for (auto& v : vec) visit(v); // because of this
 }
 
+template <typename T, std::size_t A>
+void saver::visit(memory::map::backed_vector<T, A> const& vec)
+{
+    static_assert(std::is_fundamental<T>::value);
+    std::size_t n = vec.size();
+    basic_store(n, ostrm);
+    ostrm.write(reinterpret_cast<char const*>(vec.data()), n * sizeof(T));
+}
+
 template <class T1, class T2>
 void saver::visit(std::pair<T1, T2> const& p)
 {
@@ -282,6 +318,12 @@ void mut_saver::visit(std::vector<T, Allocator>& vec)
     for (auto& v : vec) visit(v); // because of this
 }
 
+template <typename T, std::size_t A>
+void mut_saver::visit(memory::map::backed_vector<T, A>& vec)
+{
+    saver::visit(static_cast<memory::map::backed_vector<T, A> const&>(vec)); // no copy of mapped vectors
+}
+
 template <class T1, class T2>
 void mut_saver::visit(std::pair<T1, T2>& p)
 {
@@ -291,6 +333,169 @@ void mut_saver::visit(std::pair<T1, T2>& p)
 
 //----------------------------------------------------------------------------------------------------------------------------------
 
+/*
+ * Aligned format, for mapped_loader.
+ * Same as the saver's, except that the elements of vectors of fundamental types start at a multiple of alignment
+ * bytes from the beginning of the file (zero padding after the size). mmap returns page-aligned addresses,
+ * so mapped vectors are aligned to cache lines (and to their words) in memory too.
+ */
+static constexpr std::size_t alignment = 64;
+
+class aligned_saver
+{
+    public:
+        aligned_saver(std::ostream& output_stream);
+
+        template <typename T>
+        void visit(T const& var);
+
+        template <typename T, class Allocator>
+        void visit(std::vector<T, Allocator> const& vec);
+
+        template <typename T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A> const& vec);
+
+        template <class T1, class T2>
+        void visit(std::pair<T1, T2> const& p);
+
+        void visit(std::string const& s);
+
+        std::size_t get_byte_size() const {return ostrm.tellp();}
+
+    private:
+        std::ostream& ostrm;
+
+        void pad();
+};
+
+template <typename T>
+void aligned_saver::visit(T const& var)
+{
+    if constexpr (std::is_fundamental<T>::value) {
+        basic_store(var, ostrm);
+    } else {
+        var.visit(*this);
+    }
+}
+
+template <typename T, typename Allocator>
+void aligned_saver::visit(std::vector<T, Allocator> const& vec)
+{
+    std::size_t n = vec.size();
+    basic_store(n, ostrm);
+    if constexpr (std::is_fundamental<T>::value and not std::is_same<T, bool>::value) {
+        pad();
+        ostrm.write(reinterpret_cast<char const*>(vec.data()), n * sizeof(T));
+    } else {
+        for (auto& v : vec) visit(v);
+    }
+}
+
+template <typename T, std::size_t A>
+void aligned_saver::visit(memory::map::backed_vector<T, A> const& vec)
+{
+    static_assert(std::is_fundamental<T>::value);
+    std::size_t n = vec.size();
+    basic_store(n, ostrm);
+    pad();
+    ostrm.write(reinterpret_cast<char const*>(vec.data()), n * sizeof(T));
+}
+
+template <class T1, class T2>
+void aligned_saver::visit(std::pair<T1, T2> const& p)
+{
+    visit(p.first);
+    visit(p.second);
+}
+
+/*
+ * Loader of the aligned format (see aligned_saver) from a memory-mapped file.
+ * Vectors of fundamental types inside memory::map::backed_vector are not read but become views over the mapping,
+ * which stays open as long as one of them is alive: loading takes time proportional to the number of vectors,
+ * not to their size, and processes mapping the same file share its pages.
+ * Everything else (std::vector, std::string, fields) is copied as usual.
+ */
+class mapped_loader
+{
+    public:
+        mapped_loader(std::string const& filename, int adv = memory::map::advice::normal);
+
+        template <class T>
+        void visit(T& var);
+
+        template <class T, class Allocator>
+        void visit(std::vector<T, Allocator>& vec);
+
+        template <class T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A>& vec);
+
+        template <class T1, class T2>
+        void visit(std::pair<T1, T2>& p);
+
+        void visit(std::string& s);
+
+        std::size_t get_byte_size() const {return offset;}
+
+    private:
+        std::shared_ptr<memory::map::file_source<uint8_t> const> source;
+        std::size_t offset;
+
+        uint8_t const* next(std::size_t nbytes); // pointer to the next nbytes of the file
+        void skip_padding();
+        void check_length(std::size_t n, std::size_t element_bytes) const; // n elements fit in the rest of the file
+
+        template <class T>
+        T const* next_array(std::size_t n) {check_length(n, sizeof(T)); return reinterpret_cast<T const*>(next(n * sizeof(T)));}
+};
+
+template <class T>
+void mapped_loader::visit(T& var)
+{
+    if constexpr (std::is_fundamental<T>::value) {
+        basic_parse(next(sizeof(T)), var);
+    } else {
+        var.visit(*this);
+    }
+}
+
+template <class T, typename Allocator>
+void mapped_loader::visit(std::vector<T, Allocator>& vec)
+{
+    std::size_t n;
+    visit(n);
+    if constexpr (std::is_fundamental<T>::value and not std::is_same<T, bool>::value) {
+        skip_padding();
+        auto const* data = next_array<T>(n);
+        vec.resize(n);
+        if (n) std::memcpy(vec.data(), data, n * sizeof(T));
+    } else {
+        check_length(n, 1); // every element takes at least one byte
+        vec.resize(n);
+        for (auto& v : vec) visit(v);
+    }
+}
+
+template <class T, std::size_t A>
+void mapped_loader::visit(memory::map::backed_vector<T, A>& vec)
+{
+    static_assert(std::is_fundamental<T>::value);
+    static_assert(A <= alignment, "[mapped_loader] views are only aligned to io::alignment bytes");
+    std::size_t n;
+    visit(n);
+    skip_padding();
+    auto const* data = next_array<T>(n);
+    vec = memory::map::backed_vector<T, A>(data, n, source);
+}
+
+template <class T1, class T2>
+void mapped_loader::visit(std::pair<T1, T2>& p)
+{
+    visit(p.first);
+    visit(p.second);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
 template <typename Visitor, typename T, class StreamType>
 static std::size_t visit(T& data_structure, StreamType& strm)
 {
@@ -321,6 +526,20 @@ static std::size_t store(T& data_structure, std::string filename)
     return visit<saver, T>(data_structure, strm);
 }
 
+template <typename T>
+static std::size_t store_aligned(T& data_structure, std::string filename) // for load_mapped()
+{
+    std::ofstream strm(filename, std::ios::binary);
+    return visit<aligned_saver, T>(data_structure, strm);
+}
+
+template <typename T>
+static T load_mapped(std::string filename, int adv = memory::map::advice::normal) // file written by store_aligned()
+{
+    mapped_loader ldr(filename, adv);
+    return T::load(ldr);
+}
+
 } // namespace io
 
 #endif // IO_HPP
\ No newline at end of file
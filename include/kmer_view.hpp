@@ -5,9 +5,11 @@
 #include <string>
 #include <optional>
 #include <cassert>
-#include <limits>
+#include <stdexcept>
 
 #include "constants.hpp"
+#include "nt_packing.hpp"
+#include "wide_kmer.hpp"
 #include "hash.hpp"
 
 namespace wrapper {
@@ -52,9 +54,13 @@ class kmer_view
                 KmerType mask;
                 std::size_t shift;
                 KmerType kmer_buffer[2];
+                bool exhausted; // true once the last k-mer has been consumed
                 void find_first_good_kmer();
 
-                friend bool operator==(const_iterator const& a, const_iterator const& b) {return a.parent_view == b.parent_view and a.itr == b.itr;};
+                friend bool operator==(const_iterator const& a, const_iterator const& b) 
+                {
+                    return a.parent_view == b.parent_view and a.itr == b.itr and a.exhausted == b.exhausted;
+                };
                 friend bool operator!=(const_iterator const& a, const_iterator const& b) {return not (a == b);};
         };
 
@@ -65,6 +71,16 @@ class kmer_view
         const_iterator end() const noexcept;
         uint8_t get_k() const noexcept;
 
+        /**
+         * Bulk extraction of all the valid k-mers of the view into caller-provided buffers.
+         * K-mers containing bases different than ACGT are skipped without emitting break markers.
+         * @param out buffer of at least max_kmers elements receiving the (canonical, if requested) k-mers.
+         * @param positions optional buffer (can be nullptr) receiving the starting position of each k-mer.
+         * @param max_kmers capacity of the buffers, a sequence of length n has at most n - k + 1 k-mers.
+         * @return the number of k-mers written.
+         */
+        std::size_t extract(KmerType* out, uint32_t* positions, std::size_t max_kmers) const;
+
     private:
         // char const* seq;
         // std::size_t slen;
@@ -93,6 +109,15 @@ kmer_view<KmerType, char_iterator> kmer_view_from_cstr(char const* s, std::size_
     return kmer_view<KmerType, char_iterator> (char_iterator(s), char_iterator(s + len), k, canonical);
 }
 
+/*
+ * Same as kmer_view_from_cstr but the sequence is packed 64 bases at a time by the vectorized encoder
+ * instead of being decoded character by character.
+ */
+template <typename KmerType>
+kmer_view<KmerType, packing::nt_iterator> packed_kmer_view_from_cstr(char const* s, std::size_t len, uint8_t k, bool canonical) {
+    return kmer_view<KmerType, packing::nt_iterator> (packing::nt_iterator(s, s + len), packing::nt_iterator(s + len, s + len), k, canonical);
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
 // template <typename KmerType>
@@ -150,22 +175,54 @@ METHOD_HEADER::get_k() const noexcept
     return klen;
 }
 
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::extract(KmerType* out, uint32_t* positions, std::size_t max_kmers) const
+{
+    if (klen == 0 or out == nullptr) return 0;
+    const KmerType mask = kmer::mask<KmerType>(klen);
+    const std::size_t shift = 2 * (klen - 1);
+    KmerType forward = 0;
+    KmerType reverse = 0;
+    std::size_t bases_since_last_break = 0;
+    std::size_t position = 0;
+    std::size_t count = 0;
+    for (auto itr = itr_start; itr != itr_stop and count < max_kmers; ++itr, ++position) {
+        auto c = packing::nt4_code(itr);
+        if (c < 4) [[likely]] {
+            forward = (forward << 2 | c) & mask;
+            reverse = (reverse >> 2) | (static_cast<KmerType>(3 ^ c) << shift);
+            if (++bases_since_last_break >= klen) {
+                out[count] = (canon and reverse < forward) ? reverse : forward;
+                if (positions) {
+                    if (position >= std::numeric_limits<uint32_t>::max()) throw std::length_error("[k-mer view] positions do not fit in 32 bits");
+                    positions[count] = static_cast<uint32_t>(position + 1 - klen);
+                }
+                ++count;
+            }
+        } else [[unlikely]] {
+            bases_since_last_break = 0;
+        }
+    }
+    return count;
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
 CLASS_HEADER
 METHOD_HEADER::const_iterator::const_iterator(kmer_view const* view, [[maybe_unused]] int dummy_end) noexcept
-    : parent_view(view), itr(parent_view->itr_stop), strand(0), bases_since_last_break(0), position(0), kmer_count(0)
+    : parent_view(view), itr(parent_view->itr_stop), strand(0), bases_since_last_break(0), position(0), kmer_count(0), exhausted(true)
 {
     if (parent_view->klen) shift = 2 * (parent_view->klen - 1);
 }
 
 CLASS_HEADER
 METHOD_HEADER::const_iterator::const_iterator(kmer_view const* view) noexcept
-    : parent_view(view), itr(parent_view->itr_start), strand(0), bases_since_last_break(0), position(0), kmer_count(0)
+    : parent_view(view), itr(parent_view->itr_start), strand(0), bases_since_last_break(0), position(0), kmer_count(0), exhausted(false)
 {
-    if (2 * parent_view->klen != sizeof(mask) * 8) mask = (KmerType(1) << (2 * parent_view->klen)) - 1;
-    else mask = std::numeric_limits<decltype(mask)>::max();
+    mask = kmer::mask<KmerType>(parent_view->klen);
     if (parent_view->klen) shift = 2 * (parent_view->klen - 1);
+    kmer_buffer[0] = kmer_buffer[1] = KmerType(0);
     find_first_good_kmer();
 }
 
@@ -182,17 +239,22 @@ CLASS_HEADER
 typename METHOD_HEADER::const_iterator const&
 METHOD_HEADER::const_iterator::operator++()
 {
-    assert(itr != parent_view->itr_stop);
+    assert(not exhausted);
     ++kmer_count; // ids are for valid k-mer only
     if (bases_since_last_break == 0) {
         find_first_good_kmer();
         return *this;
     }
-    auto c = constants::seq_nt4_table[*itr++];
+    if (itr == parent_view->itr_stop) { // last k-mer already consumed
+        exhausted = true;
+        return *this;
+    }
+    auto c = packing::nt4_code(itr);
+    ++itr;
     ++position;
     if (c < 4) {
         kmer_buffer[0] = (kmer_buffer[0] << 2 | c) & mask;            /* forward m-mer */
-        kmer_buffer[1] = ((kmer_buffer[1] >> 2) | ((3ULL ^ c) << shift)); /* reverse m-mer */
+        kmer_buffer[1] = ((kmer_buffer[1] >> 2) | (KmerType(3 ^ c) << shift)); /* reverse m-mer */
         if (parent_view->canon and kmer_buffer[0] != kmer_buffer[1]) strand = kmer_buffer[0] < kmer_buffer[1] ? 0 : 1;  // strand, if symmetric k-mer then use previous strand
         ++bases_since_last_break;
     } else {
@@ -214,22 +276,22 @@ CLASS_HEADER
 void
 METHOD_HEADER::const_iterator::find_first_good_kmer()
 {
-    assert(itr != parent_view->itr_stop);
     while(itr != parent_view->itr_stop and bases_since_last_break < parent_view->klen) {
-        auto c = constants::seq_nt4_table.at(*itr++);
+        auto c = packing::nt4_code(itr);
+        ++itr;
         ++position;
         if (c < 4) {
             kmer_buffer[0] = (kmer_buffer[0] << 2 | c) & mask;            /* forward m-mer */
-            kmer_buffer[1] = ((kmer_buffer[1] >> 2) | (3ULL ^ c) << shift); /* reverse m-mer */
+            kmer_buffer[1] = ((kmer_buffer[1] >> 2) | (KmerType(3 ^ c) << shift)); /* reverse m-mer */
             if (parent_view->canon and kmer_buffer[0] != kmer_buffer[1]) strand = kmer_buffer[0] < kmer_buffer[1] ? 0 : 1;
             ++bases_since_last_break;
         } else {
             bases_since_last_break = 0;
         }
     }
-    if (bases_since_last_break < parent_view->klen) { // deals with N's at the end of sequences, otherwise infinite loop
+    if (bases_since_last_break < parent_view->klen) { // deals with N's (or too few bases) at the end of sequences
         bases_since_last_break = 0;
-        ++itr;
+        exhausted = true;
     }
 }
 
@@ -9,6 +9,7 @@
 #include <string>
 #include <chrono>
 #include <cassert>
+#include "backed_vector.hpp"
 
 // #include <iostream>
 
@@ -42,6 +43,9 @@ class libra
         template <typename T, class Allocator>
         void visit(std::vector<T, Allocator> const& vec) noexcept;
 
+        template <typename T, std::size_t A>
+        void visit(memory::map::backed_vector<T, A> const& vec) noexcept;
+
         void visit(std::string const& s) noexcept;
 
         std::size_t get_byte_size() const noexcept;
@@ -75,6 +79,14 @@ void libra::visit(std::vector<T, Allocator> const& vec) noexcept
     // }
 }
 
+template <typename T, std::size_t A>
+void libra::visit(memory::map::backed_vector<T, A> const& vec) noexcept
+{
+    auto n = vec.size();
+    visit(n);
+    acc += n * sizeof(T);
+}
+
 template <class ClockType, typename MeasurementType>
 class timer
 {
@@ -210,7 +210,7 @@ void file<T>::close()
         if(ref_count == nullptr or *ref_count == 0) throw std::runtime_error("[mm::file] reference count is already 0 before decrement");
         --(*ref_count);
         if (*ref_count == 0) {
-            if (munmap((char*)m_data, m_size) == -1) throw std::runtime_error("[mm::file] munmap failed when closing file");
+            if (m_data and munmap((char*)m_data, m_size) == -1) throw std::runtime_error("[mm::file] munmap failed when closing file");
             ::close(m_fd);
             delete ref_count;
         }
@@ -242,8 +242,10 @@ void file_source<T>::open(std::string const& path, int adv)
     struct stat fs;
     if (fstat(base::m_fd, &fs) == -1) throw std::runtime_error("[mm::file] cannot stat file");
     base::m_size = fs.st_size;
-    base::m_data = mmap<T const*>(base::m_fd, base::m_size, PROT_READ);
-    if (posix_madvise((void*)base::m_data, base::m_size, adv)) throw std::runtime_error("[mm::file] madvise failed");
+    if (base::m_size) { // empty files cannot be mapped
+        base::m_data = mmap<T const*>(base::m_fd, base::m_size, PROT_READ);
+        if (posix_madvise((void*)base::m_data, base::m_size, adv)) throw std::runtime_error("[mm::file] madvise failed");
+    }
     base::ref_count = new std::size_t;
     *base::ref_count = 1;
 }
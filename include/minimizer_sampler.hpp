@@ -43,7 +43,7 @@ class minimizer_sampler
 
                 friend bool operator==(const_iterator const& a, const_iterator const& b) 
                 {
-                    bool same_parent = a.parent_sampler == b.parent_sampler
+                    bool same_parent = a.parent_sampler == b.parent_sampler;
                     bool same_start = a.itr_start == b.itr_start;
                     return same_parent and same_start;
                 };
@@ -143,22 +143,26 @@ template <class Iterator, typename HashFunctionFamily>
 void minimizer_sampler<Iterator, HashFunctionFamily>::const_iterator::reset_window()
 {
     minpos = 0;
-    for (std::size_t widx = 0; itr_start != parent_sampler->itr_stop and widx < parent_sampler->w; ++widx) {
-        auto item = *itr_start++;
-        if (not item) {
+    widx = 0;
+    while (itr_start != parent_sampler->itr_stop and widx < parent_sampler->w) {
+        value_type item = *itr_start++;
+        if (not item) { // restart after a break
             widx = 0;
             minpos = 0;
         } else {
-            window[widx] = {*item, parent_sampler->mhash(*item, parent_sampler->mseed)};
-            if (window[widx].hash_value > window[minpos].hash_value) minpos = widx;
+            window[widx] = {item, parent_sampler->mhash(item, parent_sampler->mseed)};
+            if (window[widx].hash_value < window[minpos].hash_value) minpos = widx;
+            ++widx;
         }
     }
+    widx %= parent_sampler->w;
 }
 
 template <class Iterator, typename HashFunctionFamily>
 void minimizer_sampler<Iterator, HashFunctionFamily>::const_iterator::find_new_min()
 {
-    for (std::size_t i = widx, minpos = widx; i < window.size(); ++i) {
+    minpos = widx;
+    for (std::size_t i = widx; i < window.size(); ++i) {
         if (window[minpos].hash_value > window[i].hash_value) minpos = i;
     }
     for (std::size_t i = 0; i < widx; ++i) {
@@ -3,14 +3,27 @@
 
 #include <type_traits>
 #include <array>
+#include <vector>
 #include <string>
+#include <limits>
+#include <cassert>
+#include <stdexcept>
 #include "constants.hpp"
+#include "nt_packing.hpp"
+#include "wide_kmer.hpp"
 
 namespace wrapper {
 
 #define CLASS_HEADER template <typename KmerType, typename MinimizerType, typename HashFunction, typename Iterator>
 #define METHOD_HEADER minimizer_view<KmerType, MinimizerType, HashFunction, Iterator>
 
+/*
+ * View over the distinct minimizers of the k-mers of a sequence.
+ * The minimizer of a k-mer is its m-mer of minimum hash (the leftmost one in case of ties).
+ * Consecutive k-mers sharing the same minimizer are collapsed, so the iterator moves to the next element
+ * only when the minimizer changes (a smaller m-mer enters the window or the current one falls out of it).
+ * Bases different from ACGT break the sequence: k-mers spanning them have no minimizer.
+ */
 CLASS_HEADER
 class minimizer_view
 {
@@ -20,8 +33,8 @@ class minimizer_view
             public:
                 struct minimizer_context_t {
                     MinimizerType value; // 2-bit packed minimizer
-                    std::size_t position; // minimizer index from start
-                    std::size_t id; // unique id for current view
+                    std::size_t position; // starting position of the minimizer in the sequence
+                    std::size_t id; // unique id for current view (index among the valid m-mers)
                 };
                 using iterator_category = std::forward_iterator_tag;
                 using difference_type   = std::ptrdiff_t;
@@ -35,8 +48,17 @@ class minimizer_view
                 const_iterator const& operator++();
                 const_iterator operator++(int);
                 std::size_t break_offset() const noexcept;
-            
+                std::size_t kmer_start() const noexcept; // position of the first k-mer having the current minimizer
+                std::size_t run_start() const noexcept; // first base of the ACGT run containing the current minimizer
+                std::size_t last_run_end() const noexcept; // end (exclusive) of the last closed run of at least k bases
+
             private:
+                /*
+                 * Monotone deque of the m-mers of the current window: hashes are non-decreasing from front to back,
+                 * so the front is the (leftmost) minimum.
+                 * Each m-mer is pushed and popped at most once, hence O(1) amortized time per base.
+                 * At most w = k - m + 1 m-mers are alive at the same time, so a fixed power-of-two ring buffer suffices.
+                 */
                 class window
                 {
                     public:
@@ -44,40 +66,40 @@ class minimizer_view
                             typename std::invoke_result<HashFunction, MinimizerType, uint64_t>::type mm_hash; // ATTENTION: uint64_t = seed type
                         };
 
-                        window(std::size_t maximum_size) noexcept;
-                        bool push_back(mm_context_t elem);
-                        bool pop_back();
-                        bool pop_front();
-                        mm_context_t const& front() const;
-                        mm_context_t const& back() const;
-                        mm_context_t const& min() const;
-                        std::size_t maximum_size() const noexcept;
+                        window(std::size_t maximum_size);
+                        void push_back(mm_context_t const& elem) noexcept;
+                        void pop_expired(std::size_t first_valid_position) noexcept;
+                        mm_context_t const& min() const noexcept;
                         std::size_t size() const noexcept;
-                        std::size_t min_shift() const noexcept;
+                        bool empty() const noexcept;
                         void clear() noexcept;
-                    
+
                     private:
                         std::vector<mm_context_t> buffer;
-                        std::size_t first, last;
-                        std::size_t min_idx;
-                        void find_new_min() const;
+                        std::size_t first, last; // free-running indexes, slot = index & mask
+                        std::size_t mask;
                 };
 
                 minimizer_view const* parent_view;
                 Iterator itr;
                 uint8_t strand;
                 std::size_t bases_since_last_break;
-                std::size_t position;
+                std::size_t position; // number of bases read so far
                 std::size_t mmer_count;
+                std::size_t current_kmer_start;
+                std::size_t current_run_start;
+                std::size_t closed_run_end;
+                std::size_t last_reported; // position of the last returned minimizer
                 window buffer;
                 MinimizerType mask;
                 std::size_t shift;
                 std::array<MinimizerType, 2> mm_forward_reverse;
-                std::size_t read_base();
-                void init_window();
+                bool exhausted; // true once the last minimizer has been consumed
+                bool read_base();
+                bool advance();
 
                 friend bool operator==(const_iterator const& a, const_iterator const& b) {
-                    return a.parent_view == b.parent_view and a.itr == b.itr;
+                    return a.parent_view == b.parent_view and a.itr == b.itr and a.exhausted == b.exhausted;
                 }
 
                 friend bool operator!=(const_iterator const& a, const_iterator const& b) {
@@ -85,9 +107,11 @@ class minimizer_view
                 }
         };
 
-        minimizer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical = false) noexcept;
+        minimizer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical = false);
         const_iterator cbegin() const;
         const_iterator cend() const noexcept;
+        const_iterator begin() const;
+        const_iterator end() const noexcept;
         uint8_t get_k() const noexcept;
         uint8_t get_m() const noexcept;
 
@@ -102,55 +126,86 @@ class minimizer_view
 
 template <typename KmerType, typename MmerType, typename HashFunction>
 minimizer_view<KmerType, MmerType, HashFunction, std::string::const_iterator> minimizer_view_from_string(
-    const std::string& s, 
-    uint8_t k, 
+    const std::string& s,
+    uint8_t k,
     uint8_t m,
-    uint64_t seed,  
+    uint64_t seed,
     bool canonical) {
     return minimizer_view<KmerType, MmerType, HashFunction, std::string::const_iterator> (s.cbegin(), s.cend(), k, m, seed, canonical);
 }
 
 template <typename KmerType, typename MmerType, typename HashFunction>
 minimizer_view<KmerType, MmerType, HashFunction, char_iterator> minimizer_view_from_cstr(
-    char const* s, 
-    std::size_t len, 
-    uint8_t k, 
+    char const* s,
+    std::size_t len,
+    uint8_t k,
     uint8_t m,
-    uint64_t seed,  
+    uint64_t seed,
     bool canonical) {
     return minimizer_view<KmerType, MmerType, HashFunction, char_iterator> (char_iterator(s), char_iterator(s + len), k, m, seed, canonical);
 }
 
+template <typename KmerType, typename MmerType, typename HashFunction>
+minimizer_view<KmerType, MmerType, HashFunction, packing::nt_iterator> packed_minimizer_view_from_cstr(
+    char const* s,
+    std::size_t len,
+    uint8_t k,
+    uint8_t m,
+    uint64_t seed,
+    bool canonical) {
+    return minimizer_view<KmerType, MmerType, HashFunction, packing::nt_iterator> (
+        packing::nt_iterator(s, s + len),
+        packing::nt_iterator(s + len, s + len),
+        k, m, seed, canonical
+    );
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
 CLASS_HEADER
-METHOD_HEADER::minimizer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical) noexcept
+METHOD_HEADER::minimizer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical)
     : itr_start(start), itr_stop(stop), klen(k), mlen(m), mseed(seed), canon(canonical)
-{}
+{
+    if (mlen == 0 or mlen > klen) throw std::invalid_argument("[minimizer view] m must be in [1, k]");
+}
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator 
+typename METHOD_HEADER::const_iterator
 METHOD_HEADER::cbegin() const
 {
     return const_iterator(this);
 }
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator 
+typename METHOD_HEADER::const_iterator
 METHOD_HEADER::cend() const noexcept
 {
     return const_iterator(this, 0);
 }
 
 CLASS_HEADER
-uint8_t 
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::begin() const
+{
+    return cbegin();
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::end() const noexcept
+{
+    return cend();
+}
+
+CLASS_HEADER
+uint8_t
 METHOD_HEADER::get_k() const noexcept
 {
     return klen;
 }
 
 CLASS_HEADER
-uint8_t 
+uint8_t
 METHOD_HEADER::get_m() const noexcept
 {
     return mlen;
@@ -159,54 +214,59 @@ METHOD_HEADER::get_m() const noexcept
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
 CLASS_HEADER
-METHOD_HEADER::const_iterator::const_iterator(minimizer_view const* view, int dummy_end)
-    : parent_view(view), itr(parent_view->itr_stop), strand(0), bases_since_last_break(0), position(0), mmer_count(0), buffer(0)
+METHOD_HEADER::const_iterator::const_iterator(minimizer_view const* view, [[maybe_unused]] int dummy_end)
+    : parent_view(view),
+      itr(parent_view->itr_stop),
+      strand(0),
+      bases_since_last_break(0),
+      position(0),
+      mmer_count(0),
+      current_kmer_start(0),
+      current_run_start(0),
+      closed_run_end(0),
+      last_reported(std::numeric_limits<std::size_t>::max()),
+      buffer(0),
+      mask(0),
+      shift(0),
+      exhausted(true)
 {}
 
 CLASS_HEADER
-METHOD_HEADER::const_iterator::const_iterator(minimizer_view const* view) 
-    : parent_view(view), itr(parent_view->itr_start), strand(0), bases_since_last_break(0), position(0), mmer_count(0), buffer(view->klen - view->mlen + 1)
+METHOD_HEADER::const_iterator::const_iterator(minimizer_view const* view)
+    : parent_view(view),
+      itr(parent_view->itr_start),
+      strand(0),
+      bases_since_last_break(0),
+      position(0),
+      mmer_count(0),
+      current_kmer_start(0),
+      current_run_start(0),
+      closed_run_end(0),
+      last_reported(std::numeric_limits<std::size_t>::max()),
+      buffer(view->klen - view->mlen + 1),
+      exhausted(false)
 {
-    // if (parent_view->slen < parent_view->klen) throw std::runtime_error("Unable to initialize super-k-mer iterator on sequence of length " + std::to_string(parent_view->klen) + "with k = " + std::to_string(parent_view->klen) + " and m = " + std::to_string(parent_view->mlen));
     shift = 2 * (parent_view->mlen - 1);
-    mask = (KmerType(1) << (2 * parent_view->mlen)) - 1;
+    mask = kmer::mask<MinimizerType>(parent_view->mlen);
     mm_forward_reverse = {MinimizerType(0), MinimizerType(0)};
-    init_window();
+    exhausted = not advance();
 }
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator::value_type const& 
+typename METHOD_HEADER::const_iterator::value_type const&
 METHOD_HEADER::const_iterator::operator*() const noexcept
 {
+    assert(not exhausted);
     return buffer.min();
 }
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator const& 
+typename METHOD_HEADER::const_iterator const&
 METHOD_HEADER::const_iterator::operator++()
 {
     assert(parent_view);
-    assert(itr != parent_view->itr_stop);
-
-    if (itr != parent_view->itr_stop) {
-        bool new_min = false;
-        do {
-            auto idx = read_base();
-            if (bases_since_last_break >= parent_view->mlen) [[likely]] {
-                typename window::mm_context_t ctx = {
-                    {
-                        mm_forward_reverse[strand], // minimizer value
-                        idx, // position
-                        mmer_count // id
-                    },
-                    HashFunction::hash(mm_forward_reverse[strand], parent_view->mseed) // hash
-                };
-                new_min = buffer.push_back(ctx);
-            } else [[unlikely]] {
-                assert(new_min = false);
-            }
-        } while(not new_min);
-    }
+    assert(not exhausted);
+    exhausted = not advance();
     return *this;
 }
 
@@ -220,159 +280,142 @@ METHOD_HEADER::const_iterator::operator++(int)
 }
 
 CLASS_HEADER
-std::size_t 
+std::size_t
 METHOD_HEADER::const_iterator::break_offset() const noexcept
 {
     return bases_since_last_break;
 }
 
 CLASS_HEADER
-std::size_t 
+std::size_t
+METHOD_HEADER::const_iterator::kmer_start() const noexcept
+{
+    return current_kmer_start;
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::const_iterator::run_start() const noexcept
+{
+    return current_run_start;
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::const_iterator::last_run_end() const noexcept
+{
+    return closed_run_end;
+}
+
+CLASS_HEADER
+bool
 METHOD_HEADER::const_iterator::read_base()
 {
-    auto c = constants::seq_nt4_table.at(static_cast<uint8_t>(*itr++));
+    auto c = packing::nt4_code(itr);
+    ++itr;
     ++position;
     if (c < 4) [[likely]] {
         mm_forward_reverse[0] = (mm_forward_reverse[0] << 2 | c) & mask;            /* forward m-mer */
-        mm_forward_reverse[1] = (mm_forward_reverse[1] >> 2) | (3ULL ^ c) << shift; /* reverse m-mer */
+        mm_forward_reverse[1] = (mm_forward_reverse[1] >> 2) | (MinimizerType(3 ^ c) << shift); /* reverse m-mer */
         if (parent_view->canon && mm_forward_reverse[0] != mm_forward_reverse[1]) strand = mm_forward_reverse[0] < mm_forward_reverse[1] ? 0 : 1;  // if symmetric, use previous strand
         ++bases_since_last_break;
+        return true;
     } else [[unlikely]] {
+        if (bases_since_last_break >= parent_view->klen) closed_run_end = position - 1;
         bases_since_last_break = 0;
         buffer.clear();
+        return false;
     }
-    return position - parent_view->mlen + 1;
 }
 
+/*
+ * Reads bases until the minimizer of the current k-mer differs from the last returned one.
+ * Returns false if the sequence ends first.
+ */
 CLASS_HEADER
-void 
-METHOD_HEADER::const_iterator::init_window()
+bool
+METHOD_HEADER::const_iterator::advance()
 {
-    while(buffer.size() < buffer.maximum_size() and itr != parent_view->itr_stop) {
-        auto idx = read_base();
-        if (bases_since_last_break >= parent_view->mlen) {
-            typename window::mm_context_t ctx = {
-                {
-                    mm_forward_reverse[strand], // minimizer value
-                    idx, // position
-                    mmer_count // id
-                },
-                HashFunction::hash(mm_forward_reverse[strand], parent_view->mseed) // hash
-            };
-            buffer.push_back(ctx);
-            ++mmer_count;
+    const std::size_t k = parent_view->klen;
+    const std::size_t m = parent_view->mlen;
+    while (itr != parent_view->itr_stop) {
+        if (not read_base()) [[unlikely]] continue;
+        if (bases_since_last_break < m) [[unlikely]] continue;
+        typename window::mm_context_t ctx;
+        ctx.value = mm_forward_reverse[strand];
+        ctx.position = position - m;
+        ctx.id = mmer_count++;
+        ctx.mm_hash = HashFunction::hash(mm_forward_reverse[strand], parent_view->mseed);
+        if (position >= k) buffer.pop_expired(position - k); // m-mers starting before the current k-mer
+        buffer.push_back(ctx);
+        if (bases_since_last_break >= k and buffer.min().position != last_reported) {
+            last_reported = buffer.min().position;
+            current_kmer_start = position - k;
+            current_run_start = position - bases_since_last_break;
+            return true;
         }
     }
+    if (bases_since_last_break >= k) closed_run_end = position;
+    return false;
 }
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
 CLASS_HEADER
-METHOD_HEADER::const_iterator::window::window(std::size_t maximum_size) noexcept
+METHOD_HEADER::const_iterator::window::window(std::size_t maximum_size)
+    : first(0), last(0), mask(0)
 {
-    clear();
-    buffer.resize(maximum_size);
-}
-
-CLASS_HEADER
-bool 
-METHOD_HEADER::const_iterator::window::push_back(mm_context_t elem)
-{
-    bool changed = false;
-    buffer.at(last) = elem;
-    if (buffer.at(last).mm_hash < buffer.at(min_idx).mm_hash) {
-        min_idx = last;
-        changed = true;
+    if (maximum_size) {
+        std::size_t capacity = 1;
+        while (capacity < maximum_size) capacity <<= 1;
+        buffer.resize(capacity);
+        mask = capacity - 1;
     }
-    ++last;
-    last = ++last % buffer.size();
-    return changed;
 }
 
 CLASS_HEADER
-bool 
-METHOD_HEADER::const_iterator::window::pop_back()
+void
+METHOD_HEADER::const_iterator::window::push_back(mm_context_t const& elem) noexcept
 {
-    bool recompute = false;
-    if (min_idx == last) recompute = true; 
-    if (last == 0) last = buffer.size();
-    --last;
-    if (recompute) find_new_min();
-    return recompute;
+    while (last != first and elem.mm_hash < buffer[(last - 1) & mask].mm_hash) --last; // equal hashes are kept, so the leftmost one wins
+    assert(last - first < buffer.size());
+    buffer[last++ & mask] = elem;
 }
 
 CLASS_HEADER
-bool 
-METHOD_HEADER::const_iterator::window::pop_front()
+void
+METHOD_HEADER::const_iterator::window::pop_expired(std::size_t first_valid_position) noexcept
 {
-    bool recompute = false;
-    if (first == min_idx) recompute = true;
-    first = (first + 1) % buffer.size();
-    if (recompute) find_new_min();
-    return recompute;
+    while (last != first and buffer[first & mask].position < first_valid_position) ++first;
 }
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator::window::mm_context_t const& 
-METHOD_HEADER::const_iterator::window::front() const
+typename METHOD_HEADER::const_iterator::window::mm_context_t const&
+METHOD_HEADER::const_iterator::window::min() const noexcept
 {
-    return buffer.at(first);
+    assert(not empty());
+    return buffer[first & mask];
 }
 
 CLASS_HEADER
-typename METHOD_HEADER::const_iterator::window::mm_context_t const& 
-METHOD_HEADER::const_iterator::window::back() const
-{
-    return buffer.at(last);
-}
-
-CLASS_HEADER
-typename METHOD_HEADER::const_iterator::window::mm_context_t const& 
-METHOD_HEADER::const_iterator::window::min() const
-{
-    return buffer.at(min_idx);
-}
-
-CLASS_HEADER
-std::size_t 
-METHOD_HEADER::const_iterator::window::maximum_size() const noexcept
-{
-    return buffer.size();
-}
-
-CLASS_HEADER
-std::size_t 
+std::size_t
 METHOD_HEADER::const_iterator::window::size() const noexcept
 {
-    if (first <= last) return last - first;
-    return buffer.size() - (first - last);
+    return last - first;
 }
 
 CLASS_HEADER
-std::size_t 
-METHOD_HEADER::const_iterator::window::min_shift() const noexcept
+bool
+METHOD_HEADER::const_iterator::window::empty() const noexcept
 {
-    if (first <= min_idx) return min_idx - first;
-    return buffer.size() - (first - min_idx);
+    return first == last;
 }
 
 CLASS_HEADER
-void 
+void
 METHOD_HEADER::const_iterator::window::clear() noexcept
 {
     first = last = 0;
-    min_idx = 0;
-}
-
-CLASS_HEADER
-void 
-METHOD_HEADER::const_iterator::window::find_new_min() const
-{
-    min_idx = first;
-    for (std::size_t i = first; i != last; ++i) {
-        i %= buffer.size();
-        if (buffer.at(i).mm_hash < buffer.at(min_idx).mm_hash) min_idx = i;
-    }
 }
 
 #undef CLASS_HEADER
@@ -380,4 +423,4 @@ METHOD_HEADER::const_iterator::window::find_new_min() const
 
 } // namespace wrapper
 
-#endif // MINIMIZER_VIEW_HPP
\ No newline at end of file
+#endif // MINIMIZER_VIEW_HPP
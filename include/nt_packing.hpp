@@ -0,0 +1,236 @@
+#ifndef NT_PACKING_HPP
+#define NT_PACKING_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "constants.hpp"
+#include "cpu_features.hpp"
+
+#ifdef BIOLIB_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace packing {
+
+/*
+ * ASCII -> 2-bit nucleotide encoding (A = 0, C = 1, G = 2, T/U = 3, case insensitive).
+ * Base i of the input is stored at bits [2 * (i % 32), 2 * (i % 32) + 2) of words[i / 32],
+ * while ambiguous characters (anything different from ACGTU) set bit (i % 64) of ambiguous[i / 64].
+ * The 2-bit code of an ambiguous position is 0.
+ * The vectorized kernels process 64 bases per step and are selected at run-time.
+ */
+
+static constexpr std::size_t bases_per_word = 32;
+static constexpr std::size_t bases_per_mask = 64;
+
+inline constexpr std::size_t packed_size(std::size_t len) noexcept {return (len + bases_per_word - 1) / bases_per_word;}
+inline constexpr std::size_t mask_size(std::size_t len) noexcept {return (len + bases_per_mask - 1) / bases_per_mask;}
+
+namespace detail {
+
+typedef void (*kernel_t)(char const*, std::size_t, uint64_t*, uint64_t*);
+
+/* spread the 32 bits of x to the even positions of a 64-bit word */
+inline uint64_t spread_even(uint64_t x) noexcept
+{
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2))  & 0x3333333333333333ULL;
+    x = (x | (x << 1))  & 0x5555555555555555ULL;
+    return x;
+}
+
+/* pack two 32-bit bit-planes (low and high bit of each code) into 32 2-bit codes */
+inline uint64_t interleave(uint32_t low_plane, uint32_t high_plane) noexcept
+{
+    return spread_even(low_plane) | (spread_even(high_plane) << 1);
+}
+
+inline void encode_scalar(char const* seq, std::size_t len, uint64_t* words, uint64_t* ambiguous) noexcept
+{
+    for (std::size_t i = 0; i < packed_size(len); ++i) words[i] = 0;
+    for (std::size_t i = 0; i < mask_size(len); ++i) ambiguous[i] = 0;
+    for (std::size_t i = 0; i < len; ++i) {
+        uint64_t c = constants::seq_nt4_table[static_cast<uint8_t>(seq[i])];
+        if (c < 4) words[i / bases_per_word] |= c << (2 * (i % bases_per_word));
+        else ambiguous[i / bases_per_mask] |= uint64_t(1) << (i % bases_per_mask);
+    }
+}
+
+#ifdef BIOLIB_X86_DISPATCH
+
+__attribute__((target("sse4.2")))
+inline void encode_sse42(char const* seq, std::size_t len, uint64_t* words, uint64_t* ambiguous) noexcept
+{
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i c = _mm_set1_epi8('c');
+    const __m128i g = _mm_set1_epi8('g');
+    const __m128i t = _mm_set1_epi8('t');
+    const __m128i u = _mm_set1_epi8('u');
+    const __m128i three = _mm_set1_epi8(3);
+    std::size_t i = 0;
+    for (; i + bases_per_mask <= len; i += bases_per_mask) {
+        uint64_t lo = 0, hi = 0, valid = 0;
+        for (std::size_t j = 0; j < 4; ++j) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(seq + i + 16 * j));
+            __m128i l = _mm_or_si128(v, fold);
+            __m128i ok = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(l, a), _mm_cmpeq_epi8(l, c)),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(l, g), _mm_cmpeq_epi8(l, t)), _mm_cmpeq_epi8(l, u))
+            );
+            // ((x >> 1) ^ (x >> 2)) & 3 maps A, C, G, T/U (in both cases) to 0, 1, 2, 3
+            __m128i code = _mm_and_si128(_mm_xor_si128(_mm_srli_epi16(v, 1), _mm_srli_epi16(v, 2)), three);
+            code = _mm_and_si128(code, ok);
+            lo |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_slli_epi16(code, 7)))) << (16 * j);
+            hi |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_slli_epi16(code, 6)))) << (16 * j);
+            valid |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ok))) << (16 * j);
+        }
+        words[i / bases_per_word] = interleave(static_cast<uint32_t>(lo), static_cast<uint32_t>(hi));
+        words[i / bases_per_word + 1] = interleave(static_cast<uint32_t>(lo >> 32), static_cast<uint32_t>(hi >> 32));
+        ambiguous[i / bases_per_mask] = ~valid;
+    }
+    if (i < len) encode_scalar(seq + i, len - i, words + i / bases_per_word, ambiguous + i / bases_per_mask);
+}
+
+__attribute__((target("avx2")))
+inline void encode_avx2(char const* seq, std::size_t len, uint64_t* words, uint64_t* ambiguous) noexcept
+{
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    const __m256i a = _mm256_set1_epi8('a');
+    const __m256i c = _mm256_set1_epi8('c');
+    const __m256i g = _mm256_set1_epi8('g');
+    const __m256i t = _mm256_set1_epi8('t');
+    const __m256i u = _mm256_set1_epi8('u');
+    const __m256i three = _mm256_set1_epi8(3);
+    std::size_t i = 0;
+    for (; i + bases_per_mask <= len; i += bases_per_mask) {
+        uint64_t valid = 0;
+        for (std::size_t j = 0; j < 2; ++j) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(seq + i + 32 * j));
+            __m256i l = _mm256_or_si256(v, fold);
+            __m256i ok = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(l, a), _mm256_cmpeq_epi8(l, c)),
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(l, g), _mm256_cmpeq_epi8(l, t)), _mm256_cmpeq_epi8(l, u))
+            );
+            __m256i code = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi16(v, 1), _mm256_srli_epi16(v, 2)), three);
+            code = _mm256_and_si256(code, ok);
+            auto lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(code, 7)));
+            auto hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(code, 6)));
+            words[i / bases_per_word + j] = interleave(lo, hi);
+            valid |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ok))) << (32 * j);
+        }
+        ambiguous[i / bases_per_mask] = ~valid;
+    }
+    if (i < len) encode_scalar(seq + i, len - i, words + i / bases_per_word, ambiguous + i / bases_per_mask);
+}
+
+#endif
+
+template <class Iterator, typename = void>
+struct has_code : std::false_type {};
+
+template <class Iterator>
+struct has_code<Iterator, std::void_t<decltype(std::declval<Iterator const&>().code())>> : std::true_type {};
+
+inline kernel_t select_kernel() noexcept
+{
+#ifdef BIOLIB_X86_DISPATCH
+    if (cpu::has_avx2()) return encode_avx2;
+    if (cpu::has_sse42()) return encode_sse42;
+#endif
+    return encode_scalar;
+}
+
+} // namespace detail
+
+/*
+ * Encodes len characters into packed_size(len) words and mask_size(len) ambiguity masks.
+ * Returns the number of ambiguous characters.
+ */
+inline std::size_t encode(char const* seq, std::size_t len, uint64_t* words, uint64_t* ambiguous) noexcept
+{
+    static const detail::kernel_t kernel = detail::select_kernel();
+    kernel(seq, len, words, ambiguous);
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < mask_size(len); ++i) {
+        if (i == mask_size(len) - 1 and len % bases_per_mask) ambiguous[i] &= (uint64_t(1) << (len % bases_per_mask)) - 1;
+        count += __builtin_popcountll(ambiguous[i]);
+    }
+    return count;
+}
+
+/*
+ * Character iterator over a contiguous sequence that decodes 64 bases at a time.
+ * code() returns the 2-bit encoding of the current base or 4 if the base is ambiguous,
+ * the same values as constants::seq_nt4_table, so that views can skip the per-character lookup.
+ */
+class nt_iterator
+{
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = char;
+        using pointer           = value_type const*;
+        using reference         = value_type const&;
+
+        nt_iterator(char const* ptr, char const* end) noexcept : current(ptr), stop(end), offset(0) {refill();}
+        value_type operator*() const noexcept {return *current;}
+        uint8_t code() const noexcept
+        {
+            if ((ambiguous >> offset) & 1) return 4;
+            return static_cast<uint8_t>((words[offset / bases_per_word] >> (2 * (offset % bases_per_word))) & 3);
+        }
+        nt_iterator const& operator++() noexcept
+        {
+            ++current;
+            if (++offset == bases_per_mask) {
+                offset = 0;
+                refill();
+            }
+            return *this;
+        }
+        nt_iterator operator++(int) noexcept
+        {
+            auto res = *this;
+            operator++();
+            return res;
+        }
+
+    private:
+        char const* current;
+        char const* stop;
+        std::size_t offset;
+        uint64_t words[2];
+        uint64_t ambiguous;
+
+        void refill() noexcept
+        {
+            std::size_t len = static_cast<std::size_t>(stop - current);
+            if (len > bases_per_mask) len = bases_per_mask;
+            words[0] = words[1] = 0;
+            ambiguous = 0;
+            if (len) encode(current, len, words, &ambiguous);
+        }
+
+        friend bool operator==(nt_iterator const& a, nt_iterator const& b) {return a.current == b.current;};
+        friend bool operator!=(nt_iterator const& a, nt_iterator const& b) {return not (a == b);};
+};
+
+/*
+ * 2-bit code of the base pointed by itr, using the pre-packed words when the iterator provides them.
+ */
+template <class Iterator>
+inline uint8_t nt4_code(Iterator const& itr) noexcept
+{
+    if constexpr (detail::has_code<Iterator>::value) return itr.code();
+    else return constants::seq_nt4_table[static_cast<uint8_t>(*itr)];
+}
+
+} // namespace packing
+
+#endif // NT_PACKING_HPP
@@ -0,0 +1,321 @@
+#ifndef NTHASH_VIEW_HPP
+#define NTHASH_VIEW_HPP
+
+#include <string>
+#include <optional>
+#include <limits>
+#include <cassert>
+#include <stdexcept>
+
+#include "constants.hpp"
+#include "nt_packing.hpp"
+
+namespace wrapper {
+
+/*
+ * Rolling (ntHash-style) hashing of the k-mers of a sequence.
+ * Each base is associated to a random 64-bit seed and the hash of a k-mer is the XOR of the seeds of its bases,
+ * each one rotated by its distance from the end of the k-mer.
+ * Moving to the next k-mer only needs to rotate the previous value and to remove/add the seeds of the base
+ * going out/in, so every hash is computed in O(1) independently of k.
+ * The canonical hash is the (wrapping) sum of the forward and reverse-complement hashes,
+ * which is strand-independent and keeps the hashes uniformly distributed (the minimum of the two would not).
+ * Reference: Mohamadi et al., "ntHash: recursive nucleotide hashing", Bioinformatics 2016.
+ */
+
+namespace nthash {
+
+static constexpr uint64_t seed_table[4] = {
+    0x3c8bfbb395c60474ULL, // A
+    0x3193c18562a02b4cULL, // C
+    0x20323ed082572324ULL, // G
+    0x295549f54be24456ULL  // T
+};
+
+inline constexpr uint64_t rol(uint64_t x, unsigned r) noexcept
+{
+    r %= 64;
+    return r ? (x << r) | (x >> (64 - r)) : x;
+}
+
+inline constexpr uint64_t ror(uint64_t x, unsigned r) noexcept
+{
+    r %= 64;
+    return r ? (x >> r) | (x << (64 - r)) : x;
+}
+
+} // namespace nthash
+
+struct hashed_kmer_t {
+    uint64_t hash; // rolling hash (canonical if requested)
+    std::size_t position; // position from start
+    std::size_t id; // unique id for current view
+};
+
+#define CLASS_HEADER template <class Iterator>
+#define METHOD_HEADER nthash_view<Iterator>
+
+CLASS_HEADER
+class nthash_view
+{
+    public:
+        class const_iterator
+        {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using difference_type   = std::ptrdiff_t;
+                using value_type        = std::optional<hashed_kmer_t>; // std::nullopt marks sequence breaks (as needed by samplers)
+                using pointer           = value_type*;
+                using reference         = value_type&;
+
+                const_iterator(nthash_view const* view) noexcept;
+                const_iterator(nthash_view const* view, int dummy_end) noexcept;
+                value_type operator*() const noexcept;
+                const_iterator const& operator++();
+                const_iterator operator++(int);
+
+            private:
+                nthash_view const* parent_view;
+                Iterator itr;
+                Iterator tail; // first base of the current k-mer
+                std::size_t bases_since_last_break;
+                std::size_t position;
+                std::size_t kmer_count; // id
+                uint64_t forward;
+                uint64_t reverse;
+                bool exhausted; // true once the last k-mer has been consumed
+                void push_base(uint8_t c) noexcept;
+                void roll_base(uint8_t in, uint8_t out) noexcept;
+                void find_first_good_kmer();
+
+                friend bool operator==(const_iterator const& a, const_iterator const& b)
+                {
+                    return a.parent_view == b.parent_view and a.itr == b.itr and a.exhausted == b.exhausted;
+                };
+                friend bool operator!=(const_iterator const& a, const_iterator const& b) {return not (a == b);};
+        };
+
+        nthash_view(Iterator start, Iterator stop, uint8_t k, bool canonical = false);
+        const_iterator cbegin() const;
+        const_iterator cend() const noexcept;
+        const_iterator begin() const;
+        const_iterator end() const noexcept;
+        uint8_t get_k() const noexcept;
+
+    private:
+        Iterator itr_start;
+        Iterator itr_stop;
+        uint8_t klen;
+        bool canon;
+
+        friend bool operator==(nthash_view const& a, nthash_view const& b)
+        {
+            bool same_range = (a.itr_start == b.itr_start and a.itr_stop == b.itr_stop);
+            bool same_klen = (a.klen == b.klen);
+            bool same_canon = (a.canon == b.canon);
+            return same_range and same_klen and same_canon;
+        };
+        friend bool operator!=(nthash_view const& a, nthash_view const& b) {return not (a == b);};
+};
+
+inline nthash_view<std::string::const_iterator> nthash_view_from_string(const std::string& s, uint8_t k, bool canonical) {
+    return nthash_view<std::string::const_iterator> (s.cbegin(), s.cend(), k, canonical);
+}
+
+inline nthash_view<char_iterator> nthash_view_from_cstr(char const* s, std::size_t len, uint8_t k, bool canonical) {
+    return nthash_view<char_iterator> (char_iterator(s), char_iterator(s + len), k, canonical);
+}
+
+inline nthash_view<packing::nt_iterator> packed_nthash_view_from_cstr(char const* s, std::size_t len, uint8_t k, bool canonical) {
+    return nthash_view<packing::nt_iterator> (packing::nt_iterator(s, s + len), packing::nt_iterator(s + len, s + len), k, canonical);
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+CLASS_HEADER
+METHOD_HEADER::nthash_view(Iterator start, Iterator stop, uint8_t k, bool canonical)
+    : itr_start(start), itr_stop(stop), klen(k), canon(canonical)
+{
+    static_assert(std::is_same<typename Iterator::value_type, char>::value);
+    if (klen == 0) throw std::invalid_argument("[ntHash view] k must be positive");
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::cbegin() const
+{
+    return const_iterator(this);
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::cend() const noexcept
+{
+    return const_iterator(this, 0);
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::begin() const
+{
+    return cbegin();
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::end() const noexcept
+{
+    return cend();
+}
+
+CLASS_HEADER
+uint8_t
+METHOD_HEADER::get_k() const noexcept
+{
+    return klen;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+CLASS_HEADER
+METHOD_HEADER::const_iterator::const_iterator(nthash_view const* view, [[maybe_unused]] int dummy_end) noexcept
+    : parent_view(view), itr(parent_view->itr_stop), tail(parent_view->itr_stop), bases_since_last_break(0), position(0), kmer_count(0), forward(0), reverse(0), exhausted(true)
+{}
+
+CLASS_HEADER
+METHOD_HEADER::const_iterator::const_iterator(nthash_view const* view) noexcept
+    : parent_view(view), itr(parent_view->itr_start), tail(parent_view->itr_start), bases_since_last_break(0), position(0), kmer_count(0), forward(0), reverse(0), exhausted(false)
+{
+    find_first_good_kmer();
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator::value_type
+METHOD_HEADER::const_iterator::operator*() const noexcept
+{
+    assert(position >= parent_view->klen);
+    if (bases_since_last_break == 0) return std::nullopt;
+    return hashed_kmer_t{parent_view->canon ? forward + reverse : forward, position - parent_view->klen, kmer_count};
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator const&
+METHOD_HEADER::const_iterator::operator++()
+{
+    assert(not exhausted);
+    ++kmer_count;
+    if (bases_since_last_break == 0) {
+        find_first_good_kmer();
+        return *this;
+    }
+    if (itr == parent_view->itr_stop) {
+        exhausted = true;
+        return *this;
+    }
+    auto c = packing::nt4_code(itr);
+    ++itr;
+    ++position;
+    if (c < 4) {
+        roll_base(c, packing::nt4_code(tail));
+        ++tail;
+        ++bases_since_last_break;
+    } else {
+        bases_since_last_break = 0;
+    }
+    return *this;
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::const_iterator::operator++(int)
+{
+    auto res = *this;
+    operator++();
+    return res;
+}
+
+CLASS_HEADER
+void
+METHOD_HEADER::const_iterator::push_base(uint8_t c) noexcept
+{
+    forward = nthash::rol(forward, 1) ^ nthash::seed_table[c];
+    reverse = nthash::ror(reverse, 1) ^ nthash::rol(nthash::seed_table[3 ^ c], parent_view->klen - 1);
+}
+
+CLASS_HEADER
+void
+METHOD_HEADER::const_iterator::roll_base(uint8_t in, uint8_t out) noexcept
+{
+    forward = nthash::rol(forward, 1) ^ nthash::rol(nthash::seed_table[out], parent_view->klen) ^ nthash::seed_table[in];
+    reverse = nthash::ror(reverse, 1) ^ nthash::ror(nthash::seed_table[3 ^ out], 1) ^ nthash::rol(nthash::seed_table[3 ^ in], parent_view->klen - 1);
+}
+
+CLASS_HEADER
+void
+METHOD_HEADER::const_iterator::find_first_good_kmer()
+{
+    while(itr != parent_view->itr_stop and bases_since_last_break < parent_view->klen) {
+        auto c = packing::nt4_code(itr);
+        if (c < 4) {
+            if (bases_since_last_break == 0) {
+                tail = itr;
+                forward = reverse = 0;
+            }
+            push_base(c);
+            ++bases_since_last_break;
+        } else {
+            bases_since_last_break = 0;
+        }
+        ++itr;
+        ++position;
+    }
+    if (bases_since_last_break < parent_view->klen) { // N's (or too few bases) at the end of the sequence
+        bases_since_last_break = 0;
+        exhausted = true;
+    }
+}
+
+#undef CLASS_HEADER
+#undef METHOD_HEADER
+
+} // namespace wrapper
+
+namespace hash {
+
+/*
+ * HashFunctionFamily for samplers working on top of a nthash_view.
+ * The hashes are already computed by the view, so seed 0 returns them unchanged while other seeds
+ * derive independent hashes with the ntHash multi-hash scheme (one multiplication and one shift).
+ * Break markers (std::nullopt) hash to the maximum value so that they are never sampled.
+ */
+class rolling_hash64
+{
+    public:
+        typedef uint64_t hash_type;
+
+        rolling_hash64(uint8_t k) noexcept : klen(k) {}
+
+        uint64_t operator()(wrapper::hashed_kmer_t const& kmer, uint64_t seed) const noexcept
+        {
+            if (seed == 0) return kmer.hash;
+            uint64_t h = kmer.hash * (seed ^ (klen * multiseed));
+            return h ^ (h >> multishift);
+        }
+
+        uint64_t operator()(std::optional<wrapper::hashed_kmer_t> const& kmer, uint64_t seed) const noexcept
+        {
+            if (not kmer) return std::numeric_limits<uint64_t>::max();
+            return operator()(*kmer, seed);
+        }
+
+        uint8_t get_k() const noexcept {return klen;}
+
+    private:
+        static constexpr uint64_t multiseed = 0x90b45d39fb6da1faULL;
+        static constexpr unsigned multishift = 27;
+        uint64_t klen;
+};
+
+} // namespace hash
+
+#endif // NTHASH_VIEW_HPP
@@ -4,7 +4,12 @@
 #include <cstdint>
 #include <cstddef>
 #include <vector>
+#include <tuple>
+#include <array>
+#include <utility>
+#include <algorithm>
 #include "bit_operations.hpp"
+#include "backed_vector.hpp"
 #include "logtools.hpp"
 
 #define CLASS_HEADER template <typename UnderlyingType>
@@ -59,6 +64,10 @@ class vector
         T pop_back();
 
         const_reference at(std::size_t index) const;
+        UnderlyingType get(std::size_t index) const noexcept; // same as at(), without bounds checks nor proxy object
+
+        template <typename T>
+        void unpack(std::size_t from, std::size_t count, T* out) const noexcept; // out[i] = get(from + i), unchecked
         reference operator[](std::size_t index);
 
         template <typename T>
@@ -69,7 +78,7 @@ class vector
 
         std::size_t bit_width() const noexcept;
         UnderlyingType const* data() const noexcept;
-        std::vector<UnderlyingType> const& vector_data() const noexcept;
+        memory::map::backed_vector<UnderlyingType> const& vector_data() const noexcept;
         bool empty() const noexcept;
         std::size_t size() const noexcept;
         std::size_t bit_size() const noexcept;
@@ -97,7 +106,7 @@ class vector
 
     private:
         static constexpr std::size_t ut_bit_size = 8 * sizeof(UnderlyingType);
-        std::vector<UnderlyingType> _data;
+        memory::map::backed_vector<UnderlyingType> _data; // can be a view over a memory-mapped file (see io::mapped_loader)
         std::size_t _size;
         std::size_t _bitwidth;
         
@@ -105,6 +114,17 @@ class vector
         std::tuple<std::size_t, long long> index_to_ut_coordinates(std::size_t idx) const noexcept;
         void resize_data(std::size_t size);
 
+        template <typename T>
+        using group_kernel_t = void (*)(UnderlyingType const* cells, T* out) noexcept;
+        template <std::size_t width, std::size_t j>
+        static UnderlyingType extract(UnderlyingType const* cells) noexcept;
+        template <std::size_t width, typename T, std::size_t... j>
+        static void unpack_group(UnderlyingType const* cells, T* out, std::index_sequence<j...>) noexcept;
+        template <std::size_t width, typename T>
+        static void unpack_group(UnderlyingType const* cells, T* out) noexcept {unpack_group<width>(cells, out, std::make_index_sequence<ut_bit_size>());}
+        template <typename T, std::size_t... width>
+        static constexpr std::array<group_kernel_t<T>, ut_bit_size + 1> group_kernels(std::index_sequence<width...>) noexcept {return {{nullptr, &unpack_group<width + 1, T>...}};}
+
         friend bool operator==(vector const& a, vector const& b) 
         {
             bool same_bitwidth = a._bitwidth == b._bitwidth;
@@ -135,7 +155,7 @@ template <typename T>
 void
 METHOD_HEADER::push_back(T val)
 {
-    assert(val < (static_cast<std::size_t>(1) << _bitwidth));
+    assert(_bitwidth == ut_bit_size or val < (static_cast<std::size_t>(1) << _bitwidth));
     // throw std::runtime_error("[packed vector] The value that is being pushed back is wider than the bitwidth");
     resize_data(_size + 1);
     auto [idx, shift] = index_to_ut_coordinates(_size);
@@ -174,6 +194,66 @@ METHOD_HEADER::at(std::size_t index) const
     return const_reference(this, index);
 }
 
+/*
+ * Elements are stored starting from the most significant bits of each cell:
+ * shift the element to the top of a window and then down to the bottom.
+ */
+CLASS_HEADER
+UnderlyingType
+METHOD_HEADER::get(std::size_t index) const noexcept
+{
+    if (not _bitwidth) return 0;
+    const std::size_t bit_idx = index * _bitwidth;
+    const std::size_t idx = bit_idx / ut_bit_size;
+    const std::size_t offset = bit_idx % ut_bit_size;
+    UnderlyingType window = static_cast<UnderlyingType>(_data[idx] << offset);
+    if (offset + _bitwidth > ut_bit_size) window |= static_cast<UnderlyingType>(_data[idx + 1] >> (ut_bit_size - offset));
+    return static_cast<UnderlyingType>(window >> (ut_bit_size - _bitwidth));
+}
+
+/*
+ * Sequential version of get().
+ * Groups of ut_bit_size elements starting at a cell boundary fill exactly _bitwidth cells: they are unpacked by 
+ * kernels compiled for each width, where every shift is a constant. The other elements go through get().
+ */
+CLASS_HEADER
+template <typename T>
+void
+METHOD_HEADER::unpack(std::size_t from, std::size_t count, T* out) const noexcept
+{
+    if (not _bitwidth) {
+        for (std::size_t i = 0; i < count; ++i) out[i] = 0;
+        return;
+    }
+    static constexpr auto kernels = group_kernels<T>(std::make_index_sequence<ut_bit_size>());
+    const std::size_t last_group = _data.size() / _bitwidth; // groups whose last cell may be read by a kernel
+    const std::size_t end = from + count;
+    std::size_t i = from;
+    for (; i < end and i % ut_bit_size; ++i) out[i - from] = static_cast<T>(get(i));
+    for (; i + ut_bit_size <= end and i / ut_bit_size < last_group; i += ut_bit_size) kernels[_bitwidth](_data.data() + i / ut_bit_size * _bitwidth, out + (i - from));
+    for (; i < end; ++i) out[i - from] = static_cast<T>(get(i));
+}
+
+CLASS_HEADER
+template <std::size_t width, std::size_t j>
+UnderlyingType
+METHOD_HEADER::extract(UnderlyingType const* cells) noexcept
+{
+    constexpr std::size_t idx = j * width / ut_bit_size;
+    constexpr std::size_t offset = j * width % ut_bit_size;
+    UnderlyingType window = static_cast<UnderlyingType>(cells[idx] << offset);
+    if constexpr (offset + width > ut_bit_size) window |= static_cast<UnderlyingType>(cells[idx + 1] >> (ut_bit_size - offset));
+    return static_cast<UnderlyingType>(window >> (ut_bit_size - width));
+}
+
+CLASS_HEADER
+template <std::size_t width, typename T, std::size_t... j>
+void
+METHOD_HEADER::unpack_group(UnderlyingType const* cells, T* out, std::index_sequence<j...>) noexcept
+{
+    ((out[j] = static_cast<T>(extract<width, j>(cells))), ...);
+}
+
 CLASS_HEADER
 // template <typename T>
 typename vector<UnderlyingType>::reference 
@@ -213,7 +293,7 @@ METHOD_HEADER::data() const noexcept
 }
 
 CLASS_HEADER
-std::vector<UnderlyingType> const& 
+memory::map::backed_vector<UnderlyingType> const& 
 METHOD_HEADER::vector_data() const noexcept
 {
     return _data;
@@ -392,28 +472,29 @@ CLASS_HEADER
 template <typename IntegerType>
 METHOD_HEADER::reference::operator IntegerType() const
 {
+    vector const* const parent = parent_vector; // const accesses, which never copy a mapped array
     // std::cerr << "--------------- operator cast ----------------\n";
-    auto [idx, shift] = parent_vector->index_to_ut_coordinates(position);
+    auto [idx, shift] = parent->index_to_ut_coordinates(position);
     // std::cerr << "index = " << index << " : idx = " << idx << ", shift = " << shift << "\n";
     if (shift < 0) { // crossing border
-        UnderlyingType buffer = parent_vector->_data.at(idx);
-        UnderlyingType mask_shift = parent_vector->bit_width() + shift;
+        UnderlyingType buffer = parent->_data.at(idx);
+        UnderlyingType mask_shift = parent->bit_width() + shift;
         // std::cerr << "_data[idx] = " << uint64_t(buffer) << "\n";
         // std::cerr << "mask_shift = " << uint64_t(mask_shift) << "\n";
         buffer &= (UnderlyingType(1) << mask_shift) - 1;
         buffer <<= -shift;
-        // auto buffer2 = parent_vector->_data.at(idx + 1) & ~((UnderlyingType(1) << (ut_bit_size - parent_vector->_bitwidth)) - 1);
+        // auto buffer2 = parent->_data.at(idx + 1) & ~((UnderlyingType(1) << (ut_bit_size - parent->_bitwidth)) - 1);
         // buffer |= buffer2 >> (ut_bit_size + shift); // buffer2 was used only for debugging
         // std::cerr << "left part = " << uint64_t(buffer) << "\n";
         // std::cerr << "right part = " << uint64_t(buffer2) << "\n";
-        buffer |= parent_vector->_data.at(idx + 1) >> (parent_vector->ut_bit_size + shift);
+        buffer |= parent->_data.at(idx + 1) >> (parent->ut_bit_size + shift);
         return static_cast<IntegerType>(buffer);
     } else { // perfect fit
-        // std::cerr << "data at(" << idx << ") = " << static_cast<std::size_t>(parent_vector->_data.at(idx)) << "\n";
-        UnderlyingType buffer = parent_vector->_data.at(idx) >> shift;
+        // std::cerr << "data at(" << idx << ") = " << static_cast<std::size_t>(parent->_data.at(idx)) << "\n";
+        UnderlyingType buffer = parent->_data.at(idx) >> shift;
         // std::cerr << static_cast<std::size_t>(buffer) << "\n";
-        if (parent_vector->_bitwidth != parent_vector->ut_bit_size) { // mask if it does not exactly fits the underlying type
-            buffer &= ((static_cast<UnderlyingType>(1) << parent_vector->bit_width())) - 1;
+        if (parent->_bitwidth != parent->ut_bit_size) { // mask if it does not exactly fits the underlying type
+            buffer &= ((static_cast<UnderlyingType>(1) << parent->bit_width())) - 1;
         }
         // std::cerr << static_cast<std::size_t>(buffer) << "\n";
         return static_cast<IntegerType>(buffer);
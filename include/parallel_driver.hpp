@@ -0,0 +1,356 @@
+#ifndef PARALLEL_DRIVER_HPP
+#define PARALLEL_DRIVER_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "constants.hpp"
+#include "kmer_view.hpp"
+#include "minimizer_view.hpp"
+
+namespace wrapper {
+
+/*
+ * Multithreaded iteration over the k-mers (or the minimizers) of a single long sequence.
+ * The sequence is split into chunks owning disjoint ranges of k-mer starting positions.
+ * Each chunk is read together with the k - 1 following bases, so that its last k-mers are complete,
+ * and it is processed by a standard view on one of the worker threads.
+ *
+ * Results have the same positions and values as a sequential view over the whole sequence.
+ * Ids are global ranks (the id of a k-mer is the number of valid k-mers before it, the id of a minimizer
+ * is the number of valid m-mers before it), obtained by a cheap counting pass over the chunks.
+ * K-mers spanning bases different from ACGT are skipped (no break markers are produced).
+ *
+ * Results can be delivered either:
+ *  - unordered, by calling fn(thread_id, item) directly from the worker threads;
+ *  - in sequence order, by calling fn(item) from the calling thread.
+ *    Workers fill per-chunk buffers and can only be a bounded number of chunks ahead of the consumer.
+ */
+class parallel_driver
+{
+    public:
+        struct chunk_t {
+            std::size_t begin; // first k-mer starting position owned by the chunk
+            std::size_t end; // one past the last owned starting position
+        };
+
+        parallel_driver(char const* seq, std::size_t len, std::size_t nthreads, std::size_t min_chunk_size = 1 << 20);
+
+        template <typename KmerType, typename Callback>
+        void for_each_kmer(uint8_t k, bool canonical, Callback&& fn) const;
+
+        template <typename KmerType, typename Callback>
+        void for_each_kmer_ordered(uint8_t k, bool canonical, Callback&& fn) const;
+
+        template <typename KmerType, typename MinimizerType, typename HashFunction, typename Callback>
+        void for_each_minimizer(uint8_t k, uint8_t m, uint64_t seed, bool canonical, Callback&& fn) const;
+
+        template <typename KmerType, typename MinimizerType, typename HashFunction, typename Callback>
+        void for_each_minimizer_ordered(uint8_t k, uint8_t m, uint64_t seed, bool canonical, Callback&& fn) const;
+
+        std::vector<chunk_t> chunks(uint8_t k) const;
+        std::size_t get_nthreads() const noexcept;
+
+    private:
+        char const* sequence;
+        std::size_t slen;
+        std::size_t nthreads;
+        std::size_t min_chunk;
+
+        std::size_t count_valid(std::size_t begin, std::size_t end, std::size_t span) const noexcept;
+        std::vector<std::size_t> rank_offsets(std::vector<chunk_t> const& chunk_list, std::size_t span) const;
+        bool is_valid(std::size_t position, std::size_t span) const noexcept;
+
+        template <typename KmerType, typename Emit>
+        void kmer_chunk(chunk_t chunk, std::size_t id_offset, uint8_t k, bool canonical, Emit&& emit) const;
+
+        template <typename KmerType, typename MinimizerType, typename HashFunction, typename Emit>
+        void minimizer_chunk(chunk_t chunk, std::size_t id_offset, uint8_t k, uint8_t m, uint64_t seed, bool canonical, Emit&& emit) const;
+
+        template <typename Job>
+        void run(std::size_t njobs, Job&& job) const;
+
+        template <typename T, typename Producer, typename Consumer>
+        void run_ordered(std::size_t njobs, Producer&& produce, Consumer&& consume) const;
+};
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+using parallel_minimizer_t = typename minimizer_view<KmerType, MinimizerType, HashFunction, packing::nt_iterator>::const_iterator::value_type;
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline parallel_driver::parallel_driver(char const* seq, std::size_t len, std::size_t threads, std::size_t min_chunk_size)
+    : sequence(seq), slen(len), nthreads(threads), min_chunk(min_chunk_size)
+{
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    if (min_chunk == 0) throw std::invalid_argument("[parallel driver] chunks must own at least one position");
+}
+
+inline std::vector<parallel_driver::chunk_t>
+parallel_driver::chunks(uint8_t k) const
+{
+    std::vector<chunk_t> res;
+    if (k == 0 or slen < k) return res;
+    const std::size_t nstarts = slen - k + 1;
+    std::size_t nchunks = std::min(4 * nthreads, (nstarts + min_chunk - 1) / min_chunk); // a few chunks per thread for load balancing
+    nchunks = std::max(nchunks, std::size_t(1));
+    const std::size_t step = (nstarts + nchunks - 1) / nchunks;
+    for (std::size_t b = 0; b < nstarts; b += step) res.push_back({b, std::min(b + step, nstarts)});
+    return res;
+}
+
+inline std::size_t
+parallel_driver::get_nthreads() const noexcept
+{
+    return nthreads;
+}
+
+template <typename KmerType, typename Callback>
+void
+parallel_driver::for_each_kmer(uint8_t k, bool canonical, Callback&& fn) const
+{
+    auto chunk_list = chunks(k);
+    auto offsets = rank_offsets(chunk_list, k);
+    run(chunk_list.size(), [&](std::size_t thread_id, std::size_t c) {
+        kmer_chunk<KmerType>(chunk_list[c], offsets[c], k, canonical, [&](kmer_context_t<KmerType> const& kmer) {fn(thread_id, kmer);});
+    });
+}
+
+template <typename KmerType, typename Callback>
+void
+parallel_driver::for_each_kmer_ordered(uint8_t k, bool canonical, Callback&& fn) const
+{
+    typedef kmer_context_t<KmerType> item_t;
+    auto chunk_list = chunks(k);
+    auto offsets = rank_offsets(chunk_list, k);
+    run_ordered<item_t>(
+        chunk_list.size(),
+        [&](std::size_t c, std::vector<item_t>& out) {
+            kmer_chunk<KmerType>(chunk_list[c], offsets[c], k, canonical, [&](item_t const& kmer) {out.push_back(kmer);});
+        },
+        fn
+    );
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction, typename Callback>
+void
+parallel_driver::for_each_minimizer(uint8_t k, uint8_t m, uint64_t seed, bool canonical, Callback&& fn) const
+{
+    typedef parallel_minimizer_t<KmerType, MinimizerType, HashFunction> item_t;
+    if (m == 0 or m > k) throw std::invalid_argument("[parallel driver] m must be in [1, k]");
+    auto chunk_list = chunks(k);
+    auto offsets = rank_offsets(chunk_list, m);
+    run(chunk_list.size(), [&](std::size_t thread_id, std::size_t c) {
+        minimizer_chunk<KmerType, MinimizerType, HashFunction>(chunk_list[c], offsets[c], k, m, seed, canonical, [&](item_t const& mm) {fn(thread_id, mm);});
+    });
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction, typename Callback>
+void
+parallel_driver::for_each_minimizer_ordered(uint8_t k, uint8_t m, uint64_t seed, bool canonical, Callback&& fn) const
+{
+    typedef parallel_minimizer_t<KmerType, MinimizerType, HashFunction> item_t;
+    if (m == 0 or m > k) throw std::invalid_argument("[parallel driver] m must be in [1, k]");
+    auto chunk_list = chunks(k);
+    auto offsets = rank_offsets(chunk_list, m);
+    run_ordered<item_t>(
+        chunk_list.size(),
+        [&](std::size_t c, std::vector<item_t>& out) {
+            minimizer_chunk<KmerType, MinimizerType, HashFunction>(chunk_list[c], offsets[c], k, m, seed, canonical, [&](item_t const& mm) {out.push_back(mm);});
+        },
+        fn
+    );
+}
+
+/*
+ * Number of starting positions in [begin, end) followed by span ACGT bases.
+ */
+inline std::size_t
+parallel_driver::count_valid(std::size_t begin, std::size_t end, std::size_t span) const noexcept
+{
+    std::size_t count = 0;
+    std::size_t run_length = 0;
+    const std::size_t stop = std::min(end + span - 1, slen);
+    for (std::size_t i = begin; i < stop; ++i) {
+        if (constants::seq_nt4_table[static_cast<uint8_t>(sequence[i])] < 4) ++run_length;
+        else run_length = 0;
+        count += (run_length >= span);
+    }
+    return count;
+}
+
+/*
+ * Global rank of the first valid span-mer of each chunk, computed by counting the chunks in parallel.
+ */
+inline std::vector<std::size_t>
+parallel_driver::rank_offsets(std::vector<chunk_t> const& chunk_list, std::size_t span) const
+{
+    std::vector<std::size_t> offsets(chunk_list.size(), 0);
+    if (chunk_list.empty()) return offsets;
+    std::vector<std::size_t> counts(chunk_list.size(), 0);
+    run(chunk_list.size() - 1, [&]([[maybe_unused]] std::size_t thread_id, std::size_t c) { // the last chunk never contributes
+        counts[c] = count_valid(chunk_list[c].begin, chunk_list[c + 1].begin, span);
+    });
+    for (std::size_t c = 1; c < chunk_list.size(); ++c) offsets[c] = offsets[c - 1] + counts[c - 1];
+    return offsets;
+}
+
+inline bool
+parallel_driver::is_valid(std::size_t position, std::size_t span) const noexcept
+{
+    if (position + span > slen) return false;
+    for (std::size_t i = position; i < position + span; ++i) {
+        if (constants::seq_nt4_table[static_cast<uint8_t>(sequence[i])] >= 4) return false;
+    }
+    return true;
+}
+
+template <typename KmerType, typename Emit>
+void
+parallel_driver::kmer_chunk(chunk_t chunk, std::size_t id_offset, uint8_t k, bool canonical, Emit&& emit) const
+{
+    const std::size_t stop = std::min(chunk.end + k - 1, slen);
+    auto view = packed_kmer_view_from_cstr<KmerType>(sequence + chunk.begin, stop - chunk.begin, k, canonical);
+    std::size_t id = id_offset;
+    for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
+        auto kmer = *itr;
+        if (not kmer.value) continue;
+        kmer.position += chunk.begin;
+        kmer.id = id++;
+        emit(kmer);
+    }
+}
+
+/*
+ * The first minimizer of a chunk is skipped if it was already reported for the last k-mer of the previous chunk.
+ * This can only happen when the k-mer right before the chunk is valid, so its minimizer is recomputed here
+ * (O(k) time per chunk) instead of synchronizing with the thread processing the previous chunk.
+ */
+template <typename KmerType, typename MinimizerType, typename HashFunction, typename Emit>
+void
+parallel_driver::minimizer_chunk(chunk_t chunk, std::size_t id_offset, uint8_t k, uint8_t m, uint64_t seed, bool canonical, Emit&& emit) const
+{
+    std::size_t duplicate = std::numeric_limits<std::size_t>::max();
+    if (chunk.begin > 0 and is_valid(chunk.begin - 1, k)) {
+        auto previous = packed_minimizer_view_from_cstr<KmerType, MinimizerType, HashFunction>(sequence + chunk.begin - 1, k, k, m, seed, canonical);
+        duplicate = (*previous.cbegin()).position + chunk.begin - 1;
+    }
+    const std::size_t stop = std::min(chunk.end + k - 1, slen);
+    auto view = packed_minimizer_view_from_cstr<KmerType, MinimizerType, HashFunction>(sequence + chunk.begin, stop - chunk.begin, k, m, seed, canonical);
+    for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
+        auto mm = *itr;
+        mm.position += chunk.begin;
+        mm.id += id_offset;
+        if (mm.position == duplicate) continue;
+        emit(mm);
+    }
+}
+
+/*
+ * Runs job(thread_id, job_index) for all jobs on the worker threads (the calling thread is worker 0).
+ * The first exception thrown by a job stops the remaining ones and is rethrown here.
+ */
+template <typename Job>
+void
+parallel_driver::run(std::size_t njobs, Job&& job) const
+{
+    std::atomic<std::size_t> next_job(0);
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+    auto worker = [&](std::size_t thread_id) {
+        try {
+            for (std::size_t j = next_job++; j < njobs; j = next_job++) job(thread_id, j);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (not error) error = std::current_exception();
+            next_job = njobs;
+        }
+    };
+    const std::size_t nworkers = std::max(std::size_t(1), std::min(nthreads, njobs));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < nworkers; ++t) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+/*
+ * Workers produce the items of each chunk into a separate buffer, while the calling thread consumes
+ * the buffers in chunk order. Workers stay at most 2 * nthreads chunks ahead of the consumer to bound memory.
+ */
+template <typename T, typename Producer, typename Consumer>
+void
+parallel_driver::run_ordered(std::size_t njobs, Producer&& produce, Consumer&& consume) const
+{
+    std::vector<std::vector<T>> buffers(njobs);
+    std::vector<bool> ready(njobs, false);
+    std::size_t next_job = 0, consumed = 0;
+    const std::size_t max_ahead = 2 * nthreads;
+    bool abort = false;
+    std::exception_ptr error = nullptr;
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    auto worker = [&]() {
+        while (true) {
+            std::size_t j;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] {return abort or next_job >= njobs or next_job < consumed + max_ahead;});
+                if (abort or next_job >= njobs) return;
+                j = next_job++;
+            }
+            std::vector<T> out;
+            try {
+                produce(j, out);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (not error) error = std::current_exception();
+                abort = true;
+                cv.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            buffers[j].swap(out);
+            ready[j] = true;
+            cv.notify_all();
+        }
+    };
+    const std::size_t nworkers = std::max(std::size_t(1), std::min(nthreads, njobs));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nworkers; ++t) threads.emplace_back(worker);
+
+    try {
+        for (std::size_t j = 0; j < njobs; ++j) {
+            std::vector<T> items;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] {return abort or ready[j];});
+                if (abort) break;
+                items.swap(buffers[j]);
+            }
+            for (auto const& item : items) consume(item);
+            std::lock_guard<std::mutex> lock(mtx);
+            ++consumed;
+            cv.notify_all();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (not error) error = std::current_exception();
+        abort = true;
+        cv.notify_all();
+    }
+    for (auto& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace wrapper
+
+#endif // PARALLEL_DRIVER_HPP
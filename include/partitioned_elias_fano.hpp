@@ -0,0 +1,206 @@
+#ifndef PARTITIONED_ELIAS_FANO_HPP
+#define PARTITIONED_ELIAS_FANO_HPP
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include "backed_vector.hpp"
+#include "bit_vector.hpp"
+#include "packed_vector.hpp"
+#include "rank_select.hpp"
+
+namespace bit {
+namespace ef {
+
+/*
+ * Partitioned Elias-Fano (Ottaviano and Venturini, SIGIR 2014).
+ * The sorted sequence is cut into partitions, each one encoded relatively to the last value of the previous partition
+ * with the cheapest of: a run of consecutive values (no bits at all), a bitmap over its universe, or Elias-Fano with
+ * its own low-bit width. Upper bounds and bit offsets of the partitions are kept in packed vectors: there are
+ * few partitions, so constant-time access is worth the extra bits.
+ * The partitioning is optimal among the ones with boundaries every partition_granularity elements and
+ * partitions of at most max_partition_size elements, which also bounds the linear scans done inside a partition.
+ * Since partitions end on multiples of the granularity, finding the partition of an index is a rank over
+ * one bit per partition_granularity elements, and its ends are at most max_partition_size / partition_granularity
+ * bits away.
+ * Same interface as bit::ef::array (see elias_fano.hpp), duplicates allowed.
+ */
+class partitioned_array
+{
+    public:
+        static constexpr std::size_t partition_granularity = 64;
+        static constexpr std::size_t max_partition_size = 512;
+
+    private:
+        using rs_t = rs::array<bit::vector<uint64_t>, 64, 8, true, false>;
+        using pv_t = packed::vector<uint64_t>;
+        enum encoding : uint8_t {run = 0, bitmap = 1, elias_fano = 2};
+        struct partition {
+            std::size_t idx;
+            std::size_t begin; // index of the first element
+            std::size_t end;
+            std::size_t base; // last value of the previous partition (0 for the first one)
+            std::size_t universe; // last value - base
+            std::size_t offset; // in bits, inside the stream
+            std::size_t width; // low-bit width of Elias-Fano partitions
+            uint8_t type;
+            std::size_t size() const noexcept {return end - begin;}
+            std::size_t high_offset() const noexcept {return offset + size() * width;}
+        };
+
+    public:
+        class const_iterator
+        {
+            public:
+                using iterator_category = std::bidirectional_iterator_tag;
+                using difference_type   = std::ptrdiff_t;
+                using value_type        = std::size_t;
+                using pointer           = value_type*;
+                using reference         = value_type&;
+
+                const_iterator(partitioned_array const& view, std::size_t idx);
+                value_type operator*() const noexcept {return value;}
+                const_iterator const& operator++() noexcept;
+                const_iterator operator++(int) noexcept;
+
+                const_iterator const& operator--() noexcept; // not buffered: random access to the previous element
+                const_iterator operator--(int) noexcept;
+
+            private:
+                static const std::size_t reverse_out_of_bound_marker = std::numeric_limits<std::size_t>::max();
+                partitioned_array const* parent_view;
+                std::size_t index;
+                partition current;
+                std::size_t position; // stream position of the current element (bitmap and high bits of Elias-Fano)
+                value_type value;
+
+                void load_element() noexcept; // sets position and value of index, inside the current partition
+                friend bool operator==(const_iterator const& a, const_iterator const& b)
+                {
+                    bool same_parent = a.parent_view == b.parent_view;
+                    bool same_index = a.index == b.index;
+                    return same_parent and same_index;
+                };
+                friend bool operator!=(const_iterator const& a, const_iterator const& b) {return not (a == b);};
+                friend difference_type operator-(const_iterator const& a, const_iterator const& b)
+                {
+                    bool same_parent = a.parent_view == b.parent_view;
+                    if (not same_parent) throw std::runtime_error("[Partitioned Elias-Fano const_iterator] difference between two un-related iterators");
+                    return a.index - b.index;
+                }
+        };
+
+        partitioned_array() : partition_ends(bit::vector<uint64_t>(0)), upper_bounds(1), offsets(1), _size(0) {}
+
+        template <class Iterator>
+        partitioned_array(Iterator start, Iterator stop);
+
+        template <class Iterator>
+        partitioned_array(Iterator start, std::size_t n);
+
+        partitioned_array(partitioned_array const& other) = default;
+        partitioned_array(partitioned_array&& other) noexcept = default;
+        partitioned_array& operator=(partitioned_array const&) = default;
+        partitioned_array& operator=(partitioned_array&&) noexcept = default;
+
+        std::size_t front() const;
+        std::size_t back() const;
+        std::size_t at(std::size_t idx) const;
+        std::size_t lt_find(std::size_t s, bool ignore_duplicates = false) const; // find the index of the largest element < s
+        std::size_t gt_find(std::size_t s, bool ignore_duplicates = false) const; // find the index of the smallest element > s
+        std::size_t size() const noexcept;
+        std::size_t bit_size() const noexcept;
+        std::size_t partitions() const noexcept;
+
+        const_iterator cbegin() const;
+        const_iterator cend() const;
+        const_iterator begin() const;
+        const_iterator end() const;
+
+        void swap(partitioned_array& other) noexcept;
+
+        template <class Visitor>
+        void visit(Visitor& visitor) const;
+
+        template <class Visitor>
+        void visit(Visitor& visitor);
+
+        template <class Loader>
+        static partitioned_array load(Loader& visitor);
+
+    private:
+        rs_t partition_ends; // one bit per granularity block, set on the last block of each partition
+        pv_t upper_bounds; // last value of each partition
+        pv_t offsets; // bit offset of each partition in the stream
+        memory::map::backed_vector<uint8_t> types;
+        memory::map::backed_vector<uint64_t> stream;
+        std::size_t _size;
+
+        static std::pair<uint8_t, std::size_t> choose_encoding(std::vector<std::size_t> const& values, std::vector<std::size_t> const& duplicates, std::size_t a, std::size_t b); // (type, bits)
+        void build(std::vector<std::size_t> const& values);
+        partition locate(std::size_t idx) const; // partition containing idx
+        partition get_partition(std::size_t p, std::size_t begin) const;
+        std::size_t local_at(partition const& part, std::size_t k, std::size_t& position) const;
+        std::size_t lower_bound(std::size_t s) const; // index of the first element >= s
+
+        friend bool operator==(partitioned_array const& a, partitioned_array const& b);
+        friend bool operator!=(partitioned_array const& a, partitioned_array const& b);
+};
+
+template <class Iterator>
+partitioned_array::partitioned_array(Iterator start, Iterator stop) : partitioned_array()
+{
+    static_assert(not std::numeric_limits<typename std::iterator_traits<Iterator>::value_type>::is_signed, "[Partitioned Elias-Fano] sequence must be unsigned");
+    std::vector<std::size_t> values;
+    for (; start != stop; ++start) values.push_back(*start);
+    build(values);
+}
+
+template <class Iterator>
+partitioned_array::partitioned_array(Iterator start, std::size_t n) : partitioned_array()
+{
+    static_assert(not std::numeric_limits<typename std::iterator_traits<Iterator>::value_type>::is_signed, "[Partitioned Elias-Fano] sequence must be unsigned");
+    std::vector<std::size_t> values;
+    values.reserve(n);
+    for (std::size_t i = 0; i < n; ++i, ++start) values.push_back(*start);
+    build(values);
+}
+
+template <class Visitor>
+void
+partitioned_array::visit(Visitor& visitor) const
+{
+    visitor.visit(partition_ends);
+    visitor.visit(upper_bounds);
+    visitor.visit(offsets);
+    visitor.visit(types);
+    visitor.visit(stream);
+    visitor.visit(_size);
+}
+
+template <class Visitor>
+void
+partitioned_array::visit(Visitor& visitor)
+{
+    visitor.visit(partition_ends);
+    visitor.visit(upper_bounds);
+    visitor.visit(offsets);
+    visitor.visit(types);
+    visitor.visit(stream);
+    visitor.visit(_size);
+}
+
+template <class Loader>
+partitioned_array
+partitioned_array::load(Loader& visitor)
+{
+    partitioned_array r;
+    r.visit(visitor);
+    return r;
+}
+
+} // namespace ef
+} // namespace bit
+
+#endif // PARTITIONED_ELIAS_FANO_HPP
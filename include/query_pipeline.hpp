@@ -0,0 +1,36 @@
+#ifndef QUERY_PIPELINE_HPP
+#define QUERY_PIPELINE_HPP
+
+#include <cstddef>
+
+namespace bit {
+namespace rs {
+
+static const std::size_t batch_prefetch_distance = 16; // queries in flight for each stage
+
+/*
+ * Software-pipelined evaluation of n independent queries.
+ * For each query i, the stages are called in order, distance iterations apart; the last one resolves the query.
+ * Stages issue prefetches for the memory touched by the following stages (a stage can read what the previous one
+ * prefetched), so that the cache misses of up to (stages - 1) * distance queries overlap.
+ * Independent queries issued in a plain loop already overlap in the out-of-order window of the core, so batches
+ * mostly match such a loop (random select1 over 2^28 bits: within noise, 2-3x faster than dependent queries).
+ * The pipeline pays off when the caller's loop body is too long for that window to hold several queries.
+ */
+template <class... Stages>
+void pipeline(std::size_t n, std::size_t distance, Stages&&... stages)
+{
+    constexpr std::size_t nstages = sizeof...(Stages);
+    for (std::size_t i = 0; i < n + (nstages - 1) * distance; ++i) {
+        std::size_t lag = 0;
+        ([&] {
+            if (i >= lag and i - lag < n) stages(i - lag);
+            lag += distance;
+        }(), ...);
+    }
+}
+
+} // namespace rs
+} // namespace bit
+
+#endif // QUERY_PIPELINE_HPP
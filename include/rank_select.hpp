@@ -3,27 +3,34 @@
 
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <utility>
 #include <cassert>
 #include "constants.hpp"
 #include "bit_operations.hpp"
 #include "packed_vector.hpp"
 #include "select_hints.hpp"
+#include "query_pipeline.hpp"
 #include "logtools.hpp"
 
 namespace bit {
 namespace rs {
 
-#define CLASS_HEADER template <typename BitVector, std::size_t block_bit_size, std::size_t super_block_block_size, bool with_select1_hints, bool with_select0_hints>
-#define METHOD_HEADER array<BitVector, block_bit_size, super_block_block_size, with_select1_hints, with_select0_hints>
+#define CLASS_HEADER template <typename BitVector, std::size_t block_bit_size, std::size_t super_block_block_size, bool with_select1_hints, bool with_select0_hints, std::size_t select1_sample_rate, std::size_t select0_sample_rate>
+#define METHOD_HEADER array<BitVector, block_bit_size, super_block_block_size, with_select1_hints, with_select0_hints, select1_sample_rate, select0_sample_rate>
 
 /**
  * Static bitvector rank/select data structure.
  * IMPORTANT rank(i) is defined as the number of 1 strictly before position i.
+ * A non-zero select1_sample_rate (select0_sample_rate) stores the super-block of every select1_sample_rate-th 1 (0)
+ * and uses it to narrow select1 (select0) down to the super-blocks between two samples.
  */
-CLASS_HEADER
+template <typename BitVector, std::size_t block_bit_size, std::size_t super_block_block_size, bool with_select1_hints, bool with_select0_hints, std::size_t select1_sample_rate = 0, std::size_t select0_sample_rate = 0>
 class array 
     : protected select1_hints<with_select1_hints>, 
-      protected select0_hints<with_select0_hints>
+      protected select0_hints<with_select0_hints>,
+      protected select1_samples<select1_sample_rate>,
+      protected select0_samples<select0_sample_rate>
 {
     public:
         using bv_type = BitVector;
@@ -37,6 +44,8 @@ class array
         std::size_t rank0(std::size_t idx) const;
         std::size_t select1(std::size_t idx) const;
         std::size_t select0(std::size_t idx) const;
+        void rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const;
+        void select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const;
         std::size_t size() const noexcept;
         std::size_t size0() const noexcept;
         std::size_t size1() const noexcept;
@@ -58,12 +67,30 @@ class array
         static array load(Loader& visitor);
 
     private:
+        using word_type = typename BitVector::block_type;
+        static constexpr std::size_t word_bit_size = 8 * sizeof(word_type);
+        static constexpr std::size_t super_block_bit_size = block_bit_size * super_block_block_size;
+        static constexpr std::size_t select_ones_per_hint = super_block_bit_size * 2; // must be > super_block_bit_size
+        static constexpr std::size_t select_zeros_per_hint = select_ones_per_hint;
+        static_assert(word_bit_size <= 64, "[rank select] bit-vector blocks must fit into 64 bits");
         BitVector _data;
         packed::vector<max_width_native_type> blocks;
         packed::vector<max_width_native_type> super_blocks;
 
         array();
         void build_index();
+        std::size_t super_blocks_size() const noexcept {return super_blocks.size();}
+        std::size_t super_block_rank1(std::size_t super_block_idx) const {return static_cast<std::size_t>(super_blocks.at(super_block_idx));}
+        std::size_t super_block_rank0(std::size_t super_block_idx) const {return super_block_bit_size * super_block_idx - super_block_rank1(super_block_idx);}
+        std::size_t block_rank1(std::size_t block_idx) const {return static_cast<std::size_t>(blocks.at(block_idx));} // relative to its super-block
+        std::size_t block_rank0(std::size_t block_idx) const {return block_bit_size * (block_idx % super_block_block_size) - block_rank1(block_idx);}
+        std::size_t count_ones(std::size_t start, std::size_t stop) const noexcept;
+        std::size_t select_in_block(std::size_t block_idx, std::size_t th, bool ones) const noexcept;
+        static std::size_t counter_width(std::size_t max_count) noexcept;
+        static word_type low_mask(std::size_t len) noexcept {return static_cast<word_type>((static_cast<uint64_t>(1) << len) - 1);}
+        static void prefetch_counter(packed::vector<max_width_native_type> const& counters, std::size_t idx) noexcept {
+            __builtin_prefetch(counters.data() + idx * counters.bit_width() / bit::size<max_width_native_type>());
+        }
 
         friend bool operator==(array const& a, array const& b) 
         {
@@ -77,26 +104,32 @@ class array
             if constexpr (with_select0_hints) {
                 result &= a.hints0 == b.hints0;
             }
+            if constexpr (select1_sample_rate != 0) {
+                result &= a.samples1 == b.samples1;
+            }
+            if constexpr (select0_sample_rate != 0) {
+                result &= a.samples0 == b.samples0;
+            }
             return result;
         };
         friend bool operator!=(array const& a, array const& b) {return not (a == b);};
 
         // IMPROVEMENTS:
         // - pack each super-block and its blocks together in order to improve locality
-        // - Write specialized class for above problem, replacing the packed vectors 
+        //   (done for 64-bit words by interleaved_array in rank_select_interleaved.hpp)
 };
 
 CLASS_HEADER
 METHOD_HEADER::array()
-    : blocks(packed::vector(static_cast<std::size_t>(std::ceil(std::log2(block_bit_size * super_block_block_size))))), 
-      super_blocks(packed::vector(static_cast<std::size_t>(std::ceil(std::log2(_data.size())))))
+    : blocks(packed::vector(counter_width(super_block_bit_size))), 
+      super_blocks(packed::vector(counter_width(0))) // replaced when loading
 {}
 
 CLASS_HEADER
 METHOD_HEADER::array(BitVector&& vector) 
-    : _data(vector), 
-      blocks(packed::vector(static_cast<std::size_t>(std::ceil(std::log2(block_bit_size * super_block_block_size))))), 
-      super_blocks(packed::vector(static_cast<std::size_t>(std::ceil(std::log2(_data.size())))))
+    : _data(std::move(vector)), 
+      blocks(packed::vector(counter_width(super_block_bit_size))), 
+      super_blocks(packed::vector(counter_width(_data.size())))
 {
     build_index();
 }
@@ -106,18 +139,10 @@ std::size_t
 METHOD_HEADER::rank1(std::size_t idx) const
 {
     if (idx > _data.size()) throw std::out_of_range("[rank1] idx = " + std::to_string(idx) + " with size = " + std::to_string(_data.size()));
-    std::size_t super_block_idx = idx / (super_block_block_size * block_bit_size);
     std::size_t block_idx = idx / block_bit_size;
-    // std::size_t super_rank = super_blocks.template at<std::size_t>(super_block_idx);
-    // std::size_t block_rank = blocks.template at<std::size_t>(block_idx);
-    std::size_t super_rank = static_cast<std::size_t>(super_blocks.at(super_block_idx));
-    std::size_t block_rank = static_cast<std::size_t>(blocks.at(block_idx));
-    std::size_t local_rank = 0;
-    for (auto itr = _data.cbegin() + block_idx * block_bit_size; itr != _data.cbegin() + idx; ++itr) local_rank += *itr; // no pre-computed table here
-    // std::cerr << "super rank [" << super_block_idx << "] = " << super_rank << "\n";
-    // std::cerr << "block rank [" << block_idx << "] = " << block_rank << "\n";
-    // std::cerr << "local rank =" << local_rank << "\n";
-    return super_rank + block_rank + local_rank;
+    std::size_t super_rank = super_block_rank1(idx / super_block_bit_size);
+    std::size_t block_rank = block_rank1(block_idx);
+    return super_rank + block_rank + count_ones(block_idx * block_bit_size, idx);
 }
 
 CLASS_HEADER
@@ -133,15 +158,31 @@ METHOD_HEADER::select1(std::size_t th) const
 {
     assert(th < size1());
     std::size_t a = 0;
-    std::size_t b = _data.size();
-    while(b - a > 1) {
+    std::size_t b = super_blocks_size();
+    if constexpr (select1_sample_rate != 0) {
+        auto const& samples = select1_samples<select1_sample_rate>::samples1;
+        std::size_t k = th / select1_sample_rate;
+        a = samples[k];
+        if (k + 1 < samples.size()) b = samples[k + 1] + 1;
+    } else if constexpr (with_select1_hints) {
+        std::size_t chunk = th / select_ones_per_hint;
+        if (chunk != 0) a = select1_hints<with_select1_hints>::hints1.at(chunk - 1);
+        b = std::min(select1_hints<with_select1_hints>::hints1.at(chunk) + 1, b);
+    }
+    while (b - a > 1) { // last super-block with rank <= th
+        std::size_t mid = a + (b - a) / 2;
+        if (super_block_rank1(mid) <= th) a = mid;
+        else b = mid;
+    }
+    th -= super_block_rank1(a);
+    a *= super_block_block_size;
+    b = a + super_block_block_size;
+    while (b - a > 1) { // last block of the super-block with relative rank <= th
         std::size_t mid = a + (b - a) / 2;
-        // std::cerr << "getting rank1 for idx = " << mid << "\n";
-        std::size_t x = rank1(mid);
-        if (x <= th) a = mid;
+        if (block_rank1(mid) <= th) a = mid;
         else b = mid;
     }
-    return a;
+    return select_in_block(a, th - block_rank1(a), true);
 }
 
 CLASS_HEADER
@@ -150,14 +191,78 @@ METHOD_HEADER::select0(std::size_t th) const
 {
     assert(th < size0());
     std::size_t a = 0;
-    std::size_t b = _data.size();
-    while(b - a > 1) {
+    std::size_t b = super_blocks_size();
+    if constexpr (select0_sample_rate != 0) {
+        auto const& samples = select0_samples<select0_sample_rate>::samples0;
+        std::size_t k = th / select0_sample_rate;
+        a = samples[k];
+        if (k + 1 < samples.size()) b = samples[k + 1] + 1;
+    } else if constexpr (with_select0_hints) {
+        std::size_t chunk = th / select_zeros_per_hint;
+        if (chunk != 0) a = select0_hints<with_select0_hints>::hints0.at(chunk - 1);
+        b = std::min(select0_hints<with_select0_hints>::hints0.at(chunk) + 1, b);
+    }
+    while (b - a > 1) {
+        std::size_t mid = a + (b - a) / 2;
+        if (super_block_rank0(mid) <= th) a = mid;
+        else b = mid;
+    }
+    th -= super_block_rank0(a);
+    a *= super_block_block_size;
+    b = a + super_block_block_size;
+    while (b - a > 1) {
         std::size_t mid = a + (b - a) / 2;
-        std::size_t x = rank0(mid);
-        if (x <= th) a = mid;
+        if (block_rank0(mid) <= th) a = mid;
         else b = mid;
     }
-    return a;
+    return select_in_block(a, th - block_rank0(a), false);
+}
+
+/*
+ * out[i] = rank1(idxs[i]) for i in [0, n).
+ * The counters and the first payload word of upcoming queries are prefetched while the current ones are answered.
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const
+{
+    pipeline(n, batch_prefetch_distance,
+        []([[maybe_unused]] std::size_t i) {},
+        [&](std::size_t i) {
+            std::size_t block_idx = idxs[i] / block_bit_size;
+            prefetch_counter(super_blocks, idxs[i] / super_block_bit_size);
+            prefetch_counter(blocks, block_idx);
+            __builtin_prefetch(_data.data() + block_idx * block_bit_size / word_bit_size);
+        },
+        [&](std::size_t i) {out[i] = rank1(idxs[i]);}
+    );
+}
+
+/*
+ * out[i] = select1(ths[i]) for i in [0, n).
+ * With select hints, the hint of a query is prefetched first and then the super-block counters it points to.
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const
+{
+    pipeline(n, batch_prefetch_distance,
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (with_select1_hints) __builtin_prefetch(select1_hints<with_select1_hints>::hints1.data() + ths[i] / select_ones_per_hint);
+        },
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (with_select1_hints) {
+                auto const& hints = select1_hints<with_select1_hints>::hints1;
+                std::size_t chunk = ths[i] / select_ones_per_hint;
+                std::size_t a = chunk != 0 ? hints[chunk - 1] : 0;
+                std::size_t b = std::min(hints[chunk] + 1, super_blocks_size());
+                prefetch_counter(super_blocks, a);
+                prefetch_counter(super_blocks, b - 1);
+                prefetch_counter(blocks, a * super_block_block_size);
+            }
+        },
+        [&](std::size_t i) {out[i] = select1(ths[i]);}
+    );
 }
 
 CLASS_HEADER
@@ -205,6 +310,10 @@ METHOD_HEADER::swap(array& other) noexcept
     _data.swap(other._data);
     blocks.swap(other.blocks);
     super_blocks.swap(other.super_blocks);
+    std::swap(static_cast<select1_hints<with_select1_hints>&>(*this), static_cast<select1_hints<with_select1_hints>&>(other));
+    std::swap(static_cast<select0_hints<with_select0_hints>&>(*this), static_cast<select0_hints<with_select0_hints>&>(other));
+    std::swap(static_cast<select1_samples<select1_sample_rate>&>(*this), static_cast<select1_samples<select1_sample_rate>&>(other));
+    std::swap(static_cast<select0_samples<select0_sample_rate>&>(*this), static_cast<select0_samples<select0_sample_rate>&>(other));
 }
 
 CLASS_HEADER
@@ -227,61 +336,106 @@ CLASS_HEADER
 void 
 METHOD_HEADER::build_index()
 {
-    const std::size_t super_block_bit_size = super_block_block_size * block_bit_size;
-    std::size_t prev_block_count = 0;
-    std::size_t prev_super_block_count = 0;
-    std::size_t cumulative_block_count = 0;
-    std::size_t index = 0;
-    for (auto itr = _data.cbegin(); itr != _data.cend(); ++itr, ++index) {
-        if (index != 0 and index % block_bit_size == 0) {
-            // std::cerr << "bit width = " << blocks.bit_width() << " ";
-            // std::cerr << "rank of position " << index << " = " << prev_block_count << "\n";
-            blocks.push_back(prev_block_count); // push previous block count
-            prev_block_count = cumulative_block_count;
-            if (index % super_block_bit_size == 0) { // closing super-block
-                super_blocks.push_back(prev_super_block_count);
-                // std::cerr << "pushing " << prev_super_block_count << "\n";
-                prev_super_block_count += cumulative_block_count; // this is the count of the super-block before reinitialisation
-                prev_block_count = 0;
-                cumulative_block_count = 0;
+    // Counters of the last super-block are padded with 0s up to super_block_block_size blocks
+    const std::size_t nsuper_blocks = _data.size() ? (_data.size() + super_block_bit_size - 1) / super_block_bit_size : 1;
+    std::size_t rank = 0;
+    for (std::size_t i = 0; i < nsuper_blocks; ++i) {
+        super_blocks.push_back(rank);
+        std::size_t block_rank = 0;
+        for (std::size_t j = 0; j < super_block_block_size; ++j) {
+            blocks.push_back(block_rank);
+            std::size_t start = std::min(i * super_block_bit_size + j * block_bit_size, _data.size());
+            std::size_t stop = std::min(start + block_bit_size, _data.size());
+            block_rank += count_ones(start, stop);
+        }
+        rank += block_rank;
+    }
+    blocks.resize(blocks.size());
+    super_blocks.resize(super_blocks.size());
+
+    // hints[i] is the first super-block ending after more than (i + 1) * select_ones_per_hint ones (or zeros)
+    if constexpr (with_select1_hints) {
+        std::vector<std::size_t> temp_hints;
+        std::size_t cur_ones_threshold = select_ones_per_hint;
+        for (std::size_t i = 0; i < super_blocks_size(); ++i) {
+            std::size_t next_rank = i + 1 < super_blocks_size() ? super_block_rank1(i + 1) : rank;
+            if (next_rank > cur_ones_threshold) {
+                temp_hints.push_back(i);
+                cur_ones_threshold += select_ones_per_hint;
             }
         }
-        if (*itr) ++cumulative_block_count;
+        temp_hints.push_back(super_blocks_size());
+        select1_hints<with_select1_hints>::hints1 = std::move(temp_hints);
     }
-    // Padding with up-to (super_block_block_size * block_bit_size)
-    if (_data.size() % super_block_bit_size) {
-        // auto round_up = (_data.size() % super_block_bit_size + 1) * super_block_bit_size;
-        auto padding_bits = super_block_bit_size - _data.size() % super_block_bit_size;
-        // std::cerr << "round up = " << round_up << ", padding = " << padding_bits << "\n";
-        for (; index < _data.size() + padding_bits; ++index) {
-            if (index != 0 and index % block_bit_size == 0) {
-                blocks.push_back(prev_block_count); // push previous block count
-                prev_block_count = cumulative_block_count;
-                if (index % super_block_bit_size == 0) { // closing super-block
-                    super_blocks.push_back(prev_super_block_count);
-                    prev_super_block_count = cumulative_block_count; // this is the count of the super-block before reinitialisation
-                    prev_block_count = 0;
-                    cumulative_block_count = 0;
-                }
+
+    if constexpr (with_select0_hints) {
+        std::vector<std::size_t> temp_hints;
+        std::size_t cur_zeros_threshold = select_zeros_per_hint;
+        for (std::size_t i = 0; i < super_blocks_size(); ++i) {
+            std::size_t next_rank = i + 1 < super_blocks_size() ? super_block_rank0(i + 1) : (i + 1) * super_block_bit_size - rank;
+            if (next_rank > cur_zeros_threshold) {
+                temp_hints.push_back(i);
+                cur_zeros_threshold += select_zeros_per_hint;
             }
-            // all padding bits are 0 so no increment of cumulative_block_count
         }
+        temp_hints.push_back(super_blocks_size());
+        select0_hints<with_select0_hints>::hints0 = std::move(temp_hints);
     }
-    blocks.push_back(prev_block_count);
-    super_blocks.push_back(prev_super_block_count);
-    // std::cerr << "prev super block size = " << prev_super_block_count << "\n";
-    // std::cerr << "data size = " << _data.size() << ", index = " << index << ", sb bit size = " << super_block_bit_size << "\n";
-    assert(index % super_block_bit_size == 0);
-    // std::cerr << "blocks size = " << blocks.size() << ", super blocks size = " << super_blocks.size() << "\n";
-    // std::cerr << "blocks made of " << blocks.underlying_size() << " blocks of " << sizeof(bit::max_width_native_type) << " B\n";
-    blocks.resize(blocks.size());
-    super_blocks.resize(super_blocks.size());
-    // std::cerr << "blocks bit size = " << blocks.bit_size() << ", super blocks bit size = " << super_blocks.bit_size() << "\n";
+    select1_samples<select1_sample_rate>::build_samples1(_data.data(), _data.size(), super_block_bit_size);
+    select0_samples<select0_sample_rate>::build_samples0(_data.data(), _data.size(), super_block_bit_size);
+}
+
+/*
+ * Number of 1s in [start, stop), one popcount per block of the bit-vector.
+ */
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::count_ones(std::size_t start, std::size_t stop) const noexcept
+{
+    if (start >= stop) return 0;
+    word_type const* words = _data.data();
+    std::size_t first = start / word_bit_size;
+    std::size_t last = stop / word_bit_size;
+    word_type head = static_cast<word_type>(words[first] >> (start % word_bit_size));
+    if (first == last) return popcount(static_cast<word_type>(head & low_mask(stop - start)));
+    std::size_t r = popcount(head);
+    for (std::size_t i = first + 1; i < last; ++i) r += popcount(words[i]);
+    if (stop % word_bit_size) r += popcount(static_cast<word_type>(words[last] & low_mask(stop % word_bit_size)));
+    return r;
+}
+
+/*
+ * Position of the th-th 1 (or 0) of the bit-vector, counting from the beginning of block block_idx.
+ * The answer is guaranteed to be inside the bit-vector, so bits after the end are never inspected.
+ */
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::select_in_block(std::size_t block_idx, std::size_t th, bool ones) const noexcept
+{
+    word_type const* words = _data.data();
+    std::size_t start = block_idx * block_bit_size;
+    std::size_t i = start / word_bit_size;
+    word_type word = ones ? words[i] : static_cast<word_type>(~words[i]);
+    word = static_cast<word_type>(word & ~low_mask(start % word_bit_size));
+    std::size_t pop = popcount(word);
+    while (pop <= th) {
+        th -= pop;
+        ++i;
+        word = ones ? words[i] : static_cast<word_type>(~words[i]);
+        pop = popcount(word);
+    }
+    return i * word_bit_size + bit::select1(static_cast<uint64_t>(word), th);
+}
 
-    // for (std::size_t i = 0; i < blocks.size(); ++i) { 
-    //     std::cerr << blocks.template at<std::size_t>(i) << ", ";
-    // }
-    // std::cerr << "\n";
+/*
+ * Bits needed to store counts strictly smaller than max_count (packed vectors need at least one bit)
+ */
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::counter_width(std::size_t max_count) noexcept
+{
+    if (max_count < 2) return 1;
+    return msbll(max_count - 1) + 1;
 }
 
 CLASS_HEADER
@@ -294,6 +448,8 @@ METHOD_HEADER::visit(Visitor& visitor)
     visitor.visit(super_blocks);
     if constexpr (with_select1_hints) visitor.visit(select1_hints<with_select1_hints>::hints1);
     if constexpr (with_select0_hints) visitor.visit(select0_hints<with_select0_hints>::hints0);
+    select1_samples<select1_sample_rate>::visit(visitor);
+    select0_samples<select0_sample_rate>::visit(visitor);
 }
 
 CLASS_HEADER
@@ -306,6 +462,8 @@ METHOD_HEADER::visit(Visitor& visitor) const
     visitor.visit(super_blocks);
     if constexpr (with_select1_hints) visitor.visit(select1_hints<with_select1_hints>::hints1);
     if constexpr (with_select0_hints) visitor.visit(select0_hints<with_select0_hints>::hints0);
+    select1_samples<select1_sample_rate>::visit(visitor);
+    select0_samples<select0_sample_rate>::visit(visitor);
 }
 
 CLASS_HEADER
@@ -319,6 +477,8 @@ METHOD_HEADER::load(Loader& visitor)
     r.super_blocks = decltype(r.super_blocks)::load(visitor);
     if constexpr (with_select1_hints) visitor.visit(r.hints1);
     if constexpr (with_select0_hints) visitor.visit(r.hints0);
+    r.select1_samples<select1_sample_rate>::visit(visitor);
+    r.select0_samples<select0_sample_rate>::visit(visitor);
     return r;
 }
 
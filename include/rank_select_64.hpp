@@ -3,19 +3,24 @@
 namespace bit {
 namespace rs {
 
-#define CLASS_HEADER template <bool with_select1_hints, bool with_select0_hints>
-#define METHOD_HEADER array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints>
+#define CLASS_HEADER template <bool with_select1_hints, bool with_select0_hints, std::size_t select1_sample_rate, std::size_t select0_sample_rate>
+#define METHOD_HEADER array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints, select1_sample_rate, select0_sample_rate>
 
 // Specialisation working with this library's bit-vectors made of 64-bits blocks.
+// With select samples, select starts from the super-block of the preceding sample and scans the super-block
+// counters forward (rank9-style), up to select_scan_super_blocks of them, before falling back to a binary search
+// up to the super-block of the next sample (long runs without the sampled bit).
 CLASS_HEADER
-class array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints> 
+class array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints, select1_sample_rate, select0_sample_rate> 
     : protected select1_hints<with_select1_hints>, 
-      protected select0_hints<with_select0_hints>
+      protected select0_hints<with_select0_hints>,
+      protected select1_samples<select1_sample_rate>,
+      protected select0_samples<select0_sample_rate>
 {
     public:
         using bv_type = bit::vector<uint64_t>;
 
-        array(bit::vector<uint64_t>&& vector) : _data(vector) {build_index();}
+        array(bit::vector<uint64_t>&& vector) : _data(std::move(vector)) {build_index();}
         array(array const&) noexcept = default;
         array(array&&) noexcept = default;
         array& operator=(array const&) noexcept = default;
@@ -24,6 +29,8 @@ class array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints
         std::size_t rank0(std::size_t idx) const {return idx - rank1(idx);}
         std::size_t select1(std::size_t th) const;
         std::size_t select0(std::size_t th) const;
+        void rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const;
+        void select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const;
         std::size_t size() const noexcept {return _data.size();}
         std::size_t size0() const noexcept {return size() - size1();}
         std::size_t size1() const noexcept {return *(interleaved_blocks.end() - 2);}
@@ -49,14 +56,17 @@ class array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints
         static const std::size_t super_block_block_size = 8;
         static const uint64_t select_ones_per_hint = 64 * super_block_block_size * 2;  // must be > block_size * 64
         static const uint64_t select_zeros_per_hint = select_ones_per_hint;
+        static const std::size_t select_scan_super_blocks = 8; // two cache lines of counters
         static const uint64_t ones_step_9 = 1ULL << 0 | 1ULL << 9 | 1ULL << 18 | 1ULL << 27 | 1ULL << 36 | 1ULL << 45 | 1ULL << 54;
         static const uint64_t msbs_step_9 = 0x100ULL * ones_step_9;
+        static const uint64_t block_bits_step_9 = 64ULL << 54 | 128ULL << 45 | 192ULL << 36 | 256ULL << 27 | 320ULL << 18 | 384ULL << 9 | 448ULL; // bits before each of the 7 packed blocks
         bit::vector<uint64_t> _data;
-        std::vector<uint64_t> interleaved_blocks;
+        memory::map::backed_vector<uint64_t> interleaved_blocks;
 
         array() {}
         void build_index();
-        inline std::vector<uint64_t> const& payload() const noexcept {return _data.vector_data();}
+        std::pair<std::size_t, std::size_t> select1_word(std::size_t th) const;
+        inline memory::map::backed_vector<uint64_t> const& payload() const noexcept {return _data.vector_data();}
         inline std::size_t super_blocks_size() const {return interleaved_blocks.size() / 2 - 1;}
         inline uint64_t super_block_rank1(uint64_t super_block_idx) const {return interleaved_blocks.at(super_block_idx * 2);}
         inline std::size_t super_block_rank0(uint64_t super_block_idx) const {return block_bit_size * super_block_block_size * super_block_idx - super_block_rank1(super_block_idx);}
@@ -85,6 +95,12 @@ class array<bit::vector<uint64_t>, 64, 8, with_select1_hints, with_select0_hints
             if constexpr (with_select0_hints) {
                 result &= a.hints0 == b.hints0;
             }
+            if constexpr (select1_sample_rate != 0) {
+                result &= a.samples1 == b.samples1;
+            }
+            if constexpr (select0_sample_rate != 0) {
+                result &= a.samples0 == b.samples0;
+            }
             return result;
         };
         friend bool operator!=(array const& a, array const& b) {return not (a == b);};
@@ -128,7 +144,7 @@ METHOD_HEADER::build_index()
         block_rank_pairs.push_back(0);
     }
 
-    interleaved_blocks.swap(block_rank_pairs);
+    interleaved_blocks = std::move(block_rank_pairs);
 
     if constexpr (with_select1_hints) {
         std::vector<std::size_t> temp_hints;
@@ -140,7 +156,7 @@ METHOD_HEADER::build_index()
             }
         }
         temp_hints.push_back(super_blocks_size());
-        select1_hints<with_select1_hints>::hints1.swap(temp_hints);
+        select1_hints<with_select1_hints>::hints1 = std::move(temp_hints);
     }
 
     if constexpr (with_select0_hints) {
@@ -153,8 +169,10 @@ METHOD_HEADER::build_index()
             }
         }
         temp_hints.push_back(super_blocks_size());
-        select0_hints<with_select0_hints>::hints0.swap(temp_hints);
+        select0_hints<with_select0_hints>::hints0 = std::move(temp_hints);
     }
+    select1_samples<select1_sample_rate>::build_samples1(payload().data(), size(), block_bit_size * super_block_block_size);
+    select0_samples<select0_sample_rate>::build_samples0(payload().data(), size(), block_bit_size * super_block_block_size);
 }
 
 CLASS_HEADER
@@ -175,11 +193,30 @@ CLASS_HEADER
 std::size_t 
 METHOD_HEADER::select1(std::size_t th) const
 {   //indeces start from 0: e.g. return the 0th 1 = first 1
+    auto [word_offset, remaining_bits] = select1_word(th);
+    return word_offset * 64 + bit::select1(payload()[word_offset], remaining_bits);
+}
+
+/*
+ * Word holding the th-th 1 and the rank of that 1 inside the word, from the counters only.
+ */
+CLASS_HEADER
+std::pair<std::size_t, std::size_t>
+METHOD_HEADER::select1_word(std::size_t th) const
+{
     assert(th < size1());
     std::size_t a = 0;
     std::size_t b = super_blocks_size();
 
-    if constexpr (with_select1_hints) {
+    if constexpr (select1_sample_rate != 0) {
+        auto const& samples = select1_samples<select1_sample_rate>::samples1;
+        std::size_t k = th / select1_sample_rate;
+        a = samples[k];
+        std::size_t scan_end = std::min(a + select_scan_super_blocks, b);
+        while (a + 1 < scan_end and super_block_rank1(a + 1) <= th) ++a;
+        if (a + 1 == scan_end and scan_end < b) b = k + 1 < samples.size() ? samples[k + 1] + 1 : b; // long gap, binary search the rest
+        else b = a + 1;
+    } else if constexpr (with_select1_hints) {
         std::size_t chunk = th / select_ones_per_hint;
         if (chunk != 0) a = select1_hints<with_select1_hints>::hints1.at(chunk - 1);
         b = select1_hints<with_select1_hints>::hints1.at(chunk) + 1;
@@ -203,20 +240,7 @@ METHOD_HEADER::select1(std::size_t th) const
     cur_rank += block_rank >> ((7 - block_offset) * 9) & 0x1FF;
     assert(cur_rank <= th);
 
-    uint64_t word_offset = super_block_idx * super_block_block_size + block_offset;
-    uint64_t last = payload().at(word_offset);
-    std::size_t remaining_bits = th - cur_rank;
-    auto local_offset = bit::select1(last, remaining_bits);
-    // std::cerr << 
-    //     "payload[0] = " << payload().at(0) << 
-    //     " == " << _data.vector_data().at(0) << 
-    //     "\n" <<
-    //     "word offset = " << word_offset << 
-    //     ", last = " << last << 
-    //     ", remaining bits = " << remaining_bits << 
-    //     ", local offset = " << local_offset << 
-    //     "\n";
-    return word_offset * 64 + local_offset;
+    return {super_block_idx * super_block_block_size + block_offset, th - cur_rank};
 }
 
 CLASS_HEADER
@@ -227,7 +251,15 @@ METHOD_HEADER::select0(std::size_t th) const
     std::size_t a = 0;
     std::size_t b = super_blocks_size();
 
-    if constexpr (with_select0_hints) {
+    if constexpr (select0_sample_rate != 0) {
+        auto const& samples = select0_samples<select0_sample_rate>::samples0;
+        std::size_t k = th / select0_sample_rate;
+        a = samples[k];
+        std::size_t scan_end = std::min(a + select_scan_super_blocks, b);
+        while (a + 1 < scan_end and super_block_rank0(a + 1) <= th) ++a;
+        if (a + 1 == scan_end and scan_end < b) b = k + 1 < samples.size() ? samples[k + 1] + 1 : b; // long gap, binary search the rest
+        else b = a + 1;
+    } else if constexpr (with_select0_hints) {
         std::size_t chunk = th / select_zeros_per_hint;
         if (chunk != 0) a = select0_hints<with_select0_hints>::hints0.at(chunk - 1);
         b = select0_hints<with_select0_hints>::hints0.at(chunk) + 1;
@@ -248,26 +280,10 @@ METHOD_HEADER::select0(std::size_t th) const
     // std::cerr << "super block idx = " << super_block_idx << "\n";
     // std::cerr << "cur rank = " << cur_rank << "\n";
     
-    auto block_rank = block_ranks(super_block_idx);
-    // std::cerr << "block rank = " << block_rank << "\n";
-    uint64_t block_offset = 0;
-    {// we can't use bit-wise tricks since we need to compute the number of zeroes in each packed block.
-        std::array<uint16_t, 8> unpacked;
-        for (std::size_t i = 7; i != std::numeric_limits<std::size_t>::max(); --i) {
-            unpacked[i] = block_bit_size * i - (block_rank & 0x1FF);
-            // std::cerr << "unpacked[" << i << "] = " << unpacked.at(i) << "\n";
-            block_rank >>= 9;
-        }
-        while (block_offset < 8 and unpacked.at(block_offset) <= th - cur_rank) {
-            // std::cerr << "unpacked[" << block_offset << "] = " << unpacked.at(block_offset) << "\n";
-            ++block_offset;
-        }
-        --block_offset;
-        
-        // std::cerr << "block offset = " << block_offset << "\n";
-        // std::cerr << "delta rank = " << unpacked.at(block_offset) << "\n";
-        cur_rank += unpacked.at(block_offset);
-    }
+    auto block_rank = block_bits_step_9 - block_ranks(super_block_idx); // zeros before each block, no borrows across fields
+    std::size_t rank_in_block_parallel = (th - cur_rank) * ones_step_9;
+    uint64_t block_offset = uleq_step_9(block_rank, rank_in_block_parallel) * ones_step_9 >> 54 & 0x7;
+    cur_rank += block_rank >> ((7 - block_offset) * 9) & 0x1FF;
     
     assert(cur_rank <= th);
 
@@ -286,12 +302,71 @@ METHOD_HEADER::select0(std::size_t th) const
     return word_offset * 64 + local_offset;
 }
 
+/*
+ * out[i] = rank1(idxs[i]) for i in [0, n).
+ * The counters and the payload word of upcoming queries are prefetched while the current ones are answered.
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const
+{
+    pipeline(n, batch_prefetch_distance,
+        []([[maybe_unused]] std::size_t i) {},
+        [&](std::size_t i) {
+            __builtin_prefetch(interleaved_blocks.data() + idxs[i] / (block_bit_size * super_block_block_size) * 2);
+            __builtin_prefetch(payload().data() + idxs[i] / block_bit_size);
+        },
+        [&](std::size_t i) {out[i] = rank1(idxs[i]);}
+    );
+}
+
+/*
+ * out[i] = select1(ths[i]) for i in [0, n).
+ * Each stage prefetches what the next one reads: the hint (or sample) of a query, then the super-block counters 
+ * it points to, then the payload word found from the counters (kept in out[i] until the query is resolved).
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const
+{
+    auto const* counters = interleaved_blocks.data();
+    pipeline(n, batch_prefetch_distance,
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (select1_sample_rate != 0) __builtin_prefetch(select1_samples<select1_sample_rate>::samples1.data() + ths[i] / select1_sample_rate);
+            else if constexpr (with_select1_hints) __builtin_prefetch(select1_hints<with_select1_hints>::hints1.data() + ths[i] / select_ones_per_hint);
+        },
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (select1_sample_rate != 0) {
+                std::size_t sb = select1_samples<select1_sample_rate>::samples1[ths[i] / select1_sample_rate];
+                __builtin_prefetch(counters + sb * 2);
+                __builtin_prefetch(counters + sb * 2 + 8); // the forward scan reads the next super-blocks
+            } else if constexpr (with_select1_hints) {
+                auto const& hints = select1_hints<with_select1_hints>::hints1;
+                std::size_t chunk = ths[i] / select_ones_per_hint;
+                std::size_t a = chunk != 0 ? hints[chunk - 1] : 0;
+                std::size_t b = hints[chunk] + 1;
+                for (std::size_t sb = a; sb < b and sb < a + 4; ++sb) __builtin_prefetch(counters + sb * 2);
+            }
+        },
+        [&](std::size_t i) {
+            auto [word_offset, remaining_bits] = select1_word(ths[i]);
+            __builtin_prefetch(payload().data() + word_offset);
+            out[i] = word_offset * 64 + remaining_bits;
+        },
+        [&](std::size_t i) {out[i] = out[i] / 64 * 64 + bit::select1(payload()[out[i] / 64], out[i] % 64);}
+    );
+}
+
 CLASS_HEADER
 void 
 METHOD_HEADER::swap(array& other) noexcept
 {
     _data.swap(other._data);
     interleaved_blocks.swap(other.interleaved_blocks);
+    std::swap(static_cast<select1_hints<with_select1_hints>&>(*this), static_cast<select1_hints<with_select1_hints>&>(other));
+    std::swap(static_cast<select0_hints<with_select0_hints>&>(*this), static_cast<select0_hints<with_select0_hints>&>(other));
+    std::swap(static_cast<select1_samples<select1_sample_rate>&>(*this), static_cast<select1_samples<select1_sample_rate>&>(other));
+    std::swap(static_cast<select0_samples<select0_sample_rate>&>(*this), static_cast<select0_samples<select0_sample_rate>&>(other));
 }
 
 CLASS_HEADER
@@ -312,6 +387,8 @@ METHOD_HEADER::visit(Visitor& visitor)
     visitor.visit(interleaved_blocks);
     if constexpr (with_select1_hints) visitor.visit(select1_hints<with_select1_hints>::hints1);
     if constexpr (with_select0_hints) visitor.visit(select0_hints<with_select0_hints>::hints0);
+    select1_samples<select1_sample_rate>::visit(visitor);
+    select0_samples<select0_sample_rate>::visit(visitor);
 }
 
 CLASS_HEADER
@@ -323,6 +400,8 @@ METHOD_HEADER::visit(Visitor& visitor) const
     visitor.visit(interleaved_blocks);
     if constexpr (with_select1_hints) visitor.visit(select1_hints<with_select1_hints>::hints1);
     if constexpr (with_select0_hints) visitor.visit(select0_hints<with_select0_hints>::hints0);
+    select1_samples<select1_sample_rate>::visit(visitor);
+    select0_samples<select0_sample_rate>::visit(visitor);
 }
 
 CLASS_HEADER
@@ -336,6 +415,8 @@ METHOD_HEADER::load(Loader& visitor)
     visitor.visit(r.interleaved_blocks);
     if constexpr (with_select1_hints) visitor.visit(r.hints1);
     if constexpr (with_select0_hints) visitor.visit(r.hints0);
+    r.select1_samples<select1_sample_rate>::visit(visitor);
+    r.select0_samples<select0_sample_rate>::visit(visitor);
     return r;
 }
 
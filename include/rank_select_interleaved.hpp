@@ -0,0 +1,450 @@
+#ifndef RANK_SELECT_INTERLEAVED_HPP
+#define RANK_SELECT_INTERLEAVED_HPP
+
+#include <vector>
+#include <limits>
+#include <cassert>
+#include <stdexcept>
+#include <algorithm>
+#include "bit_operations.hpp"
+#include "bit_vector.hpp"
+#include "select_hints.hpp"
+#include "query_pipeline.hpp"
+#include "logtools.hpp"
+
+namespace bit {
+namespace rs {
+
+#define CLASS_HEADER template <bool with_select1_hints, bool with_select0_hints>
+#define METHOD_HEADER interleaved_array<with_select1_hints, with_select0_hints>
+
+/**
+ * Static rank/select data structure where counters and payload share the same 64-byte cache lines.
+ * Each line stores the number of 1s before it, the cumulative number of 1s in front of each of its words
+ * (rank9-style, six 9-bit counts, the last one being the number of 1s of the line) and 6 words (384 bits) 
+ * of the bit-vector. rank1 reads one line and does one popcount, select finds the word inside a line with 
+ * one broadword comparison of the packed counts.
+ * Select hints store the line of every select_ones_per_hint-th 1 (0) and the offset of its sub-hints:
+ * - when the lines of two consecutive hints are at most dense_span_lines apart, sub-hints are the numbers of
+ *   1s (0s) of the chunk before each line boundary in between (16 bits each), so that select reads the hint, 
+ *   its sub-hints and the line containing the answer;
+ * - farther apart, sub-hints store the line of every step-th 1 (0), with about as many sub-hints as lines, and 
+ *   select moves forward from the sub-hint while the answer is past the end of the line (binary searching 
+ *   the rare long gaps).
+ * Lines cost 128 bits every 384 (0.33 bits/bit), sub-hints 16 bits per line where dense and at most 32 where 
+ * sparse (0.04 to 0.08 bits/bit).
+ * IMPORTANT rank(i) is defined as the number of 1 strictly before position i.
+ */
+CLASS_HEADER
+class interleaved_array
+    : protected select1_hints<with_select1_hints>,
+      protected select0_hints<with_select0_hints>
+{
+    public:
+        interleaved_array(bit::vector<uint64_t> const& vector);
+        interleaved_array(interleaved_array const&) noexcept = default;
+        interleaved_array(interleaved_array&&) noexcept = default;
+        interleaved_array& operator=(interleaved_array const&) noexcept = default;
+        interleaved_array& operator=(interleaved_array&&) noexcept = default;
+        bool at(std::size_t idx) const;
+        std::size_t rank1(std::size_t idx) const;
+        std::size_t rank0(std::size_t idx) const {return idx - rank1(idx);}
+        std::size_t select1(std::size_t th) const;
+        std::size_t select0(std::size_t th) const;
+        void rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const;
+        void select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const;
+        std::size_t size() const noexcept {return nbits;}
+        std::size_t size0() const noexcept {return size() - size1();}
+        std::size_t size1() const noexcept {return lines()[nlines() - 1].rank;}
+        std::size_t bit_size() const noexcept;
+        std::size_t bit_overhead() const noexcept {return bit_size() - nbits;}
+        memory::map::backed_vector<uint64_t, 64> const& line_data() const noexcept {return line_words;}
+
+        void swap(interleaved_array& other) noexcept;
+
+        template <class Visitor>
+        void visit(Visitor& visitor) const;
+
+        template <class Visitor>
+        void visit(Visitor& visitor);
+
+        template <class Loader>
+        static interleaved_array load(Loader& visitor);
+
+    private:
+        static constexpr std::size_t words_per_line = 6;
+        static constexpr std::size_t line_bit_size = 64 * words_per_line;
+        static constexpr std::size_t select_ones_per_hint = 512;
+        static constexpr std::size_t select_zeros_per_hint = select_ones_per_hint;
+        static constexpr std::size_t dense_span_lines = 8; // hints closer than this store the line boundaries
+        static constexpr std::size_t linear_scan_lines = 4; // farther lines from a sampled sub-hint are binary searched
+        static constexpr uint64_t ones_step_9 = 1ULL << 0 | 1ULL << 9 | 1ULL << 18 | 1ULL << 27 | 1ULL << 36 | 1ULL << 45;
+        static constexpr uint64_t msbs_step_9 = 0x100ULL * ones_step_9;
+        static constexpr uint64_t word_bits_step_9 = 64ULL << 45 | 128ULL << 36 | 192ULL << 27 | 256ULL << 18 | 320ULL << 9 | 384ULL; // bits up to the end of each word
+
+        struct alignas(64) line_t {
+            uint64_t rank; // number of 1s before the line
+            uint64_t counts; // 1s up to the end of word j at bits [(5 - j) * 9, (6 - j) * 9), bits 54-63 are 0
+            uint64_t words[words_per_line];
+        };
+        static_assert(sizeof(line_t) == 64, "[interleaved rank select] lines must fill a cache line");
+        static constexpr std::size_t line_word_size = sizeof(line_t) / sizeof(uint64_t);
+
+        std::size_t nbits;
+        memory::map::backed_vector<uint64_t, 64> line_words; // line_word_size words per line, the last line is empty and only stores the total number of 1s
+        memory::map::backed_vector<uint32_t> sub_hints1; // hints store the line (low 32 bits) and the offset of their sub-hints
+        memory::map::backed_vector<uint32_t> sub_hints0;
+
+        interleaved_array() : nbits(0) {}
+        line_t const* lines() const noexcept {return reinterpret_cast<line_t const*>(line_words.data());} // cache-aligned, owned or mapped
+        std::size_t nlines() const noexcept {return line_words.size() / line_word_size;}
+        template <bool ones>
+        void build_hints(memory::map::backed_vector<std::size_t>& hints, memory::map::backed_vector<uint32_t>& sub_hints) const;
+        std::size_t line_rank0(std::size_t line_idx) const noexcept {return line_idx * line_bit_size - lines()[line_idx].rank;}
+        template <bool ones>
+        std::size_t count_before(std::size_t line_idx) const noexcept; // padding is not counted
+        template <bool ones>
+        static uint64_t word_counts(line_t const& line) noexcept {return ones ? line.counts : word_bits_step_9 - line.counts;} // no borrows across fields
+        static std::size_t count_before_word(uint64_t counts, std::size_t word_idx) noexcept {return counts >> ((6 - word_idx) * 9) & 0x1FF;} // 0 for the first word
+        static std::size_t hint_line(std::size_t hint) noexcept {return hint & std::numeric_limits<uint32_t>::max();}
+        static std::size_t hint_sub_offset(std::size_t hint) noexcept {return hint >> 32;}
+        static std::size_t sub_hints_per_hint(std::size_t span) noexcept; // span = lines where the answer can be
+        template <bool ones>
+        std::pair<std::size_t, std::size_t> hinted_lines(memory::map::backed_vector<std::size_t> const& hints, memory::map::backed_vector<uint32_t> const& sub_hints, std::size_t th) const noexcept;
+        template <bool ones>
+        std::size_t select_line(memory::map::backed_vector<std::size_t> const& hints, memory::map::backed_vector<uint32_t> const& sub_hints, std::size_t th) const;
+        template <bool ones>
+        std::size_t select_in_line(std::size_t line_idx, std::size_t th) const noexcept;
+
+        inline static uint64_t uleq_step_9(uint64_t x, uint64_t y) {
+            return (((((y | msbs_step_9) - (x & ~msbs_step_9)) | (x ^ y)) ^ (x & ~y)) & msbs_step_9) >> 8;
+        }
+
+        friend bool operator==(interleaved_array const& a, interleaved_array const& b)
+        {
+            bool result = a.nbits == b.nbits and a.line_words == b.line_words;
+            if constexpr (with_select1_hints) {
+                result &= a.hints1 == b.hints1 and a.sub_hints1 == b.sub_hints1;
+            }
+            if constexpr (with_select0_hints) {
+                result &= a.hints0 == b.hints0 and a.sub_hints0 == b.sub_hints0;
+            }
+            return result;
+        };
+        friend bool operator!=(interleaved_array const& a, interleaved_array const& b) {return not (a == b);};
+};
+
+CLASS_HEADER
+METHOD_HEADER::interleaved_array(bit::vector<uint64_t> const& vector)
+    : nbits(vector.size())
+{
+    auto const& data = vector.vector_data();
+    const std::size_t nwords = (nbits + 63) / 64;
+    const std::size_t nlines = (nwords + words_per_line - 1) / words_per_line + 1;
+    line_words.resize(nlines * line_word_size);
+    line_t* lines = reinterpret_cast<line_t*>(line_words.data());
+    uint64_t rank = 0;
+    for (std::size_t l = 0; l < nlines; ++l) {
+        lines[l].rank = rank;
+        uint64_t in_line = 0;
+        lines[l].counts = 0;
+        for (std::size_t j = 0; j < words_per_line; ++j) {
+            std::size_t i = l * words_per_line + j;
+            uint64_t word = i < nwords ? data[i] : 0;
+            if (i + 1 == nwords and nbits % 64) word &= (uint64_t(1) << (nbits % 64)) - 1; // clear bits after the end
+            lines[l].words[j] = word;
+            in_line += popcount(word);
+            lines[l].counts |= in_line << ((words_per_line - 1 - j) * 9);
+        }
+        rank += in_line;
+    }
+    if constexpr (with_select1_hints) build_hints<true>(select1_hints<with_select1_hints>::hints1, sub_hints1);
+    if constexpr (with_select0_hints) build_hints<false>(select0_hints<with_select0_hints>::hints0, sub_hints0);
+}
+
+CLASS_HEADER
+template <bool ones>
+void
+METHOD_HEADER::build_hints(memory::map::backed_vector<std::size_t>& hints, memory::map::backed_vector<uint32_t>& sub_hints) const
+{
+    // hints[k] is the line containing the (k * select_ones_per_hint)-th 1 (0), the last hint is the empty line
+    const std::size_t last_line = nlines() - 1;
+    if (last_line > std::numeric_limits<uint32_t>::max()) throw std::length_error("[interleaved rank select] too many lines for select hints");
+    std::vector<std::size_t> temp_hints;
+    for (std::size_t l = 0; l < last_line; ++l) {
+        while (temp_hints.size() * select_ones_per_hint < count_before<ones>(l + 1)) temp_hints.push_back(l);
+    }
+    temp_hints.push_back(last_line);
+
+    const std::size_t total = count_before<ones>(last_line);
+    std::vector<uint32_t> temp_sub_hints;
+    for (std::size_t k = 0; k + 1 < temp_hints.size(); ++k) {
+        const std::size_t first = temp_hints[k];
+        const std::size_t end = std::min(temp_hints[k + 1] + 1, last_line);
+        std::size_t nsub = sub_hints_per_hint(end - first);
+        if (nsub == 0) continue;
+        if (temp_sub_hints.size() > std::numeric_limits<uint32_t>::max()) throw std::length_error("[interleaved rank select] too many select sub-hints");
+        temp_hints[k] |= temp_sub_hints.size() << 32;
+        if (end - first <= dense_span_lines) { // line boundaries, relative to the first 1 (0) of the chunk
+            for (std::size_t l = first + 1; l < end; l += 2) { // two 16-bit counts per sub-hint
+                uint32_t packed = count_before<ones>(l) - k * select_ones_per_hint;
+                if (l + 1 < end) packed |= static_cast<uint32_t>(count_before<ones>(l + 1) - k * select_ones_per_hint) << 16;
+                temp_sub_hints.push_back(packed);
+            }
+            continue;
+        }
+        std::size_t l = first;
+        for (std::size_t r = k * select_ones_per_hint; r < std::min((k + 1) * select_ones_per_hint, total); r += select_ones_per_hint / nsub) {
+            while (count_before<ones>(l + 1) <= r) ++l;
+            temp_sub_hints.push_back(l);
+        }
+    }
+    hints = std::move(temp_hints);
+    sub_hints = std::move(temp_sub_hints);
+}
+
+CLASS_HEADER
+template <bool ones>
+std::size_t
+METHOD_HEADER::count_before(std::size_t line_idx) const noexcept
+{
+    if constexpr (ones) return lines()[line_idx].rank;
+    else return std::min(line_idx * line_bit_size, nbits) - lines()[line_idx].rank;
+}
+
+/*
+ * 0 if the span is a single line, the span - 1 line boundaries up to dense_span_lines, otherwise the largest 
+ * power of two not above span, up to one sub-hint per bit.
+ */
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::sub_hints_per_hint(std::size_t span) noexcept
+{
+    if (span <= dense_span_lines) return span - 1;
+    return std::min(select_ones_per_hint, std::size_t(1) << msbll(span));
+}
+
+CLASS_HEADER
+bool
+METHOD_HEADER::at(std::size_t idx) const
+{
+    if (idx >= nbits) throw std::out_of_range("[interleaved rank select] index out of range");
+    std::size_t offset = idx % line_bit_size;
+    return (lines()[idx / line_bit_size].words[offset / 64] >> (offset % 64)) & 1;
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::rank1(std::size_t idx) const
+{
+    assert(idx <= size());
+    line_t const& line = lines()[idx / line_bit_size];
+    std::size_t offset = idx % line_bit_size;
+    std::size_t w = offset / 64;
+    return line.rank + count_before_word(line.counts, w) + popcount(line.words[w] & ((uint64_t(1) << (offset % 64)) - 1));
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::select1(std::size_t th) const
+{
+    assert(th < size1());
+    std::size_t line_idx;
+    if constexpr (with_select1_hints) line_idx = select_line<true>(select1_hints<with_select1_hints>::hints1, sub_hints1, th);
+    else line_idx = select_line<true>({}, {}, th);
+    return select_in_line<true>(line_idx, th - lines()[line_idx].rank);
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::select0(std::size_t th) const
+{
+    assert(th < size0());
+    std::size_t line_idx;
+    if constexpr (with_select0_hints) line_idx = select_line<false>(select0_hints<with_select0_hints>::hints0, sub_hints0, th);
+    else line_idx = select_line<false>({}, {}, th);
+    return select_in_line<false>(line_idx, th - line_rank0(line_idx));
+}
+
+/*
+ * Lines [a, b) where the th-th 1 (0) can be, from the hints and sub-hints only (b = a + 1 when they tell the line).
+ * Empty hints give the whole bit-vector.
+ */
+CLASS_HEADER
+template <bool ones>
+std::pair<std::size_t, std::size_t>
+METHOD_HEADER::hinted_lines(memory::map::backed_vector<std::size_t> const& hints, memory::map::backed_vector<uint32_t> const& sub_hints, std::size_t th) const noexcept
+{
+    if (hints.empty()) return {0, nlines() - 1};
+    std::size_t chunk = th / select_ones_per_hint;
+    std::size_t hint = hints[chunk];
+    std::size_t a = hint_line(hint);
+    std::size_t b = std::min(hint_line(hints[chunk + 1]) + 1, nlines() - 1); // the hint line contains the first 1 (0) of the chunk, the last line is empty
+    uint32_t const* sub = sub_hints.data() + hint_sub_offset(hint);
+    std::size_t r = th % select_ones_per_hint;
+    std::size_t span = b - a;
+    if (span <= dense_span_lines) {
+        for (std::size_t l = a; l < b; ++l) __builtin_prefetch(lines() + l); // loaded while the sub-hints are read
+        for (std::size_t i = 0; i + 1 < span; ++i) a += (sub[i / 2] >> (i % 2 * 16) & 0xFFFF) <= r; // line boundaries before th
+        return {a, a + 1};
+    }
+    return {sub[r / (select_ones_per_hint / sub_hints_per_hint(span))], b};
+}
+
+/*
+ * Line containing the th-th 1 (0): moves forward from the hinted line while th is past its end, up to 
+ * linear_scan_lines lines, and binary searches the rest.
+ */
+CLASS_HEADER
+template <bool ones>
+std::size_t
+METHOD_HEADER::select_line(memory::map::backed_vector<std::size_t> const& hints, memory::map::backed_vector<uint32_t> const& sub_hints, std::size_t th) const
+{
+    auto [a, b] = hinted_lines<ones>(hints, sub_hints, th);
+    auto before = [this](std::size_t line_idx) {return ones ? lines()[line_idx].rank : line_rank0(line_idx);};
+    auto through = [&](std::size_t line_idx) {return before(line_idx) + (word_counts<ones>(lines()[line_idx]) & 0x1FF);}; // padding counted as 0s
+    std::size_t scan_end = std::min(a + linear_scan_lines, b);
+    while (a + 1 < scan_end and through(a) <= th) ++a;
+    if (a + 1 < b and through(a) <= th) {
+        ++a;
+        while (b - a > 1) { // last line with rank <= th
+            std::size_t mid = a + (b - a) / 2;
+            if (before(mid) <= th) a = mid;
+            else b = mid;
+        }
+    }
+    return a;
+}
+
+/*
+ * out[i] = rank1(idxs[i]) for i in [0, n), prefetching the lines of upcoming queries.
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::rank1_batch(std::size_t const* idxs, std::size_t* out, std::size_t n) const
+{
+    pipeline(n, batch_prefetch_distance,
+        []([[maybe_unused]] std::size_t i) {},
+        [&](std::size_t i) {__builtin_prefetch(lines() + idxs[i] / line_bit_size);},
+        [&](std::size_t i) {out[i] = rank1(idxs[i]);}
+    );
+}
+
+/*
+ * out[i] = select1(ths[i]) for i in [0, n).
+ * With select hints, the hint of a query is prefetched first, then its sub-hints and finally the line they point to.
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::select1_batch(std::size_t const* ths, std::size_t* out, std::size_t n) const
+{
+    pipeline(n, batch_prefetch_distance,
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (with_select1_hints) __builtin_prefetch(select1_hints<with_select1_hints>::hints1.data() + ths[i] / select_ones_per_hint);
+        },
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (with_select1_hints) {
+                auto const& hints = select1_hints<with_select1_hints>::hints1;
+                std::size_t chunk = ths[i] / select_ones_per_hint;
+                std::size_t a = hint_line(hints[chunk]);
+                std::size_t span = std::min(hint_line(hints[chunk + 1]) + 1, nlines() - 1) - a;
+                std::size_t first = span <= dense_span_lines ? 0 : ths[i] % select_ones_per_hint / (select_ones_per_hint / sub_hints_per_hint(span));
+                if (span > 1) __builtin_prefetch(sub_hints1.data() + hint_sub_offset(hints[chunk]) + first);
+                else __builtin_prefetch(lines() + a);
+            }
+        },
+        [&]([[maybe_unused]] std::size_t i) {
+            if constexpr (with_select1_hints) __builtin_prefetch(lines() + hinted_lines<true>(select1_hints<with_select1_hints>::hints1, sub_hints1, ths[i]).first);
+        },
+        [&](std::size_t i) {out[i] = select1(ths[i]);}
+    );
+}
+
+/*
+ * Position of the th-th 1 (0) of the line: the packed counts give the word in one step.
+ */
+CLASS_HEADER
+template <bool ones>
+std::size_t
+METHOD_HEADER::select_in_line(std::size_t line_idx, std::size_t th) const noexcept
+{
+    line_t const& line = lines()[line_idx];
+    uint64_t counts = word_counts<ones>(line);
+    assert(th < (counts & 0x1FF));
+    std::size_t w = uleq_step_9(counts, th * ones_step_9) * ones_step_9 >> 45 & 0x7; // words ending at or before th
+    uint64_t word = ones ? line.words[w] : ~line.words[w];
+    return line_idx * line_bit_size + w * 64 + bit::select1(word, th - count_before_word(counts, w));
+}
+
+CLASS_HEADER
+void
+METHOD_HEADER::swap(interleaved_array& other) noexcept
+{
+    std::swap(nbits, other.nbits);
+    line_words.swap(other.line_words);
+    if constexpr (with_select1_hints) select1_hints<with_select1_hints>::hints1.swap(other.hints1);
+    if constexpr (with_select0_hints) select0_hints<with_select0_hints>::hints0.swap(other.hints0);
+    sub_hints1.swap(other.sub_hints1);
+    sub_hints0.swap(other.sub_hints0);
+}
+
+CLASS_HEADER
+std::size_t
+METHOD_HEADER::bit_size() const noexcept
+{
+    logging_tools::libra logger;
+    visit(logger);
+    return 8 * logger.get_byte_size();
+}
+
+CLASS_HEADER
+template <class Visitor>
+void
+METHOD_HEADER::visit(Visitor& visitor)
+{
+    visitor.visit(nbits);
+    visitor.visit(line_words);
+    if constexpr (with_select1_hints) {
+        visitor.visit(select1_hints<with_select1_hints>::hints1);
+        visitor.visit(sub_hints1);
+    }
+    if constexpr (with_select0_hints) {
+        visitor.visit(select0_hints<with_select0_hints>::hints0);
+        visitor.visit(sub_hints0);
+    }
+}
+
+CLASS_HEADER
+template <class Visitor>
+void
+METHOD_HEADER::visit(Visitor& visitor) const
+{
+    visitor.visit(nbits);
+    visitor.visit(line_words);
+    if constexpr (with_select1_hints) {
+        visitor.visit(select1_hints<with_select1_hints>::hints1);
+        visitor.visit(sub_hints1);
+    }
+    if constexpr (with_select0_hints) {
+        visitor.visit(select0_hints<with_select0_hints>::hints0);
+        visitor.visit(sub_hints0);
+    }
+}
+
+CLASS_HEADER
+template <class Loader>
+METHOD_HEADER
+METHOD_HEADER::load(Loader& visitor)
+{
+    METHOD_HEADER r;
+    r.visit(visitor);
+    return r;
+}
+
+#undef CLASS_HEADER
+#undef METHOD_HEADER
+
+} // namespace rs
+} // namespace bit
+
+#endif // RANK_SELECT_INTERLEAVED_HPP
@@ -2,10 +2,38 @@
 #define SELECT_HINTS_HPP
 
 #include <vector>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include "bit_operations.hpp"
+#include "backed_vector.hpp"
 
 namespace bit{
 namespace rs {
 
+/*
+ * Super-blocks (of super_block_bit_size bits) holding the 0th, rate-th, (2 * rate)-th, ... 1 (or 0) among the
+ * first nbits bits of words, as 32-bit indices.
+ */
+template <typename Word, std::size_t rate, bool ones>
+std::vector<uint32_t> sample_super_blocks(Word const* words, std::size_t nbits, std::size_t super_block_bit_size)
+{
+    constexpr std::size_t word_bit_size = 8 * sizeof(Word);
+    if (nbits / super_block_bit_size > std::numeric_limits<uint32_t>::max()) throw std::length_error("[select samples] too many super-blocks");
+    std::vector<uint32_t> samples;
+    std::size_t next = 0; // rank of the next sample
+    std::size_t count = 0;
+    for (std::size_t i = 0; i * word_bit_size < nbits; ++i) {
+        uint64_t word = ones ? static_cast<uint64_t>(words[i]) : static_cast<uint64_t>(static_cast<Word>(~words[i]));
+        std::size_t valid = std::min(word_bit_size, nbits - i * word_bit_size);
+        if (valid < 64) word &= (uint64_t(1) << valid) - 1;
+        std::size_t pop = popcount(word);
+        for (; next < count + pop; next += rate) samples.push_back((i * word_bit_size + select1(word, next - count)) / super_block_bit_size);
+        count += pop;
+    }
+    return samples;
+}
+
 template <bool B>
 class select1_hints {};
 
@@ -27,7 +55,7 @@ class select1_hints<true>
 {
     protected:
         using hint_t = std::size_t;
-        std::vector<hint_t> hints1;
+        memory::map::backed_vector<hint_t> hints1;
 
         std::size_t bit_size() const noexcept {return hints1.size() * sizeof(hint_t) * 8;}
 
@@ -59,7 +87,7 @@ class select0_hints<true>
 {
     protected:
         using hint_t = std::size_t;
-        std::vector<hint_t> hints0;
+        memory::map::backed_vector<hint_t> hints0;
 
         std::size_t bit_size() const noexcept {return hints0.size() * sizeof(hint_t) * 8;}
 
@@ -70,6 +98,86 @@ class select0_hints<true>
         void visit(Visitor& visitor) {visitor.visit(hints0);}
 };
 
+/*
+ * Optional select samples: super-block of every rate-th 1 (0) of the bit-vector.
+ * rate = 0 disables them.
+ */
+template <std::size_t rate>
+class select1_samples 
+{
+    protected:
+        using sample_t = uint32_t;
+        memory::map::backed_vector<sample_t> samples1;
+
+        template <typename Word>
+        void build_samples1(Word const* words, std::size_t nbits, std::size_t super_block_bit_size) 
+        {
+            samples1 = sample_super_blocks<Word, rate, true>(words, nbits, super_block_bit_size);
+        }
+
+        std::size_t bit_size() const noexcept {return samples1.size() * sizeof(sample_t) * 8;}
+
+        template <class Visitor>
+        void visit(Visitor& visitor) const {visitor.visit(samples1);}
+
+        template <class Visitor>
+        void visit(Visitor& visitor) {visitor.visit(samples1);}
+};
+
+template <>
+class select1_samples<0> 
+{
+    protected:
+        template <typename Word>
+        void build_samples1([[maybe_unused]] Word const* words, [[maybe_unused]] std::size_t nbits, [[maybe_unused]] std::size_t super_block_bit_size) {}
+
+        std::size_t bit_size() const noexcept {return 0;}
+
+        template <class Visitor>
+        void visit([[maybe_unused]] Visitor& visitor) const {}
+
+        template <class Visitor>
+        void visit([[maybe_unused]] Visitor& visitor) {}
+};
+
+template <std::size_t rate>
+class select0_samples 
+{
+    protected:
+        using sample_t = uint32_t;
+        memory::map::backed_vector<sample_t> samples0;
+
+        template <typename Word>
+        void build_samples0(Word const* words, std::size_t nbits, std::size_t super_block_bit_size) 
+        {
+            samples0 = sample_super_blocks<Word, rate, false>(words, nbits, super_block_bit_size);
+        }
+
+        std::size_t bit_size() const noexcept {return samples0.size() * sizeof(sample_t) * 8;}
+
+        template <class Visitor>
+        void visit(Visitor& visitor) const {visitor.visit(samples0);}
+
+        template <class Visitor>
+        void visit(Visitor& visitor) {visitor.visit(samples0);}
+};
+
+template <>
+class select0_samples<0> 
+{
+    protected:
+        template <typename Word>
+        void build_samples0([[maybe_unused]] Word const* words, [[maybe_unused]] std::size_t nbits, [[maybe_unused]] std::size_t super_block_bit_size) {}
+
+        std::size_t bit_size() const noexcept {return 0;}
+
+        template <class Visitor>
+        void visit([[maybe_unused]] Visitor& visitor) const {}
+
+        template <class Visitor>
+        void visit([[maybe_unused]] Visitor& visitor) {}
+};
+
 }
 }
 
@@ -0,0 +1,228 @@
+#ifndef SUPER_KMER_PARTITIONER_HPP
+#define SUPER_KMER_PARTITIONER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "constants.hpp"
+#include "super_kmer_view.hpp"
+
+namespace partition {
+
+/*
+ * First stage of disk-based k-mer counting: super-k-mers are scattered into N bucket files according to
+ * the hash of their minimizer, so that all the occurrences of a k-mer end up in the same bucket.
+ * Each bucket has its own write buffer and the file is opened (in append mode) only when the buffer is full,
+ * so that thousands of buckets do not need as many open file descriptors.
+ * Records are [uint32_t number of bases][bases packed 4 per byte, first base in the lowest bits].
+ */
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+class super_kmer_partitioner
+{
+    public:
+        super_kmer_partitioner(
+            std::string tmp_dir,
+            std::string name,
+            std::size_t nbuckets,
+            uint8_t k,
+            uint8_t m,
+            uint64_t seed,
+            bool canonical,
+            std::size_t buffer_bytes_per_bucket = 1 << 16);
+        super_kmer_partitioner(super_kmer_partitioner const&) = delete;
+        super_kmer_partitioner& operator=(super_kmer_partitioner const&) = delete;
+        void add(char const* seq, std::size_t len);
+        void add(std::string const& seq);
+        void flush();
+        std::size_t bucket_of(MinimizerType minimizer) const noexcept;
+        std::size_t nbuckets() const noexcept;
+        std::size_t size(std::size_t bucket) const; // number of super-k-mers in bucket
+        std::string const& bucket_filename(std::size_t bucket) const;
+        void remove_files();
+        ~super_kmer_partitioner();
+
+    private:
+        uint8_t klen;
+        uint8_t mlen;
+        uint64_t mseed;
+        bool canon;
+        std::size_t buffer_limit;
+        std::vector<std::vector<uint8_t>> buffers;
+        std::vector<std::size_t> counts;
+        std::vector<std::string> filenames;
+        void append(std::size_t bucket, char const* super_kmer, std::size_t length);
+        void flush(std::size_t bucket);
+};
+
+/*
+ * Sequential reader of a bucket file written by super_kmer_partitioner.
+ */
+class bucket_reader
+{
+    public:
+        bucket_reader(std::string const& filename);
+        bool next(std::string& super_kmer); // false at the end of the file
+
+    private:
+        std::ifstream istrm;
+        std::vector<uint8_t> packed;
+};
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::super_kmer_partitioner(
+    std::string tmp_dir,
+    std::string name,
+    std::size_t nbuckets,
+    uint8_t k,
+    uint8_t m,
+    uint64_t seed,
+    bool canonical,
+    std::size_t buffer_bytes_per_bucket)
+    : klen(k), mlen(m), mseed(seed), canon(canonical), buffer_limit(buffer_bytes_per_bucket)
+{
+    if (nbuckets == 0) throw std::invalid_argument("[super-k-mer partitioner] at least one bucket is required");
+    if (mlen == 0 or mlen > klen) throw std::invalid_argument("[super-k-mer partitioner] m must be in [1, k]");
+    buffers.resize(nbuckets);
+    counts.resize(nbuckets, 0);
+    for (std::size_t i = 0; i < nbuckets; ++i) {
+        std::stringstream filename;
+        filename << tmp_dir << "/tmp.bucket";
+        if (name != "") filename << "_" << name;
+        filename << "_" << i << ".bin";
+        filenames.push_back(filename.str());
+        std::ofstream out(filenames.back(), std::ofstream::binary | std::ofstream::trunc); // start from empty files
+        if (not out) throw std::runtime_error("[super-k-mer partitioner] unable to create " + filenames.back());
+    }
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::add(char const* seq, std::size_t len)
+{
+    auto view = wrapper::packed_super_kmer_view_from_cstr<KmerType, MinimizerType, HashFunction>(seq, len, klen, mlen, mseed, canon);
+    for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
+        auto const& sk = *itr;
+        append(bucket_of(sk.minimizer), seq + sk.start, sk.length);
+    }
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::add(std::string const& seq)
+{
+    add(seq.data(), seq.size());
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::flush()
+{
+    for (std::size_t i = 0; i < buffers.size(); ++i) flush(i);
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+std::size_t
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::bucket_of(MinimizerType minimizer) const noexcept
+{
+    // different seed than the one used for minimizer selection, otherwise small buckets would only get small hashes
+    return static_cast<std::size_t>(HashFunction::hash(minimizer, mseed + 1) % buffers.size());
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+std::size_t
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::nbuckets() const noexcept
+{
+    return buffers.size();
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+std::size_t
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::size(std::size_t bucket) const
+{
+    return counts.at(bucket);
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+std::string const&
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::bucket_filename(std::size_t bucket) const
+{
+    return filenames.at(bucket);
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::remove_files()
+{
+    for (auto& buffer : buffers) buffer.clear();
+    for (auto const& filename : filenames) std::remove(filename.c_str());
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::~super_kmer_partitioner()
+{
+    try {
+        flush();
+    } catch (...) {} // never throw from destructors
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::append(std::size_t bucket, char const* super_kmer, std::size_t length)
+{
+    auto& buffer = buffers[bucket];
+    const uint32_t len = static_cast<uint32_t>(length);
+    const std::size_t header = buffer.size();
+    buffer.resize(header + sizeof(len) + (length + 3) / 4, 0);
+    std::memcpy(buffer.data() + header, &len, sizeof(len));
+    uint8_t* packed = buffer.data() + header + sizeof(len);
+    for (std::size_t i = 0; i < length; ++i) {
+        auto c = constants::seq_nt4_table[static_cast<uint8_t>(super_kmer[i])]; // super-k-mers only contain ACGT
+        packed[i / 4] |= static_cast<uint8_t>(c << (2 * (i % 4)));
+    }
+    ++counts[bucket];
+    if (buffer.size() >= buffer_limit) flush(bucket);
+}
+
+template <typename KmerType, typename MinimizerType, typename HashFunction>
+void
+super_kmer_partitioner<KmerType, MinimizerType, HashFunction>::flush(std::size_t bucket)
+{
+    auto& buffer = buffers[bucket];
+    if (buffer.empty()) return;
+    std::ofstream out(filenames[bucket], std::ofstream::binary | std::ofstream::app);
+    out.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+    if (not out) throw std::runtime_error("[super-k-mer partitioner] unable to write to " + filenames[bucket]);
+    buffer.clear();
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline bucket_reader::bucket_reader(std::string const& filename)
+    : istrm(filename, std::ifstream::binary)
+{
+    if (not istrm) throw std::runtime_error("[bucket reader] unable to open " + filename);
+}
+
+inline bool
+bucket_reader::next(std::string& super_kmer)
+{
+    uint32_t len;
+    if (not istrm.read(reinterpret_cast<char*>(&len), sizeof(len))) return false;
+    packed.resize((len + 3) / 4);
+    if (not istrm.read(reinterpret_cast<char*>(packed.data()), packed.size())) throw std::runtime_error("[bucket reader] truncated record");
+    super_kmer.resize(len);
+    for (std::size_t i = 0; i < len; ++i) super_kmer[i] = constants::bases[(packed[i / 4] >> (2 * (i % 4))) & 3];
+    return true;
+}
+
+} // namespace partition
+
+#endif // SUPER_KMER_PARTITIONER_HPP
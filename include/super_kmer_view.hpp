@@ -3,25 +3,36 @@
 
 #include <string>
 #include <vector>
+#include <cassert>
 
 #include "minimizer_view.hpp"
 
 namespace wrapper {
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
+#define CLASS_HEADER template <typename KmerType, typename MinimizerType, typename HashFunction, typename Iterator>
+#define METHOD_HEADER super_kmer_view<KmerType, MinimizerType, HashFunction, Iterator>
+
+/*
+ * Single-pass view over the super-k-mers of a sequence, i.e. the maximal runs of consecutive k-mers
+ * sharing the same minimizer (see minimizer_view).
+ * Super-k-mers never span bases different from ACGT.
+ */
+CLASS_HEADER
 class super_kmer_view
 {
     public:
-        typedef typename minimizer_view<KmerType, MinimizerType, HashFunction> mm_view_type;
+        typedef minimizer_view<KmerType, MinimizerType, HashFunction, Iterator> mm_view_type;
+
+        struct super_kmer_t {
+            MinimizerType minimizer; // 2-bit packed minimizer
+            std::size_t minimizer_position; // starting position of the minimizer in the sequence
+            std::size_t start; // starting position of the super-k-mer in the sequence
+            std::size_t length; // number of bases (the super-k-mer contains length - k + 1 k-mers)
+        };
 
         class const_iterator
         {
             public:
-                struct super_kmer_t {
-                    mm_view_type minimizer; // 2-bit packed minimizer
-                    uint8_t mm_pos;         // position of the minimizer in the first k-mer
-                    uint8_t size;           // super k-mer size (number of k-mers)
-                };
                 using iterator_category = std::forward_iterator_tag;
                 using difference_type   = std::ptrdiff_t;
                 using value_type        = super_kmer_t;
@@ -30,131 +41,189 @@ class super_kmer_view
 
                 const_iterator(super_kmer_view const* view);
                 const_iterator(super_kmer_view const* view, int dummy_end);
-                super_kmer_t const& operator*() const;
+                value_type const& operator*() const noexcept;
                 const_iterator const& operator++();
                 const_iterator operator++(int);
 
             private:
                 super_kmer_view const* parent_view;
-                typename minimizer_view<KmerType, MinimizerType, HashFunction>::const_iterator start, stop, prev;
-                std::size_t kmer_count;
-                std::size_t prev_idx;
-                super_kmer_t current_sk;
-
-                friend bool operator==(const_iterator const& a, const_iterator const& b);
-                friend bool operator!=(const_iterator const& a, const_iterator const& b);
+                typename mm_view_type::const_iterator next; // minimizer following the current one
+                super_kmer_t current;
+                bool exhausted;
+                void load();
+
+                friend bool operator==(const_iterator const& a, const_iterator const& b)
+                {
+                    if (a.parent_view != b.parent_view or a.exhausted != b.exhausted) return false;
+                    return a.exhausted or a.current.start == b.current.start;
+                };
+                friend bool operator!=(const_iterator const& a, const_iterator const& b) {return not (a == b);};
         };
 
-        super_kmer_view(char const* contig, std::size_t contig_len, uint8_t k, uint8_t m, bool canonical = false) noexcept;
-        super_kmer_view(std::string const& contig, uint8_t k, uint8_t m, bool canonical = false) noexcept;
+        super_kmer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical = false);
         const_iterator cbegin() const;
         const_iterator cend() const noexcept;
+        const_iterator begin() const;
+        const_iterator end() const noexcept;
         uint8_t get_k() const noexcept;
         uint8_t get_m() const noexcept;
 
     private:
-        minimizer_view<KmerType, MinimizerType, HashFunction> mm_view;
+        mm_view_type mm_view;
 };
 
-//---------------------------------------------------------------------------------------------------------------------------------------------------
+template <typename KmerType, typename MmerType, typename HashFunction>
+super_kmer_view<KmerType, MmerType, HashFunction, std::string::const_iterator> super_kmer_view_from_string(
+    const std::string& s,
+    uint8_t k,
+    uint8_t m,
+    uint64_t seed,
+    bool canonical) {
+    return super_kmer_view<KmerType, MmerType, HashFunction, std::string::const_iterator> (s.cbegin(), s.cend(), k, m, seed, canonical);
+}
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::super_kmer_view(char const* contig, std::size_t contig_len, uint8_t k, uint8_t m, bool canonical = false) noexcept
-    : mm_view(contig, contig_len, k, m, canonical)
-{}
+template <typename KmerType, typename MmerType, typename HashFunction>
+super_kmer_view<KmerType, MmerType, HashFunction, char_iterator> super_kmer_view_from_cstr(
+    char const* s,
+    std::size_t len,
+    uint8_t k,
+    uint8_t m,
+    uint64_t seed,
+    bool canonical) {
+    return super_kmer_view<KmerType, MmerType, HashFunction, char_iterator> (char_iterator(s), char_iterator(s + len), k, m, seed, canonical);
+}
+
+template <typename KmerType, typename MmerType, typename HashFunction>
+super_kmer_view<KmerType, MmerType, HashFunction, packing::nt_iterator> packed_super_kmer_view_from_cstr(
+    char const* s,
+    std::size_t len,
+    uint8_t k,
+    uint8_t m,
+    uint64_t seed,
+    bool canonical) {
+    return super_kmer_view<KmerType, MmerType, HashFunction, packing::nt_iterator> (
+        packing::nt_iterator(s, s + len),
+        packing::nt_iterator(s + len, s + len),
+        k, m, seed, canonical
+    );
+}
+
+//---------------------------------------------------------------------------------------------------------------------------------------------------
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::super_kmer_view(std::string const& contig, uint8_t k, uint8_t m, bool canonical = false) noexcept
-    : mm_view(contig, contig.length(), k, m, canonical)
+CLASS_HEADER
+METHOD_HEADER::super_kmer_view(Iterator start, Iterator stop, uint8_t k, uint8_t m, uint64_t seed, bool canonical)
+    : mm_view(start, stop, k, m, seed, canonical)
 {}
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator super_kmer_view<KmerType, MinimizerType, HashFunction>::cbegin() const
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::cbegin() const
 {
     return const_iterator(this);
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator super_kmer_view<KmerType, MinimizerType, HashFunction>::cend() const noexcept
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::cend() const noexcept
 {
     return const_iterator(this, 0);
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-uint8_t super_kmer_view<KmerType, MinimizerType, HashFunction>::get_k() const noexcept
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::begin() const
+{
+    return cbegin();
+}
+
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::end() const noexcept
+{
+    return cend();
+}
+
+CLASS_HEADER
+uint8_t
+METHOD_HEADER::get_k() const noexcept
 {
     return mm_view.get_k();
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-uint8_t super_kmer_view<KmerType, MinimizerType, HashFunction>::get_m() const noexcept
+CLASS_HEADER
+uint8_t
+METHOD_HEADER::get_m() const noexcept
 {
     return mm_view.get_m();
 }
 
 //---------------------------------------------------------------------------------------------------------------------------------------------------
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::const_iterator(super_kmer_view const* view, int dummy_end) 
-    : parent_view(view), kmer_count(0), prev_idx(0)
-{
-    start = stop = parent_view->mm_view.cend();
-}
+CLASS_HEADER
+METHOD_HEADER::const_iterator::const_iterator(super_kmer_view const* view, [[maybe_unused]] int dummy_end)
+    : parent_view(view), next(parent_view->mm_view.cend()), current{MinimizerType(0), 0, 0, 0}, exhausted(true)
+{}
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::const_iterator(super_kmer_view const* view) 
-    : parent_view(view), kmer_count(0), prev_idx(0)
+CLASS_HEADER
+METHOD_HEADER::const_iterator::const_iterator(super_kmer_view const* view)
+    : parent_view(view), next(parent_view->mm_view.cbegin()), current{MinimizerType(0), 0, 0, 0}, exhausted(false)
 {
-    if (parent_view->slen < parent_view->klen) throw std::runtime_error("Unable to initialize super-k-mer iterator on sequence of length " + std::to_string(parent_view->klen) + "with k = " + std::to_string(parent_view->klen) + " and m = " + std::to_string(parent_view->mlen));
-    start = parent_view->cbegin();
-    stop = parent_view->cend();
-    operator++();
+    if (next == parent_view->mm_view.cend()) exhausted = true;
+    else load();
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::super_kmer_t const& 
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::operator*() const
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator::value_type const&
+METHOD_HEADER::const_iterator::operator*() const noexcept
 {
-    return current_sk;
+    assert(not exhausted);
+    return current;
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator const& 
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::operator++()
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator const&
+METHOD_HEADER::const_iterator::operator++()
 {
-    assert(parent_view);
-    assert(char_idx <= parent_view->slen);
-
-    current_sk.minimizer = *start;
-    ++start;
-    std::size_t next_idx = (start == stop) ? parent_view->slen : (*start).mm_idx;
-    if ((next_idx - prev_idx) > (2 * parent_view->get_k() - m + 1)) throw std::runtime_error("Bases different than ACGT are not yet supported");
-    current_sk.mm_pos = current_sk.minimizer.mm_idx - prev_idx; // position of minimizer in first k-mer of the super k-mer
-    current_sk.size = next_idx - prev_idx - parent_view->get_k() + 1; // number of k-mers in super k-mer
+    assert(not exhausted);
+    if (next == parent_view->mm_view.cend()) exhausted = true;
+    else load();
     return *this;
 }
 
-template <typename KmerType, typename MinimizerType, typename HashFunction>
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator
-super_kmer_view<KmerType, MinimizerType, HashFunction>::const_iterator::operator++(int)
+CLASS_HEADER
+typename METHOD_HEADER::const_iterator
+METHOD_HEADER::const_iterator::operator++(int)
 {
     auto res = *this;
     operator++();
     return res;
 }
 
-template <typename K, typename M, typename H>
-bool operator==(typename super_kmer_view<K,M,H>::const_iterator const& a, typename super_kmer_view<K,M,H>::const_iterator const& b)
+/*
+ * The super-k-mer of the minimizer pointed by next ends right before the first k-mer of the following minimizer,
+ * or at the end of its run of ACGT bases if the following minimizer is in another run (or there is none).
+ */
+CLASS_HEADER
+void
+METHOD_HEADER::const_iterator::load()
 {
-    return a.parent_view == b.parent_view and a.start == b.start;
+    const std::size_t k = parent_view->get_k();
+    auto const& mm = *next;
+    current.minimizer = mm.value;
+    current.minimizer_position = mm.position;
+    current.start = next.kmer_start();
+    const std::size_t run = next.run_start();
+    ++next;
+    std::size_t stop; // end (exclusive) of the super-k-mer
+    if (next != parent_view->mm_view.cend() and next.run_start() == run) stop = next.kmer_start() + k - 1;
+    else stop = next.last_run_end();
+    assert(stop >= current.start + k);
+    current.length = stop - current.start;
 }
 
-template <typename K, typename M, typename H>
-bool operator!=(typename super_kmer_view<K,M,H>::const_iterator const& a, typename super_kmer_view<K,M,H>::const_iterator const& b)
-{
-    return not (a == b);
-}
+#undef CLASS_HEADER
+#undef METHOD_HEADER
 
 } // namespace wrapper
 
-#endif // SUPER_KMER_VIEW_HPP
\ No newline at end of file
+#endif // SUPER_KMER_VIEW_HPP
@@ -0,0 +1,191 @@
+#ifndef WIDE_KMER_HPP
+#define WIDE_KMER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace kmer {
+
+/*
+ * Fixed-size unsigned integer of Words 64-bit words (least significant word first) to be used as KmerType
+ * when k does not fit in a machine word (e.g. wide<2> for k <= 64, wide<4> for k <= 128).
+ * It provides the subset of integer operators needed by the views (shifts, bitwise operations,
+ * comparisons, +/- for masks) so that kmer_view and minimizer_view work unchanged.
+ * All operations are constexpr loops over a compile-time number of words, which the compiler fully unrolls.
+ * The type is trivially copyable and without padding, so that byte-oriented hashers (hash::hash64) work on it.
+ */
+template <std::size_t Words>
+class wide
+{
+    public:
+        static_assert(Words > 0, "[wide k-mer] at least one word is required");
+        static constexpr std::size_t words = Words;
+        static constexpr std::size_t bits = 64 * Words;
+
+        constexpr wide() noexcept : w{} {}
+        constexpr wide(uint64_t v) noexcept : w{} {w[0] = v;}
+        constexpr uint64_t word(std::size_t i) const noexcept {return w[i];}
+        constexpr uint64_t& word(std::size_t i) noexcept {return w[i];}
+        explicit constexpr operator uint64_t() const noexcept {return w[0];}
+        explicit constexpr operator bool() const noexcept
+        {
+            for (std::size_t i = 0; i < Words; ++i) if (w[i]) return true;
+            return false;
+        }
+
+        friend constexpr wide operator<<(wide const& x, std::size_t s) noexcept
+        {
+            wide r;
+            const std::size_t ws = s / 64;
+            const std::size_t bs = s % 64;
+            for (std::size_t i = Words; i-- > ws;) { // shifts larger than the width give 0
+                uint64_t v = x.w[i - ws] << bs;
+                if (bs and i > ws) v |= x.w[i - ws - 1] >> (64 - bs);
+                r.w[i] = v;
+            }
+            return r;
+        }
+
+        friend constexpr wide operator>>(wide const& x, std::size_t s) noexcept
+        {
+            wide r;
+            const std::size_t ws = s / 64;
+            const std::size_t bs = s % 64;
+            for (std::size_t i = 0; i + ws < Words; ++i) {
+                uint64_t v = x.w[i + ws] >> bs;
+                if (bs and i + ws + 1 < Words) v |= x.w[i + ws + 1] << (64 - bs);
+                r.w[i] = v;
+            }
+            return r;
+        }
+
+        friend constexpr wide operator|(wide const& a, wide const& b) noexcept
+        {
+            wide r;
+            for (std::size_t i = 0; i < Words; ++i) r.w[i] = a.w[i] | b.w[i];
+            return r;
+        }
+
+        friend constexpr wide operator&(wide const& a, wide const& b) noexcept
+        {
+            wide r;
+            for (std::size_t i = 0; i < Words; ++i) r.w[i] = a.w[i] & b.w[i];
+            return r;
+        }
+
+        friend constexpr wide operator^(wide const& a, wide const& b) noexcept
+        {
+            wide r;
+            for (std::size_t i = 0; i < Words; ++i) r.w[i] = a.w[i] ^ b.w[i];
+            return r;
+        }
+
+        friend constexpr wide operator~(wide const& a) noexcept
+        {
+            wide r;
+            for (std::size_t i = 0; i < Words; ++i) r.w[i] = ~a.w[i];
+            return r;
+        }
+
+        friend constexpr wide operator+(wide const& a, wide const& b) noexcept
+        {
+            wide r;
+            uint64_t carry = 0;
+            for (std::size_t i = 0; i < Words; ++i) {
+                uint64_t s = a.w[i] + carry;
+                carry = (s < carry);
+                r.w[i] = s + b.w[i];
+                carry += (r.w[i] < s);
+            }
+            return r;
+        }
+
+        friend constexpr wide operator-(wide const& a, wide const& b) noexcept
+        {
+            wide r;
+            uint64_t borrow = 0;
+            for (std::size_t i = 0; i < Words; ++i) {
+                uint64_t d = a.w[i] - b.w[i];
+                uint64_t nb = (a.w[i] < b.w[i]);
+                r.w[i] = d - borrow;
+                nb += (d < borrow);
+                borrow = nb;
+            }
+            return r;
+        }
+
+        constexpr wide& operator<<=(std::size_t s) noexcept {return *this = *this << s;}
+        constexpr wide& operator>>=(std::size_t s) noexcept {return *this = *this >> s;}
+        constexpr wide& operator|=(wide const& o) noexcept {return *this = *this | o;}
+        constexpr wide& operator&=(wide const& o) noexcept {return *this = *this & o;}
+        constexpr wide& operator^=(wide const& o) noexcept {return *this = *this ^ o;}
+
+        friend constexpr bool operator==(wide const& a, wide const& b) noexcept
+        {
+            for (std::size_t i = 0; i < Words; ++i) if (a.w[i] != b.w[i]) return false;
+            return true;
+        }
+        friend constexpr bool operator!=(wide const& a, wide const& b) noexcept {return not (a == b);}
+        friend constexpr bool operator<(wide const& a, wide const& b) noexcept
+        {
+            for (std::size_t i = Words; i-- > 0;) if (a.w[i] != b.w[i]) return a.w[i] < b.w[i];
+            return false;
+        }
+        friend constexpr bool operator>(wide const& a, wide const& b) noexcept {return b < a;}
+        friend constexpr bool operator<=(wide const& a, wide const& b) noexcept {return not (b < a);}
+        friend constexpr bool operator>=(wide const& a, wide const& b) noexcept {return not (a < b);}
+
+    private:
+        uint64_t w[Words];
+};
+
+/*
+ * Mask selecting the 2k least significant bits of KmerType (all bits when 2k equals the width of the type).
+ */
+template <typename KmerType>
+constexpr KmerType mask(uint8_t k) noexcept
+{
+    if (2 * std::size_t(k) >= 8 * sizeof(KmerType)) return ~KmerType(0);
+    return (KmerType(1) << (2 * k)) - KmerType(1);
+}
+
+namespace detail {
+
+/* complement and reverse the order of the 32 2-bit bases of a word */
+constexpr uint64_t word_reverse_complement(uint64_t x) noexcept
+{
+    x = ~x;
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+} // namespace detail
+
+/*
+ * Reverse complement of a 2-bit packed k-mer (A = 0, C = 1, G = 2, T = 3) with 0 < k <= 4 * sizeof(KmerType).
+ */
+template <typename KmerType>
+constexpr KmerType reverse_complement(KmerType x, uint8_t k) noexcept
+{
+    constexpr std::size_t width = 8 * sizeof(KmerType);
+    if constexpr (std::is_same<KmerType, uint64_t>::value) {
+        return detail::word_reverse_complement(x) >> (width - 2 * k);
+    } else if constexpr (std::is_same<KmerType, __uint128_t>::value) {
+        __uint128_t r = (__uint128_t(detail::word_reverse_complement(static_cast<uint64_t>(x))) << 64) | detail::word_reverse_complement(static_cast<uint64_t>(x >> 64));
+        return r >> (width - 2 * k);
+    } else if constexpr (std::is_unsigned<KmerType>::value) {
+        return static_cast<KmerType>(detail::word_reverse_complement(x) >> (64 - 2 * k));
+    } else {
+        KmerType r;
+        for (std::size_t i = 0; i < KmerType::words; ++i) r.word(KmerType::words - 1 - i) = detail::word_reverse_complement(x.word(i));
+        return r >> (width - 2 * k);
+    }
+}
+
+} // namespace kmer
+
+#endif // WIDE_KMER_HPP
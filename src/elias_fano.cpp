@@ -1,9 +1,87 @@
 #include "../include/elias_fano.hpp"
+#include <cmath>
 #include <iostream>
+#include <algorithm>
 
 namespace bit {
 namespace ef {
 
+namespace {
+
+using msb_t = bit::vector<max_width_native_type>;
+static constexpr std::size_t word_bit_size = 8 * sizeof(max_width_native_type);
+
+std::size_t next_bit(msb_t const& bv, std::size_t pos, bool one) noexcept // first position >= pos holding the given bit, bv.size() if none
+{
+    auto const* words = bv.data();
+    std::size_t w = pos / word_bit_size;
+    if (w >= bv.block_size()) return bv.size();
+    max_width_native_type word = (one ? words[w] : ~words[w]) & (~static_cast<max_width_native_type>(0) << (pos % word_bit_size));
+    while (not word) {
+        if (++w == bv.block_size()) return bv.size();
+        word = one ? words[w] : ~words[w];
+    }
+    return std::min(w * word_bit_size + lsbll(word), bv.size());
+}
+
+std::size_t prev_one(msb_t const& bv, std::size_t pos) noexcept // last one before pos, which must exist
+{
+    auto const* words = bv.data();
+    std::size_t w = (pos - 1) / word_bit_size;
+    max_width_native_type word = words[w] & (~static_cast<max_width_native_type>(0) >> (word_bit_size - 1 - (pos - 1) % word_bit_size));
+    while (not word) word = words[--w];
+    return w * word_bit_size + msbll(word);
+}
+
+} // namespace
+
+array::builder::builder(std::size_t n, std::size_t u)
+    : u(u)
+    , l((u / (n + 1)) ? static_cast<std::size_t>(std::ceil(std::log2(u / (n + 1)))) : 0) // n + 1 because of the virtual 0
+    , low_mask((static_cast<max_width_native_type>(1) << l) - 1)
+    , msb(n + 1 + (u >> l) + 1, false)
+    , lsb(l)
+    , count(0)
+    , prev(0)
+{
+    msb.set(0);
+    if (l) {
+        lsb.reserve(n + 1);
+        lsb.push_back(static_cast<std::size_t>(0));
+    }
+}
+
+void
+array::builder::push_back(std::size_t v)
+{
+    if (count and v < prev) throw std::runtime_error("ef_sequence is not sorted");
+    const std::size_t pos = (v >> l) + count + 1; // +1 because of the virtual 0
+    if (pos + 1 >= msb.size()) msb.resize(std::max(pos + 2, 2 * msb.size()), false); // n or u were under-estimated
+    msb.set(pos);
+    if (l) lsb.push_back(v & low_mask);
+    prev = v;
+    ++count;
+}
+
+/*
+ * The upper bits get the size they would have with exact n and u: count + 1 ones, (max(u, last) >> l) + 1 zeros.
+ */
+array::build_t
+array::builder::release()
+{
+    const std::size_t last = count ? prev : 0;
+    msb.resize(count + 1 + (std::max(u, last) >> l) + 1, false);
+    build_t r(rs_t(std::move(msb)), std::move(lsb), count);
+    *this = builder(0, 0);
+    return r;
+}
+
+array
+array::builder::finish()
+{
+    return array(release());
+}
+
 std::size_t 
 array::front() const
 {
@@ -34,43 +112,99 @@ array::diff_at(std::size_t idx) const
 std::size_t
 array::lt_find(std::size_t s, bool ignore_duplicates) const // ignore duplicates on the cumulative sum
 {
-    auto hb = s >> lsb.bit_width();
-    auto stop = cend();
-    auto start = begin();
-    // std::size_t correction = 0; //(lsb.bit_width() ? 1 : 0);
-    auto start_idx = hb ? msbrs.select0(hb - 1) - hb : 0; // - correction : 0;
-    auto itr = const_iterator(*this, start_idx);
-    while(*itr < s and itr != stop) ++itr; // find block start
-    if (itr == stop) itr = const_iterator(*this, size() - 1);
-    else --itr;
-    if (ignore_duplicates) {
-        auto cur_val = *itr;
-        while(*itr == cur_val and itr != start) --itr;
-        if (*itr != cur_val) ++itr; // reposition to beginning of run
-    }
-    return itr - start;
+    if (not s) return std::numeric_limits<std::size_t>::max();
+    auto [idx, lt] = prev_leq(s - 1);
+    if (ignore_duplicates and idx != std::numeric_limits<std::size_t>::max()) idx = next_geq(lt).first; // beginning of the run
+    return idx;
 }
 
 std::size_t
 array::gt_find(std::size_t s, bool ignore_duplicates) const // ignore duplicates on the cumulative sum, not the difference
 {
-    auto hb = s >> lsb.bit_width();
-    auto start_idx = hb ? msbrs.select0(hb - 1) - hb : 0; // msbrs.select0(hb - 1) - (hb - 1) - 1, but the two 1s cancel out
-    auto itr = const_iterator(*this, start_idx);
-    auto stop = cend();
-    for (; *itr <= s and itr != stop; ++itr) {
-        ++start_idx;
-    }
-    if (ignore_duplicates and itr != stop) {
-        auto gt = *itr;
-        auto prev = itr;
-        ++itr; // start_idx is not the same as (itr - cbegin()) because of this line
-        for (; *itr == gt and itr != stop; ++itr) {
-            ++prev;
-            ++start_idx;
+    const auto max = std::numeric_limits<std::size_t>::max();
+    auto [idx, gt] = s == max ? std::make_pair(size(), max) : next_geq(s + 1);
+    if (ignore_duplicates and idx != size()) idx = (gt == max ? size() : next_geq(gt + 1).first) - 1; // end of the run
+    return idx;
+}
+
+/*
+ * The bucket of x (elements with the same high bits) starts after the (h-1)-th zero of msbrs (one select0)
+ * and ends at the next zero, which is found by scanning words since buckets are short on average.
+ * Inside the bucket the low bits are sorted and searched without branches.
+ * Indexes in msbrs and lsb are shifted by one because of the virtual 0 at the beginning.
+ */
+std::pair<std::size_t, std::size_t>
+array::next_geq(std::size_t x) const
+{
+    const std::pair<std::size_t, std::size_t> none = {size(), std::numeric_limits<std::size_t>::max()};
+    const std::size_t l = lsb.bit_width();
+    const std::size_t h = x >> l;
+    if (not size() or h >= msbrs.size0()) return none;
+    auto const& msb = msbrs.data();
+    const std::size_t bucket_start = h ? msbrs.select0(h - 1) + 1 : 0;
+    const std::size_t bucket_end = next_bit(msb, bucket_start, false);
+    const std::size_t first = h ? bucket_start - h : 1;
+    const std::size_t last = bucket_end - h;
+    const std::size_t idx = bucket_bound(first, last, x & ((static_cast<std::size_t>(1) << l) - 1), false);
+    if (idx < last) return {idx - 1, (h << l) | lsb_at(idx)};
+    const std::size_t pos = next_bit(msb, bucket_end + 1, true); // first element of the next non-empty bucket
+    if (pos == msb.size()) return none;
+    return {idx - 1, ((pos - idx) << l) | lsb_at(idx)};
+}
+
+std::pair<std::size_t, std::size_t>
+array::prev_leq(std::size_t x) const
+{
+    const std::pair<std::size_t, std::size_t> none = {std::numeric_limits<std::size_t>::max(), 0};
+    const std::size_t l = lsb.bit_width();
+    const std::size_t h = x >> l;
+    if (not size()) return none;
+    if (h >= msbrs.size0()) return {size() - 1, back()};
+    auto const& msb = msbrs.data();
+    const std::size_t bucket_start = h ? msbrs.select0(h - 1) + 1 : 0;
+    const std::size_t first = h ? bucket_start - h : 1;
+    const std::size_t last = next_bit(msb, bucket_start, false) - h;
+    const std::size_t idx = bucket_bound(first, last, x & ((static_cast<std::size_t>(1) << l) - 1), true);
+    if (idx > first) return {idx - 2, (h << l) | lsb_at(idx - 1)};
+    if (idx == 1) return none; // only the virtual 0 is smaller
+    const std::size_t pos = prev_one(msb, bucket_start); // last element of the previous non-empty bucket
+    return {idx - 2, ((pos - idx + 1) << l) | lsb_at(idx - 1)};
+}
+
+/*
+ * Walks out once: the low bits of each block of decode_block_size elements are unpacked into a buffer in the 
+ * L1 cache, then combined with the high parts while walking the ones of msbrs word by word.
+ */
+void
+array::decode(std::size_t from, std::size_t count, uint64_t* out) const
+{
+    if (from > size() or count > size() - from) throw std::out_of_range("[Elias-Fano] decode range out of bounds");
+    if (not count) return;
+    constexpr std::size_t decode_block_size = 256; // a multiple of the width of the cells of lsb
+    uint64_t low[decode_block_size];
+    const std::size_t l = lsb.bit_width();
+    auto const* words = msbrs.data().data();
+    const std::size_t first = from + 1; // virtual 0 at the beginning
+    const std::size_t pos = msbrs.select1(first);
+    std::size_t w = pos / word_bit_size;
+    max_width_native_type word = words[w] & (~static_cast<max_width_native_type>(0) << (pos % word_bit_size));
+    std::size_t base = w * word_bit_size - first; // position - index of the element, for the bits of word w
+    std::size_t i = 0;
+    while (i < count) {
+        const std::size_t block_start = i;
+        const std::size_t block_end = std::min(count, ((first + i) / decode_block_size + 1) * decode_block_size - first); // aligned blocks of lsb
+        lsb.unpack(first + i, block_end - i, low);
+        while (true) {
+            const std::size_t stop = std::min(block_end, i + static_cast<std::size_t>(popcount(word))); // known trip count
+            for (; i < stop; ++i) {
+                out[i] = static_cast<uint64_t>(base + lsbll(word) - i) << l | low[i - block_start];
+                word &= word - 1;
+            }
+            if (i == block_end) break;
+            word = words[++w];
+            base += word_bit_size;
         }
     }
-    return start_idx;
 }
 
 std::size_t 
@@ -139,6 +273,7 @@ array::swap(array& other) noexcept
 {
     msbrs.swap(other.msbrs);
     lsb.swap(other.lsb);
+    std::swap(_size, other._size);
 }
 
 std::tuple<std::size_t, std::size_t> 
@@ -159,9 +294,22 @@ array::prev_and_at(std::size_t idx) const
 std::size_t 
 array::lsb_at(std::size_t idx) const
 {
-    // if (lsb.bit_width()) return lsb.template at<std::size_t>(idx);
-    if (lsb.bit_width()) return static_cast<std::size_t>(lsb.at(idx));
-    return 0;
+    return static_cast<std::size_t>(lsb.get(idx)); // 0 if the width is 0
+}
+
+std::size_t
+array::bucket_bound(std::size_t first, std::size_t last, std::size_t low, bool strict) const // first index in [first, last) with low bits >= low (> low if strict)
+{
+    if (first == last) return first;
+    const std::size_t bound = low + strict;
+    std::size_t base = first;
+    std::size_t n = last - first;
+    while (n > 1) {
+        const std::size_t half = n / 2;
+        base = (lsb_at(base + half) < bound) ? base + half : base; // conditional move
+        n -= half;
+    }
+    return base + (lsb_at(base) < bound);
 }
 
 bool operator==(array const& a, array const& b) 
@@ -66,4 +66,52 @@ void mut_saver::visit(std::string& s)
     // num_bytes_vecs_of_pods += nr;
 }
 
-} // namespace io
\ No newline at end of file
+aligned_saver::aligned_saver(std::ostream& output_stream) : ostrm(output_stream)
+{
+    if (!ostrm.good()) throw std::runtime_error("[Aligned saver] Unwritable output stream");
+}
+
+void aligned_saver::visit(std::string const& s)
+{
+    basic_store(s, ostrm);
+}
+
+void aligned_saver::pad()
+{
+    const std::size_t misalignment = static_cast<std::size_t>(ostrm.tellp()) % alignment;
+    if (misalignment) {
+        const char zeros[alignment] = {};
+        ostrm.write(zeros, alignment - misalignment);
+    }
+}
+
+mapped_loader::mapped_loader(std::string const& filename, int adv)
+    : source(std::make_shared<memory::map::file_source<uint8_t>>(filename, adv)), offset(0)
+{}
+
+void mapped_loader::visit(std::string& s)
+{
+    std::size_t n;
+    visit(n);
+    s.assign(reinterpret_cast<char const*>(next(n)), n);
+}
+
+uint8_t const* mapped_loader::next(std::size_t nbytes)
+{
+    if (nbytes > source->bytes() - offset) throw std::runtime_error("[Mapped loader] unexpected end of file");
+    auto const* r = source->data() + offset;
+    offset += nbytes;
+    return r;
+}
+
+void mapped_loader::check_length(std::size_t n, std::size_t element_bytes) const
+{
+    if (n > (source->bytes() - offset) / element_bytes) throw std::runtime_error("[Mapped loader] unexpected end of file"); // n * element_bytes may overflow
+}
+
+void mapped_loader::skip_padding()
+{
+    if (offset % alignment) next(alignment - offset % alignment);
+}
+
+} // namespace io
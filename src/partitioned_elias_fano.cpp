@@ -0,0 +1,451 @@
+#include "../include/partitioned_elias_fano.hpp"
+#include <utility>
+
+namespace bit {
+namespace ef {
+
+namespace {
+
+static const std::size_t partition_fixed_cost = 64; // estimate, in bits, of a partition in the top-level arrays
+static const std::size_t word_bit_size = 64;
+using words_t = memory::map::backed_vector<uint64_t>;
+
+std::size_t width_of(std::size_t x) noexcept
+{
+    return x ? msbll(x) + 1 : 1;
+}
+
+std::size_t ef_width(std::size_t n, std::size_t u) noexcept
+{
+    return u / n ? msbll(u / n) : 0;
+}
+
+std::size_t ef_bits(std::size_t n, std::size_t u, std::size_t l) noexcept
+{
+    return n * l + n + (u >> l) + 1;
+}
+
+std::size_t read_bits(words_t const& words, std::size_t pos, std::size_t len) noexcept // len < 64
+{
+    if (not len) return 0;
+    const std::size_t w = pos / word_bit_size, sh = pos % word_bit_size;
+    uint64_t val = words[w] >> sh;
+    if (sh + len > word_bit_size) val |= words[w + 1] << (word_bit_size - sh);
+    return val & ((static_cast<uint64_t>(1) << len) - 1);
+}
+
+void write_bits(words_t& words, std::size_t pos, uint64_t val, std::size_t len) noexcept // words already sized
+{
+    if (not len) return;
+    const std::size_t w = pos / word_bit_size, sh = pos % word_bit_size;
+    words[w] |= val << sh;
+    if (sh + len > word_bit_size) words[w + 1] |= val >> (word_bit_size - sh);
+}
+
+void set_bit(words_t& words, std::size_t pos) noexcept
+{
+    words[pos / word_bit_size] |= static_cast<uint64_t>(1) << (pos % word_bit_size);
+}
+
+std::size_t next_one(words_t const& words, std::size_t pos) noexcept // first one at or after pos (must exist)
+{
+    std::size_t w = pos / word_bit_size;
+    uint64_t word = words[w] & (~static_cast<uint64_t>(0) << (pos % word_bit_size));
+    while (not word) word = words[++w];
+    return w * word_bit_size + lsbll(word);
+}
+
+std::size_t prev_one(words_t const& words, std::size_t pos) noexcept // 1 + last one before pos, 0 if none
+{
+    while (pos) {
+        const std::size_t w = (pos - 1) / word_bit_size;
+        const uint64_t word = words[w] & (~static_cast<uint64_t>(0) >> (word_bit_size - 1 - (pos - 1) % word_bit_size));
+        if (word) return w * word_bit_size + msbll(word) + 1;
+        pos = w * word_bit_size;
+    }
+    return 0;
+}
+
+std::size_t select_from(words_t const& words, std::size_t start, std::size_t k, bool ones) noexcept // k-th (0-based) one or zero at or after start
+{
+    std::size_t w = start / word_bit_size;
+    uint64_t word = (ones ? words[w] : ~words[w]) & (~static_cast<uint64_t>(0) << (start % word_bit_size));
+    std::size_t c = popcount(word);
+    while (c <= k) {
+        k -= c;
+        ++w;
+        word = ones ? words[w] : ~words[w];
+        c = popcount(word);
+    }
+    return w * word_bit_size + select1(word, k);
+}
+
+std::size_t rank_from(words_t const& words, std::size_t start, std::size_t len) noexcept // ones in [start, start + len)
+{
+    if (not len) return 0;
+    const std::size_t stop = start + len;
+    std::size_t first = start / word_bit_size, last = (stop - 1) / word_bit_size;
+    const uint64_t head = ~static_cast<uint64_t>(0) << (start % word_bit_size);
+    const uint64_t tail = ~static_cast<uint64_t>(0) >> (word_bit_size - 1 - (stop - 1) % word_bit_size);
+    if (first == last) return popcount(static_cast<uint64_t>(words[first] & head & tail));
+    std::size_t r = popcount(static_cast<uint64_t>(words[first] & head)) + popcount(static_cast<uint64_t>(words[last] & tail));
+    if (last > first + 1) r += popcount_words(words.data() + first + 1, last - first - 1);
+    return r;
+}
+
+} // namespace
+
+/*
+ * Cheapest encoding of values[a, b), relative to the last value of the previous partition.
+ * duplicates[i] is the number of j in [1, i) such that values[j] == values[j - 1].
+ */
+std::pair<uint8_t, std::size_t>
+partitioned_array::choose_encoding(std::vector<std::size_t> const& values, std::vector<std::size_t> const& duplicates, std::size_t a, std::size_t b)
+{
+    const std::size_t base = a ? values[a - 1] : 0;
+    const std::size_t n = b - a;
+    const std::size_t u = values[b - 1] - base;
+    const bool strict = duplicates[b] == duplicates[a + 1];
+    if (strict and u == n and values[a] > base) return {run, 0}; // exactly base + 1, ..., base + n
+    const std::size_t l = ef_width(n, u);
+    std::pair<uint8_t, std::size_t> best = {elias_fano, ef_bits(n, u, l)};
+    if (strict and u < best.second) best = {bitmap, u + 1};
+    return best;
+}
+
+void
+partitioned_array::build(std::vector<std::size_t> const& values)
+{
+    const std::size_t n = values.size();
+    _size = n;
+    if (not n) return;
+    std::vector<std::size_t> duplicates(n + 1, 0);
+    for (std::size_t i = 1; i < n; ++i) {
+        if (values[i] < values[i - 1]) throw std::runtime_error("[Partitioned Elias-Fano] sequence is not sorted");
+        duplicates[i + 1] = duplicates[i] + (values[i] == values[i - 1]);
+    }
+
+    // shortest path over the candidate boundaries (multiples of the granularity, plus n)
+    const std::size_t m = (n + partition_granularity - 1) / partition_granularity;
+    const std::size_t max_span = max_partition_size / partition_granularity;
+    auto boundary = [&](std::size_t j) {return std::min(j * partition_granularity, n);};
+    std::vector<std::size_t> cost(m + 1, std::numeric_limits<std::size_t>::max());
+    std::vector<std::size_t> previous(m + 1, 0);
+    cost[0] = 0;
+    for (std::size_t j = 1; j <= m; ++j) {
+        for (std::size_t i = j - 1; i + max_span >= j; --i) {
+            auto c = cost[i] + partition_fixed_cost + choose_encoding(values, duplicates, boundary(i), boundary(j)).second;
+            if (c < cost[j]) {
+                cost[j] = c;
+                previous[j] = i;
+            }
+            if (i == 0) break;
+        }
+    }
+    std::vector<std::size_t> cuts;
+    for (std::size_t j = m; j; j = previous[j]) cuts.push_back(boundary(j));
+    cuts.push_back(0);
+
+    bit::vector<uint64_t> ends(m);
+    std::vector<std::size_t> starts;
+    std::size_t pos = 0;
+    for (std::size_t c = cuts.size() - 1; c; --c) {
+        const std::size_t a = cuts[c], b = cuts[c - 1];
+        const std::size_t base = a ? values[a - 1] : 0;
+        const std::size_t u = values[b - 1] - base;
+        const auto [type, bits] = choose_encoding(values, duplicates, a, b);
+        ends.set((b - 1) / partition_granularity);
+        starts.push_back(pos);
+        types.push_back(type);
+        stream.resize((pos + bits + word_bit_size - 1) / word_bit_size, 0);
+        if (type == bitmap) {
+            for (std::size_t i = a; i < b; ++i) set_bit(stream, pos + values[i] - base);
+        } else if (type == elias_fano) {
+            const std::size_t l = ef_width(b - a, u);
+            const std::size_t high_offset = pos + (b - a) * l;
+            const uint64_t low_mask = (static_cast<uint64_t>(1) << l) - 1;
+            for (std::size_t i = a; i < b; ++i) {
+                const std::size_t r = values[i] - base;
+                write_bits(stream, pos + (i - a) * l, r & low_mask, l);
+                set_bit(stream, high_offset + (r >> l) + (i - a));
+            }
+        }
+        pos += bits;
+    }
+    partition_ends = rs_t(std::move(ends));
+    upper_bounds = pv_t(width_of(values.back()));
+    upper_bounds.reserve(starts.size());
+    for (std::size_t c = cuts.size() - 1; c; --c) upper_bounds.push_back(values[cuts[c - 1] - 1]);
+    offsets = pv_t(width_of(starts.back()));
+    offsets.reserve(starts.size());
+    for (auto start : starts) offsets.push_back(start);
+}
+
+std::size_t
+partitioned_array::front() const
+{
+    return at(0);
+}
+
+std::size_t
+partitioned_array::back() const
+{
+    return at(size() - 1);
+}
+
+std::size_t
+partitioned_array::at(std::size_t idx) const
+{
+    if (idx >= size()) throw std::out_of_range("[Partitioned Elias-Fano] index out of range");
+    auto part = locate(idx);
+    std::size_t position;
+    return part.base + local_at(part, idx - part.begin, position);
+}
+
+std::size_t
+partitioned_array::lt_find(std::size_t s, bool ignore_duplicates) const
+{
+    auto idx = lower_bound(s);
+    if (idx == 0) return std::numeric_limits<std::size_t>::max(); // same as bit::ef::array
+    --idx;
+    if (ignore_duplicates) idx = lower_bound(at(idx)); // beginning of the run
+    return idx;
+}
+
+std::size_t
+partitioned_array::gt_find(std::size_t s, bool ignore_duplicates) const
+{
+    const auto max = std::numeric_limits<std::size_t>::max();
+    auto idx = s == max ? size() : lower_bound(s + 1);
+    if (ignore_duplicates and idx != size()) {
+        auto gt = at(idx);
+        idx = (gt == max ? size() : lower_bound(gt + 1)) - 1; // end of the run
+    }
+    return idx;
+}
+
+std::size_t
+partitioned_array::size() const noexcept
+{
+    return _size;
+}
+
+std::size_t
+partitioned_array::bit_size() const noexcept
+{
+    return
+        partition_ends.bit_size() +
+        upper_bounds.bit_size() +
+        offsets.bit_size() +
+        8 * types.size() +
+        word_bit_size * stream.size() +
+        bit::size(_size);
+}
+
+std::size_t
+partitioned_array::partitions() const noexcept
+{
+    return types.size();
+}
+
+partitioned_array::const_iterator
+partitioned_array::cbegin() const
+{
+    return const_iterator(*this, 0);
+}
+
+partitioned_array::const_iterator
+partitioned_array::cend() const
+{
+    return const_iterator(*this, size());
+}
+
+partitioned_array::const_iterator
+partitioned_array::begin() const
+{
+    return cbegin();
+}
+
+partitioned_array::const_iterator
+partitioned_array::end() const
+{
+    return cend();
+}
+
+void
+partitioned_array::swap(partitioned_array& other) noexcept
+{
+    partition_ends.swap(other.partition_ends);
+    upper_bounds.swap(other.upper_bounds);
+    offsets.swap(other.offsets);
+    types.swap(other.types);
+    stream.swap(other.stream);
+    std::swap(_size, other._size);
+}
+
+partitioned_array::partition
+partitioned_array::locate(std::size_t idx) const
+{
+    const std::size_t block = idx / partition_granularity;
+    const std::size_t begin = prev_one(partition_ends.data().vector_data(), block) * partition_granularity;
+    return get_partition(partition_ends.rank1(block), begin);
+}
+
+partitioned_array::partition
+partitioned_array::get_partition(std::size_t p, std::size_t begin) const
+{
+    partition part;
+    part.idx = p;
+    part.begin = begin;
+    part.end = std::min((next_one(partition_ends.data().vector_data(), begin / partition_granularity) + 1) * partition_granularity, _size);
+    part.base = p ? static_cast<std::size_t>(upper_bounds.get(p - 1)) : 0;
+    part.universe = static_cast<std::size_t>(upper_bounds.get(p)) - part.base;
+    part.offset = static_cast<std::size_t>(offsets.get(p));
+    part.type = types[p];
+    part.width = part.type == elias_fano ? ef_width(part.size(), part.universe) : 0;
+    return part;
+}
+
+std::size_t
+partitioned_array::local_at(partition const& part, std::size_t k, std::size_t& position) const
+{
+    switch (part.type) {
+        case run:
+            position = part.offset;
+            return k + 1;
+        case bitmap:
+            position = select_from(stream, part.offset, k, true);
+            return position - part.offset;
+        default:
+            position = select_from(stream, part.high_offset(), k, true);
+            return ((position - part.high_offset() - k) << part.width) | read_bits(stream, part.offset + k * part.width, part.width);
+    }
+}
+
+std::size_t
+partitioned_array::lower_bound(std::size_t s) const
+{
+    if (not size() or s > upper_bounds.template back<std::size_t>()) return size();
+    std::size_t p = 0, count = upper_bounds.size(); // binary search of the first partition whose last value is >= s
+    while (count) {
+        const std::size_t half = count / 2;
+        if (static_cast<std::size_t>(upper_bounds.get(p + half)) < s) {
+            p += half + 1;
+            count -= half + 1;
+        } else count = half;
+    }
+    const auto part = get_partition(p, p ? (partition_ends.select1(p - 1) + 1) * partition_granularity : 0);
+    const std::size_t t = s - part.base; // > 0, except for the first partition
+    std::size_t k;
+    switch (part.type) {
+        case run:
+            k = t ? t - 1 : 0;
+            break;
+        case bitmap:
+            k = rank_from(stream, part.offset, t);
+            break;
+        default: {
+            const std::size_t h = t >> part.width;
+            const std::size_t high_offset = part.high_offset();
+            std::size_t position = high_offset;
+            k = 0;
+            if (h) { // skip the elements with smaller high bits
+                position = select_from(stream, high_offset, h - 1, false);
+                k = position - high_offset - (h - 1);
+                ++position;
+            }
+            position = next_one(stream, position);
+            while ((((position - high_offset - k) << part.width) | read_bits(stream, part.offset + k * part.width, part.width)) < t) {
+                ++k;
+                position = next_one(stream, position + 1);
+            }
+        }
+    }
+    return part.begin + k;
+}
+
+bool operator==(partitioned_array const& a, partitioned_array const& b)
+{
+    bool same_top_level = a.partition_ends == b.partition_ends and a.upper_bounds == b.upper_bounds and a.offsets == b.offsets;
+    bool same_partitions = a.types == b.types and a.stream == b.stream;
+    bool same_size = a._size == b._size;
+    return same_top_level and same_partitions and same_size;
+}
+
+bool operator!=(partitioned_array const& a, partitioned_array const& b)
+{
+    return not (a == b);
+}
+
+partitioned_array::const_iterator::const_iterator(partitioned_array const& view, std::size_t idx)
+    : parent_view(&view), index(idx), current(), position(0), value(0)
+{
+    if (idx > parent_view->size()) throw std::out_of_range("[Partitioned Elias-Fano] iterator out of range");
+    if (idx < parent_view->size()) {
+        current = parent_view->locate(idx);
+        load_element();
+    }
+}
+
+void
+partitioned_array::const_iterator::load_element() noexcept
+{
+    value = current.base + parent_view->local_at(current, index - current.begin, position);
+}
+
+partitioned_array::const_iterator const&
+partitioned_array::const_iterator::operator++() noexcept
+{
+    if (index >= parent_view->size()) return *this;
+    ++index;
+    if (index == parent_view->size()) return *this;
+    if (index == current.end) {
+        current = parent_view->get_partition(current.idx + 1, index);
+        load_element();
+        return *this;
+    }
+    auto const& stream = parent_view->stream;
+    switch (current.type) {
+        case run:
+            ++value;
+            break;
+        case bitmap:
+            position = next_one(stream, position + 1);
+            value = current.base + position - current.offset;
+            break;
+        default: {
+            const std::size_t k = index - current.begin;
+            position = next_one(stream, position + 1);
+            value = current.base + (((position - current.high_offset() - k) << current.width) | read_bits(stream, current.offset + k * current.width, current.width));
+        }
+    }
+    return *this;
+}
+
+partitioned_array::const_iterator
+partitioned_array::const_iterator::operator++(int) noexcept
+{
+    auto current = *this;
+    operator++();
+    return current;
+}
+
+partitioned_array::const_iterator const&
+partitioned_array::const_iterator::operator--() noexcept
+{
+    if (index == reverse_out_of_bound_marker) return *this;
+    if (index == 0) index = reverse_out_of_bound_marker;
+    else *this = const_iterator(*parent_view, index - 1);
+    return *this;
+}
+
+partitioned_array::const_iterator
+partitioned_array::const_iterator::operator--(int) noexcept
+{
+    auto current = *this;
+    operator--();
+    return current;
+}
+
+} // namespace ef
+} // namespace bit
@@ -2,7 +2,10 @@
 #include <random>
 #include <iostream>
 #include <cassert>
+#include <vector>
+#include <algorithm>
 #include "../include/bit_operations.hpp"
+#include "../include/logtools.hpp"
 
 template <typename T>
 constexpr int emulated_parity(T x) // local version of generic parity computation
@@ -38,6 +41,125 @@ void test_number(std::size_t t)
     assert(bit::parity(t) == emulated_parity(t));
 }
 
+std::size_t naive_select1(uint64_t x, std::size_t th)
+{
+    for (std::size_t i = 0; i < 64; ++i) {
+        if ((x >> i) & 1ULL) {
+            if (th == 0) return i;
+            --th;
+        }
+    }
+    throw std::logic_error("[naive select] not enough ones");
+}
+
+template <bit::bulk_op Op>
+void check_bulk_kernels(std::vector<uint64_t> const& a, std::vector<uint64_t> const& b)
+{
+    for (std::size_t n : {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 100, 997}) {
+        std::vector<uint64_t> expected(n), out(n);
+        for (std::size_t i = 0; i < n; ++i) expected[i] = bit::bulk_apply<Op>(a[i], b[i]);
+        bit::bulk_words<Op>(out.data(), a.data(), b.data(), n);
+        if (out != expected) throw std::runtime_error("[bulk words] FAIL");
+#ifdef BIOLIB_X86_DISPATCH
+        if (cpu::has_avx2()) {
+            std::fill(out.begin(), out.end(), 0);
+            bit::detail::bulk_words_avx2<Op>(out.data(), a.data(), b.data(), n);
+            if (out != expected) throw std::runtime_error("[bulk words avx2] FAIL");
+        }
+        if (cpu::has_avx512()) {
+            std::fill(out.begin(), out.end(), 0);
+            bit::detail::bulk_words_avx512<Op>(out.data(), a.data(), b.data(), n);
+            if (out != expected) throw std::runtime_error("[bulk words avx512] FAIL");
+        }
+#endif
+        std::size_t common = 0;
+        for (std::size_t i = 0; i < n; ++i) common += bit::popcount(a[i] & b[i]);
+        if (bit::intersect_count_words(a.data(), b.data(), n) != common) throw std::runtime_error("[intersect count] FAIL");
+        if (bit::detail::intersect_count_words_scalar(a.data(), b.data(), n) != common) throw std::runtime_error("[intersect count scalar] FAIL");
+#ifdef BIOLIB_X86_DISPATCH
+        if (cpu::has_popcnt() and bit::detail::intersect_count_words_popcnt(a.data(), b.data(), n) != common) throw std::runtime_error("[intersect count popcnt] FAIL");
+        if (cpu::has_avx2() and bit::detail::intersect_count_words_avx2(a.data(), b.data(), n) != common) throw std::runtime_error("[intersect count avx2] FAIL");
+        if (cpu::has_avx512_vpopcnt() and bit::detail::intersect_count_words_avx512(a.data(), b.data(), n) != common) throw std::runtime_error("[intersect count avx512] FAIL");
+#endif
+    }
+}
+
+/* 
+ * Every kernel supported by the host must agree with the naive versions, whatever select1 and popcount_words dispatch to.
+ */
+void check_kernels(std::mt19937_64& gen)
+{
+    for (std::size_t i = 0; i < 200000; ++i) {
+        uint64_t x = gen();
+        if (i % 3 == 1) x &= gen(); // sparser
+        if (i % 3 == 2) x |= gen(); // denser
+        if (not x) continue;
+        std::size_t th = gen() % bit::popcount(x);
+        auto expected = naive_select1(x, th);
+        if (static_cast<std::size_t>(bit::select1(x, th)) != expected) throw std::runtime_error("[select1] FAIL");
+        if (static_cast<std::size_t>(bit::detail::select1_broadword(x, th)) != expected) throw std::runtime_error("[select1 broadword] FAIL");
+#ifdef BIOLIB_X86_DISPATCH
+        if (cpu::has_bmi2() and static_cast<std::size_t>(bit::detail::select1_pdep(x, th)) != expected) throw std::runtime_error("[select1 pdep] FAIL");
+#endif
+        if (static_cast<std::size_t>(bit::select0(~x, th)) != expected) throw std::runtime_error("[select0] FAIL");
+    }
+    if (bit::select1(1ULL << 63, 0) != 63 or bit::select1(~0ULL, 63) != 63 or bit::select1(~0ULL, 0) != 0) throw std::runtime_error("[select1] FAIL (extremes)");
+
+    std::vector<uint64_t> words(1000);
+    for (auto& w : words) w = gen();
+    words[17] = ~0ULL;
+    words[18] = 0;
+    for (std::size_t offset : {0, 1, 3}) {
+        for (std::size_t n : {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 100, 997}) {
+            std::size_t expected = 0;
+            for (std::size_t i = 0; i < n; ++i) for (std::size_t j = 0; j < 64; ++j) expected += (words[offset + i] >> j) & 1ULL;
+            uint64_t const* p = words.data() + offset; // unaligned for the vector kernels
+            if (bit::popcount_words(p, n) != expected) throw std::runtime_error("[popcount words] FAIL");
+            if (bit::detail::popcount_words_scalar(p, n) != expected) throw std::runtime_error("[popcount words scalar] FAIL");
+#ifdef BIOLIB_X86_DISPATCH
+            if (cpu::has_popcnt() and bit::detail::popcount_words_popcnt(p, n) != expected) throw std::runtime_error("[popcount words popcnt] FAIL");
+            if (cpu::has_avx2() and bit::detail::popcount_words_avx2(p, n) != expected) throw std::runtime_error("[popcount words avx2] FAIL");
+            if (cpu::has_avx512_vpopcnt() and bit::detail::popcount_words_avx512(p, n) != expected) throw std::runtime_error("[popcount words avx512] FAIL");
+#endif
+        }
+    }
+
+    std::vector<uint64_t> other(words.size());
+    for (auto& w : other) w = gen() & gen();
+    check_bulk_kernels<bit::bulk_op::and_op>(words, other);
+    check_bulk_kernels<bit::bulk_op::or_op>(words, other);
+    check_bulk_kernels<bit::bulk_op::xor_op>(words, other);
+    check_bulk_kernels<bit::bulk_op::and_not_op>(words, other);
+}
+
+void benchmark_kernels(std::mt19937_64& gen)
+{
+    logging_tools::micro_timer timer;
+    std::vector<uint64_t> words(1 << 20);
+    for (auto& w : words) w = gen();
+    std::vector<std::size_t> ths(words.size());
+    for (std::size_t i = 0; i < words.size(); ++i) ths[i] = gen() % bit::popcount(words[i]);
+    const std::size_t popcount_words = 1 << 15; // L2-resident
+    volatile std::size_t dummy = 0;
+    std::size_t sum = 0;
+
+    timer.start();
+    for (std::size_t i = 0; i < words.size(); ++i) sum += bit::detail::select1_broadword(words[i], ths[i]);
+    auto broadword_time = timer.stop(false);
+    timer.start();
+    for (std::size_t i = 0; i < words.size(); ++i) sum += bit::select1(words[i], ths[i]);
+    auto select_time = timer.stop(false);
+    timer.start();
+    for (std::size_t r = 0; r < 256; ++r) sum += bit::detail::popcount_words_scalar(words.data() + r, popcount_words);
+    auto scalar_time = timer.stop(false);
+    timer.start();
+    for (std::size_t r = 0; r < 256; ++r) sum += bit::popcount_words(words.data() + r, popcount_words);
+    auto popcount_time = timer.stop(false);
+    dummy = dummy + sum;
+    std::cerr << "select1: broadword " << broadword_time << " us, dispatched " << select_time << " us (pdep " << (cpu::has_fast_pdep() ? "on" : "off") << ")\n";
+    std::cerr << "popcount of " << 256 * popcount_words << " words: scalar " << scalar_time << " us, dispatched " << popcount_time << " us (avx2 " << (cpu::has_avx2() ? "on" : "off") << ", avx512 " << (cpu::has_avx512_vpopcnt() ? "on" : "off") << ")\n";
+}
+
 int main()
 {
     std::size_t x = 1;
@@ -60,6 +182,10 @@ int main()
     std::cerr << "select1(" << s << ", " << "0) = " << bit::select1(s, 0) << std::endl;
     std::cerr << "select1(" << s << ", " << "1) = " << bit::select1(s, 1) << std::endl;
 
+    std::mt19937_64 gen64(42);
+    check_kernels(gen64);
+    benchmark_kernels(gen64);
+
     std::cerr << "Everything is OK\n";
 
     return 0;
@@ -1,12 +1,23 @@
 #include <random>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 #include "../include/bit_vector.hpp"
 #include "../include/io.hpp"
+#include "../include/logtools.hpp"
 
 template <typename T>
 void check_bit_vector(size_t seed, size_t vector_size, size_t insertions);
 
+template <typename T>
+void check_bulk_operations(size_t seed);
+
+template <typename T>
+void check_one_positions(size_t seed);
+
+void benchmark_bulk_operations(size_t seed, size_t vector_size, size_t nvectors);
+void benchmark_one_positions(size_t seed, size_t vector_size);
+
 int main()
 {
     using namespace std;
@@ -19,6 +30,16 @@ int main()
     check_bit_vector<uint16_t>(seed, binary_vector_size, insertions);
     check_bit_vector<uint32_t>(seed, binary_vector_size, insertions);
     check_bit_vector<uint64_t>(seed, binary_vector_size, insertions);
+    check_bulk_operations<uint8_t>(seed);
+    check_bulk_operations<uint16_t>(seed);
+    check_bulk_operations<uint32_t>(seed);
+    check_bulk_operations<uint64_t>(seed);
+    check_one_positions<uint8_t>(seed);
+    check_one_positions<uint16_t>(seed);
+    check_one_positions<uint32_t>(seed);
+    check_one_positions<uint64_t>(seed);
+    benchmark_bulk_operations(seed, 1 << 20, 64);
+    benchmark_one_positions(seed, 1 << 24);
     cerr << "Everything is OK\n";
 
     return 0;
@@ -85,4 +106,204 @@ void check_bit_vector(size_t seed, size_t vector_size, size_t insertions)
     }
     bvec.clear();
     assert(bvec.size() == 0);
-}
\ No newline at end of file
+}
+template <typename T>
+bit::vector<T> random_bit_vector(std::mt19937& gen, std::size_t size, std::size_t density_percent)
+{
+    bit::vector<T> bvec;
+    for (std::size_t i = 0; i < size; ++i) bvec.push_back(gen() % 100 < density_percent);
+    return bvec;
+}
+
+template <typename T>
+void check_bulk_operations(size_t seed)
+{
+    std::mt19937 gen(seed);
+    for (std::size_t size : {0, 1, 7, 63, 64, 65, 511, 512, 1000, 100003}) {
+        auto a = random_bit_vector<T>(gen, size, 50);
+        auto b = random_bit_vector<T>(gen, size, 10);
+        std::size_t ones = 0, common = 0;
+        bit::vector<T> and_expected, or_expected, xor_expected, and_not_expected;
+        for (std::size_t i = 0; i < size; ++i) {
+            ones += a.at(i);
+            common += a.at(i) and b.at(i);
+            and_expected.push_back(a.at(i) and b.at(i));
+            or_expected.push_back(a.at(i) or b.at(i));
+            xor_expected.push_back(a.at(i) != b.at(i));
+            and_not_expected.push_back(a.at(i) and not b.at(i));
+        }
+        if (a.count() != ones) throw std::runtime_error("[bit::vector] FAIL (count)");
+        if (a.intersect_count(b) != common or b.intersect_count(a) != common) throw std::runtime_error("[bit::vector] FAIL (intersect_count)");
+        if ((a & b) != and_expected or (a | b) != or_expected or (a ^ b) != xor_expected or and_not(a, b) != and_not_expected) {
+            throw std::runtime_error("[bit::vector] FAIL (out-of-place operations)");
+        }
+        auto c = a;
+        if ((c &= b) != and_expected) throw std::runtime_error("[bit::vector] FAIL (&=)");
+        c = a;
+        if ((c |= b) != or_expected) throw std::runtime_error("[bit::vector] FAIL (|=)");
+        c = a;
+        if ((c ^= b) != xor_expected) throw std::runtime_error("[bit::vector] FAIL (^=)");
+        c = a;
+        if (c.and_not(b) != and_not_expected) throw std::runtime_error("[bit::vector] FAIL (and_not)");
+        c = a;
+        if ((c ^= c).count() != 0 or (c |= a) != a) throw std::runtime_error("[bit::vector] FAIL (aliased operands)");
+
+        std::vector<std::size_t> prefix(size + 1, 0);
+        for (std::size_t i = 0; i < size; ++i) prefix[i + 1] = prefix[i] + a.at(i);
+        for (std::size_t r = 0; r < 200; ++r) {
+            std::size_t start = size ? gen() % (size + 1) : 0;
+            std::size_t stop = size ? gen() % (size + 1) : 0;
+            if (start > stop) std::swap(start, stop);
+            if (a.count_range(start, stop) != prefix[stop] - prefix[start]) throw std::runtime_error("[bit::vector] FAIL (count_range)");
+        }
+        if (a.count_range(0, size) != ones or a.count_range(size, size) != 0) throw std::runtime_error("[bit::vector] FAIL (count_range bounds)");
+        try {
+            a.count_range(0, size + 1);
+            throw std::logic_error("[bit::vector] FAIL (count_range out of range)");
+        } catch (std::out_of_range const&) {}
+    }
+    { // bits beyond size() are cleared by resize and do not leak into the results
+        bit::vector<T> a(100, true), b(100, true);
+        a.resize(70);
+        b.resize(70, true);
+        if (a.count() != 70 or a.intersect_count(b) != 70 or (a & b).count() != 70 or (a ^ b).count() != 0) throw std::runtime_error("[bit::vector] FAIL (unused bits)");
+        a.pop_back();
+        a.resize(80);
+        a.push_back(false);
+        if (a.count() != 69 or a.at(69) or a.at(80)) throw std::runtime_error("[bit::vector] FAIL (unused bits after pop_back and resize)");
+        try {
+            a &= bit::vector<T>(71);
+            throw std::logic_error("[bit::vector] FAIL (size mismatch not detected)");
+        } catch (std::invalid_argument const&) {}
+    }
+}
+
+template <typename T>
+void check_one_positions(size_t seed)
+{
+    std::mt19937 gen(seed);
+    for (std::size_t density : {0, 1, 30, 100}) {
+        for (std::size_t size : {0, 1, 7, 64, 65, 1000, 100003}) {
+            auto bvec = random_bit_vector<T>(gen, size, density);
+            std::vector<std::size_t> ones;
+            for (std::size_t i = 0; i < size; ++i) if (bvec.at(i)) ones.push_back(i);
+
+            std::vector<std::size_t> forward;
+            for (auto itr = bvec.cpos_begin(); itr != bvec.cpos_end(); ++itr) forward.push_back(*itr);
+            if (forward != ones) throw std::runtime_error("[one_position_iterator] FAIL (operator++)");
+
+            if (not ones.empty()) {
+                auto itr = bvec.cpos_begin() + (ones.back() - ones.front()); // operator+ moves from the current position
+                for (auto r = ones.rbegin(); r != ones.rend(); ++r, --itr) {
+                    if (*itr != *r) throw std::runtime_error("[one_position_iterator] FAIL (operator--)");
+                }
+                if (*itr != ~std::size_t(0)) throw std::runtime_error("[one_position_iterator] FAIL (underflow)");
+                if (*(++itr) != ones.front()) throw std::runtime_error("[one_position_iterator] FAIL (operator++ after underflow)");
+                auto back = bvec.cpos_end();
+                if (*(--back) != ones.back()) throw std::runtime_error("[one_position_iterator] FAIL (operator-- from the end)");
+            }
+
+            for (std::size_t r = 0; r < 100 and size; ++r) { // jumps, then alternate directions
+                std::size_t start = gen() % size;
+                auto next = std::lower_bound(ones.begin(), ones.end(), start);
+                typename bit::vector<T>::one_position_iterator itr(bvec, start);
+                if (*itr != (next == ones.end() ? size : *next)) throw std::runtime_error("[one_position_iterator] FAIL (operator+)");
+                if (next != ones.end() and next + 1 != ones.end()) {
+                    ++itr;
+                    --itr;
+                    if (*itr != *next) throw std::runtime_error("[one_position_iterator] FAIL (operator++ then operator--)");
+                    --itr;
+                    ++itr;
+                    if (*itr != *next) throw std::runtime_error("[one_position_iterator] FAIL (operator-- then operator++)");
+                }
+            }
+
+            for (std::size_t max : {1, 3, 64, 1000000}) {
+                std::vector<std::size_t> decoded, buffer(max);
+                auto itr = bvec.cpos_begin();
+                std::size_t n;
+                while ((n = itr.decode_ones(buffer.data(), max)) > 0) {
+                    if (n > max) throw std::runtime_error("[one_position_iterator] FAIL (decode_ones overflow)");
+                    decoded.insert(decoded.end(), buffer.begin(), buffer.begin() + n);
+                    if (n < max and itr != bvec.cpos_end()) throw std::runtime_error("[one_position_iterator] FAIL (decode_ones stopped early)");
+                    if (itr != bvec.cpos_end() and *itr != ones.at(decoded.size())) throw std::runtime_error("[one_position_iterator] FAIL (position after decode_ones)");
+                }
+                if (decoded != ones) throw std::runtime_error("[one_position_iterator] FAIL (decode_ones)");
+            }
+        }
+    }
+}
+
+/*
+ * Merge of many membership bitmaps into an accumulator: block loop vs bulk operations.
+ */
+void benchmark_bulk_operations(size_t seed, size_t vector_size, size_t nvectors)
+{
+    std::mt19937 gen(seed);
+    std::vector<bit::vector<uint64_t>> bitmaps;
+    for (std::size_t i = 0; i < nvectors; ++i) {
+        bit::vector<uint64_t> bvec(vector_size);
+        for (std::size_t j = 0; j < vector_size / 64; ++j) bvec.set(gen() % vector_size);
+        bitmaps.push_back(std::move(bvec));
+    }
+    logging_tools::micro_timer timer;
+    volatile std::size_t dummy = 0;
+
+    timer.start();
+    std::vector<uint64_t> manual(bitmaps.front().block_size(), 0);
+    std::size_t manual_common = 0;
+    for (auto const& bvec : bitmaps) {
+        for (std::size_t i = 0; i < manual.size(); ++i) {
+            manual_common += bit::popcount(manual[i] & bvec.vector_data()[i]);
+            manual[i] |= bvec.vector_data()[i];
+        }
+    }
+    std::size_t manual_count = 0;
+    for (auto w : manual) manual_count += bit::popcount(w);
+    auto manual_time = timer.stop(false);
+
+    timer.start();
+    bit::vector<uint64_t> merged(vector_size);
+    std::size_t common = 0;
+    for (auto const& bvec : bitmaps) {
+        common += merged.intersect_count(bvec);
+        merged |= bvec;
+    }
+    std::size_t count = merged.count();
+    auto bulk_time = timer.stop(false);
+
+    if (count != manual_count or common != manual_common) throw std::runtime_error("[bit::vector] FAIL (merge benchmark)");
+    dummy = dummy + count;
+    std::cerr << "merge of " << nvectors << " bitmaps of " << vector_size << " bits: block loop " << manual_time << " us, bulk operations " << bulk_time << " us\n";
+}
+
+/*
+ * Positions of the ones of a vector with the density of Elias-Fano high bits (1/2).
+ */
+void benchmark_one_positions(size_t seed, size_t vector_size)
+{
+    std::mt19937 gen(seed);
+    bit::vector<uint64_t> bvec(vector_size);
+    for (std::size_t i = 0; i < vector_size; ++i) if (gen() % 2) bvec.set(i);
+    logging_tools::micro_timer timer;
+    volatile std::size_t dummy = 0;
+    std::size_t scan_sum = 0, itr_sum = 0, decode_sum = 0;
+
+    timer.start();
+    for (std::size_t i = 0; i < vector_size; ++i) if (bvec.at(i)) scan_sum += i;
+    auto scan_time = timer.stop(false);
+    timer.start();
+    for (auto itr = bvec.cpos_begin(); itr != bvec.cpos_end(); ++itr) itr_sum += *itr;
+    auto itr_time = timer.stop(false);
+    timer.start();
+    {
+        std::vector<std::size_t> buffer(1024);
+        auto itr = bvec.cpos_begin();
+        std::size_t n;
+        while ((n = itr.decode_ones(buffer.data(), buffer.size())) > 0) for (std::size_t i = 0; i < n; ++i) decode_sum += buffer[i];
+    }
+    auto decode_time = timer.stop(false);
+    if (itr_sum != scan_sum or decode_sum != scan_sum) throw std::runtime_error("[one_position_iterator] FAIL (benchmark)");
+    dummy = dummy + scan_sum;
+    std::cerr << "positions of the ones of " << vector_size << " bits: at() scan " << scan_time << " us, iterator " << itr_time << " us, decode_ones " << decode_time << " us\n";
+}
@@ -0,0 +1,102 @@
+/**
+ * concurrent bit vector test (comparison with a sequential bit::vector)
+ */
+
+#include <random>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "../include/bit_vector.hpp"
+#include "../include/concurrent_bit_vector.hpp"
+#include "../include/rank_select.hpp"
+#include "../include/logtools.hpp"
+
+template <typename T>
+void check_concurrent_vector(std::size_t seed, std::size_t vector_size, std::size_t nthreads, std::size_t insertions_per_thread);
+
+void check_freeze_without_copy(std::size_t vector_size, std::size_t nthreads);
+
+int main()
+{
+    const std::size_t seed = 42;
+    check_concurrent_vector<uint8_t>(seed, 1000, 4, 100000);
+    check_concurrent_vector<uint16_t>(seed, 1000003, 4, 100000);
+    check_concurrent_vector<uint32_t>(seed, 1000003, 4, 100000);
+    check_concurrent_vector<uint64_t>(seed, 1000003, 4, 100000);
+    check_concurrent_vector<uint64_t>(seed, 100, 8, 100000); // heavy contention on two blocks
+    check_freeze_without_copy(1 << 24, 4);
+    std::cerr << "Everything is OK\n";
+    return 0;
+}
+
+/*
+ * Every thread inserts its own random positions, first with test_and_set and then with set.
+ * Exactly one test_and_set must report each distinct position, whatever the interleaving.
+ */
+template <typename T>
+void check_concurrent_vector(std::size_t seed, std::size_t vector_size, std::size_t nthreads, std::size_t insertions_per_thread)
+{
+    std::vector<std::vector<std::size_t>> positions(nthreads);
+    bit::vector<T> expected(vector_size);
+    {
+        std::mt19937_64 gen(seed);
+        for (auto& v : positions) {
+            for (std::size_t i = 0; i < insertions_per_thread; ++i) {
+                v.push_back(gen() % vector_size);
+                expected.set(v.back());
+            }
+        }
+    }
+    auto run = [&](auto&& insert) {
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < nthreads; ++t) threads.emplace_back([&, t]() {for (auto p : positions[t]) insert(p);});
+        for (auto& th : threads) th.join();
+    };
+
+    bit::concurrent_vector<T> tas(vector_size);
+    std::atomic<std::size_t> first_insertions(0);
+    run([&](std::size_t p) {if (not tas.test_and_set(p)) ++first_insertions;});
+    if (first_insertions != expected.count()) throw std::runtime_error("[bit::concurrent_vector] FAIL (test_and_set)");
+    if (tas.freeze() != expected) throw std::runtime_error("[bit::concurrent_vector] FAIL (test_and_set, content)");
+
+    bit::concurrent_vector<T> cvec(vector_size);
+    run([&](std::size_t p) {cvec.set(p);});
+    for (std::size_t i = 0; i < vector_size; ++i) if (cvec.at(i) != expected.at(i)) throw std::runtime_error("[bit::concurrent_vector] FAIL (at)");
+    if (cvec.fetch_or(0, 0) != expected.vector_data().front()) throw std::runtime_error("[bit::concurrent_vector] FAIL (fetch_or)");
+    cvec.fetch_or(cvec.block_size() - 1, static_cast<T>(~static_cast<T>(0))); // must not set the bits after the end
+    for (std::size_t i = (cvec.block_size() - 1) * 8 * sizeof(T); i < vector_size; ++i) expected.set(i);
+    auto frozen = cvec.freeze();
+    if (frozen != expected) throw std::runtime_error("[bit::concurrent_vector] FAIL (freeze)");
+    if (cvec.size() != 0) throw std::runtime_error("[bit::concurrent_vector] FAIL (size after freeze)");
+    try {
+        cvec.set(0);
+        throw std::logic_error("[bit::concurrent_vector] FAIL (out of range not detected)");
+    } catch (std::out_of_range const&) {}
+}
+
+/*
+ * Parallel construction of a "seen" bitmap, then rank/select over the frozen vector: the blocks are never copied.
+ */
+void check_freeze_without_copy(std::size_t vector_size, std::size_t nthreads)
+{
+    logging_tools::micro_timer timer;
+    bit::concurrent_vector<uint64_t> cvec(vector_size);
+    timer.start();
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937_64 gen(t);
+            for (std::size_t i = 0; i < vector_size / nthreads; ++i) cvec.set(gen() % vector_size);
+        });
+    }
+    for (auto& th : threads) th.join();
+    auto build_time = timer.stop(false);
+
+    auto frozen = cvec.freeze();
+    auto const* blocks = frozen.data();
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, true, false> rs(std::move(frozen));
+    if (rs.data().data() != blocks) throw std::runtime_error("[bit::concurrent_vector] FAIL (rank/select copied the frozen vector)");
+    if (rs.size1() != rs.data().count()) throw std::runtime_error("[bit::concurrent_vector] FAIL (rank/select over the frozen vector)");
+    std::cerr << nthreads << " threads, " << vector_size << " concurrent insertions: " << build_time << " us, " << rs.size1() << " distinct positions\n";
+}
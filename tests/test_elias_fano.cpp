@@ -1,11 +1,16 @@
 #include <cmath>
 #include <random>
+#include <string>
+#include <algorithm>
 #include <vector>
 #include <iostream>
+#include <filesystem>
 
 #include "../include/elias_fano.hpp"
+#include "../include/external_memory_vector.hpp"
 #include "../include/cumulative_iterator.hpp"
 #include "../include/io.hpp"
+#include "../include/logtools.hpp"
 
 std::vector<std::size_t> get_random_sequence(std::mt19937& gen, std::size_t size, std::size_t delta);
 std::vector<std::size_t> get_cumulative_sequence(std::vector<std::size_t> const& sequence);
@@ -16,6 +21,12 @@ void test_const_iterator_random_access(std::mt19937& gen, bit::ef::array const&
 void test_rw(bit::ef::array const& ef_sequence);
 void test_lg_find(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
 void test_lg_find_simple_example();
+void benchmark_sequential_decoding(bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
+void test_next_geq_prev_leq(std::mt19937& gen, std::vector<std::size_t> const& cumulative_sequence);
+void test_decode(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
+void benchmark_successor_queries(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
+void test_builder(bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
+void test_builder_from_external_memory(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence);
 
 int main()
 {
@@ -35,6 +46,19 @@ int main()
     test_const_iterator_random_access(gen, efseq, cseq);
     test_lg_find(gen, efseq, cseq);
     test_lg_find_simple_example();
+    test_decode(gen, efseq, cseq);
+    test_builder(efseq, cseq);
+    test_builder_from_external_memory(gen, efseq, cseq);
+    benchmark_sequential_decoding(efseq, cseq);
+    {
+        auto dense_seq = get_random_sequence(gen, vector_size, 2);
+        auto dense_cseq = get_cumulative_sequence(dense_seq);
+        benchmark_sequential_decoding(get_ef_sequence(dense_seq, dense_cseq), dense_cseq); // narrow low parts
+    }
+    test_next_geq_prev_leq(gen, cseq);
+    test_next_geq_prev_leq(gen, get_cumulative_sequence(get_random_sequence(gen, vector_size, 2))); // dense buckets with duplicates
+    test_next_geq_prev_leq(gen, {0, 0, 0, 5, 5, 9});
+    benchmark_successor_queries(gen, efseq, cseq);
 
     std::cerr << "Everything is OK\n";
     return 0;
@@ -241,4 +265,158 @@ void test_lg_find_simple_example()
     assert(idx == 2);
 
     std::cerr << "Simple lt and gt check OK\n";
-}
\ No newline at end of file
+}
+void test_decode(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence)
+{
+    std::vector<uint64_t> buffer(ef_sequence.size());
+    ef_sequence.decode(0, ef_sequence.size(), buffer.data());
+    if (not std::equal(buffer.begin(), buffer.end(), cumulative_sequence.begin())) throw std::runtime_error("[decode] FAIL (full sequence)");
+    std::uniform_int_distribution<std::size_t> distrib(0, ef_sequence.size());
+    for (std::size_t dummy = 0; dummy < 1000; ++dummy) {
+        std::size_t from = distrib(gen);
+        std::size_t count = std::min(ef_sequence.size() - from, distrib(gen) % 3000);
+        ef_sequence.decode(from, count, buffer.data());
+        for (std::size_t i = 0; i < count; ++i) if (buffer[i] != cumulative_sequence[from + i]) throw std::runtime_error("[decode] FAIL (range)");
+    }
+    for (std::vector<std::size_t> small : {std::vector<std::size_t>{0, 0, 0}, std::vector<std::size_t>{3, 3, 1000000}, std::vector<std::size_t>{5}}) {
+        bit::ef::array small_ef(small.begin(), small.end());
+        small_ef.decode(0, small.size(), buffer.data());
+        if (not std::equal(small.begin(), small.end(), buffer.begin())) throw std::runtime_error("[decode] FAIL (small sequence)");
+    }
+    try {
+        ef_sequence.decode(ef_sequence.size() - 1, 2, buffer.data());
+        throw std::logic_error("[decode] FAIL (out of range not detected)");
+    } catch (std::out_of_range const&) {}
+    std::cerr << "decode OK\n";
+}
+
+void benchmark_sequential_decoding(bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence)
+{
+    logging_tools::micro_timer timer;
+    volatile std::size_t dummy = 0;
+    std::size_t sum = 0, expected = 0;
+    for (auto v : cumulative_sequence) expected += v;
+
+    timer.start();
+    for (std::size_t i = 0; i < ef_sequence.size(); ++i) sum += ef_sequence.at(i);
+    auto at_time = timer.stop(false);
+    if (sum != expected) throw std::runtime_error("[at] FAIL (sum)");
+
+    sum = 0;
+    timer.start();
+    for (auto itr = ef_sequence.cbegin(); itr != ef_sequence.cend(); ++itr) sum += *itr;
+    auto iterator_time = timer.stop(false);
+    if (sum != expected) throw std::runtime_error("[iterator] FAIL (sum)");
+
+    sum = 0;
+    std::vector<uint64_t> buffer(ef_sequence.size());
+    timer.start();
+    ef_sequence.decode(0, ef_sequence.size(), buffer.data());
+    auto decode_time = timer.stop(false);
+    for (auto v : buffer) sum += v;
+    if (sum != expected) throw std::runtime_error("[decode] FAIL (sum)");
+    dummy = dummy + sum;
+    timer.start();
+    for (std::size_t i = 0; i < buffer.size(); ++i) buffer[i] = cumulative_sequence[i] + i; // memory bandwidth reference
+    auto add_time = timer.stop(false);
+    dummy = dummy + buffer.back();
+    std::cerr << "sequential decoding of " << ef_sequence.size() << " values: at() " << at_time << " us, const_iterator " << iterator_time << " us, decode " << decode_time << " us";
+    if (decode_time) std::cerr << " (" << static_cast<double>(ef_sequence.size()) / (1000.0 * decode_time) << " elements/ns)";
+    std::cerr << ", plain add loop " << add_time << " us\n";
+}
+
+void test_next_geq_prev_leq(std::mt19937& gen, std::vector<std::size_t> const& cumulative_sequence)
+{
+    bit::ef::array ef_sequence(cumulative_sequence.begin(), cumulative_sequence.end());
+    auto check = [&](std::size_t x) {
+        auto geq = std::lower_bound(cumulative_sequence.begin(), cumulative_sequence.end(), x) - cumulative_sequence.begin();
+        auto [geq_idx, geq_val] = ef_sequence.next_geq(x);
+        if (geq_idx != static_cast<std::size_t>(geq)) throw std::runtime_error("[next_geq] FAIL (index of " + std::to_string(x) + ")");
+        if (geq_idx < cumulative_sequence.size() and geq_val != cumulative_sequence[geq_idx]) throw std::runtime_error("[next_geq] FAIL (value)");
+        std::size_t leq = std::upper_bound(cumulative_sequence.begin(), cumulative_sequence.end(), x) - cumulative_sequence.begin() - 1;
+        auto [leq_idx, leq_val] = ef_sequence.prev_leq(x);
+        if (leq_idx != leq) throw std::runtime_error("[prev_leq] FAIL (index of " + std::to_string(x) + ")");
+        if (leq != std::size_t(-1) and leq_val != cumulative_sequence[leq]) throw std::runtime_error("[prev_leq] FAIL (value)");
+        if (ef_sequence.lt_find(x) != static_cast<std::size_t>(geq - 1)) throw std::runtime_error("[lt_find] FAIL");
+        if (ef_sequence.gt_find(x) != leq + 1) throw std::runtime_error("[gt_find] FAIL");
+    };
+    for (auto v : cumulative_sequence) {
+        check(v);
+        check(v + 1);
+        if (v) check(v - 1);
+    }
+    std::uniform_int_distribution<std::size_t> distrib(0, cumulative_sequence.back() + 10);
+    for (std::size_t i = 0; i < 100000; ++i) check(distrib(gen));
+    std::cerr << "next_geq and prev_leq OK\n";
+}
+
+void benchmark_successor_queries(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence)
+{
+    const std::size_t nqueries = 1000000;
+    std::uniform_int_distribution<std::size_t> distrib(0, cumulative_sequence.back());
+    std::vector<std::size_t> queries;
+    for (std::size_t i = 0; i < nqueries; ++i) queries.push_back(distrib(gen));
+    logging_tools::micro_timer timer;
+    volatile std::size_t dummy = 0;
+    timer.start();
+    for (auto x : queries) dummy = dummy + ef_sequence.next_geq(x).second;
+    auto geq_time = timer.stop(false);
+    timer.start();
+    for (auto x : queries) dummy = dummy + ef_sequence.gt_find(x);
+    auto gt_time = timer.stop(false);
+    timer.start();
+    for (auto x : queries) dummy = dummy + *std::lower_bound(cumulative_sequence.begin(), cumulative_sequence.end(), x);
+    auto std_time = timer.stop(false);
+    std::cerr << nqueries << " successor queries: next_geq " << geq_time << " us, gt_find " << gt_time << " us, std::lower_bound on std::vector " << std_time << " us\n";
+}
+
+void test_builder(bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence)
+{
+    const std::size_t n = cumulative_sequence.size();
+    const std::size_t u = cumulative_sequence.back();
+    bit::ef::array::builder exact(n, u);
+    for (auto v : cumulative_sequence) exact.push_back(v);
+    if (exact.size() != n) throw std::runtime_error("[builder] FAIL (size)");
+    if (exact.finish() != ef_sequence) throw std::runtime_error("[builder] FAIL (exact n and u)");
+    if (exact.size() != 0) throw std::runtime_error("[builder] FAIL (not empty after finish)");
+
+    std::vector<uint64_t> buffer(n);
+    for (auto [en, eu] : {std::make_pair(10 * n, 10 * u), std::make_pair(n / 10, u / 10), std::make_pair(std::size_t(0), std::size_t(0))}) { // estimates
+        bit::ef::array::builder b(en, eu);
+        b.append(cumulative_sequence.begin(), cumulative_sequence.end());
+        auto ef = b.finish();
+        if (ef.size() != n) throw std::runtime_error("[builder] FAIL (size with estimates)");
+        ef.decode(0, n, buffer.data());
+        if (not std::equal(buffer.begin(), buffer.end(), cumulative_sequence.begin())) throw std::runtime_error("[builder] FAIL (values with estimates)");
+        for (std::size_t i = 0; i < n; i += 997) {
+            auto v = cumulative_sequence[i];
+            if (ef.gt_find(v) != ef_sequence.gt_find(v) or ef.lt_find(v) != ef_sequence.lt_find(v)) throw std::runtime_error("[builder] FAIL (queries with estimates)");
+        }
+        if (ef.gt_find(u + 1) != n or ef.lt_find(u + 1) != n - 1) throw std::runtime_error("[builder] FAIL (queries past the end)");
+    }
+
+    bit::ef::array::builder b(0, 1000);
+    if (b.finish() != bit::ef::array(cumulative_sequence.begin(), std::size_t(0), std::size_t(1000))) throw std::runtime_error("[builder] FAIL (empty)");
+    b.push_back(5);
+    try {
+        b.push_back(4);
+        throw std::logic_error("[builder] FAIL (unsorted sequence not detected)");
+    } catch (std::runtime_error const&) {}
+    std::cerr << "builder OK\n";
+}
+
+/*
+ * Values pushed in random order into a sorted external memory vector with a small buffer (many sorted runs on disk),
+ * then encoded straight from its merge.
+ */
+void test_builder_from_external_memory(std::mt19937& gen, bit::ef::array const& ef_sequence, std::vector<std::size_t> const& cumulative_sequence)
+{
+    auto shuffled = cumulative_sequence;
+    std::shuffle(shuffled.begin(), shuffled.end(), gen);
+    emem::external_memory_vector<uint64_t> emv(1 << 20, std::filesystem::temp_directory_path().string(), "ef_builder_test");
+    for (auto v : shuffled) emv.push_back(v);
+    bit::ef::array::builder b(emv.size(), cumulative_sequence.back());
+    b.append(emv.cbegin(), emv.cend());
+    if (b.finish() != ef_sequence) throw std::runtime_error("[builder] FAIL (external memory vector)");
+    std::cerr << "builder from external memory vector OK\n";
+}
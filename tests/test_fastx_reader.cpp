@@ -0,0 +1,233 @@
+/**
+ * memory-mapped FASTA/FASTQ reader test (comparison with kseq)
+ */
+
+#include <zlib.h>
+extern "C" {
+    #include "kseq.h"
+}
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <argparse/argparse.hpp>
+#include "../include/fastx_reader.hpp"
+#include "../include/fastx_scheduler.hpp"
+#include "../include/kmer_view.hpp"
+#include "../include/logtools.hpp"
+
+KSEQ_INIT(gzFile, gzread)
+
+struct owned_record {
+    std::string name, comment, sequence, quality;
+    bool operator==(owned_record const& other) const {
+        return name == other.name and comment == other.comment and sequence == other.sequence and quality == other.quality;
+    }
+};
+
+std::vector<owned_record> read_kseq(std::string const& filename)
+{
+    std::vector<owned_record> res;
+    gzFile fp;
+    if ((fp = gzopen(filename.c_str(), "r")) == NULL) throw std::runtime_error("Unable to open the input file " + filename + "\n");
+    kseq_t* seq = kseq_init(fp);
+    while (kseq_read(seq) >= 0) {
+        res.push_back({
+            std::string(seq->name.s, seq->name.l),
+            std::string(seq->comment.s ? seq->comment.s : "", seq->comment.l),
+            std::string(seq->seq.s, seq->seq.l),
+            std::string(seq->qual.s ? seq->qual.s : "", seq->qual.l)
+        });
+    }
+    kseq_destroy(seq);
+    gzclose(fp);
+    return res;
+}
+
+std::vector<owned_record> read_mapped(std::string const& filename)
+{
+    std::vector<owned_record> res;
+    io::fastx::mapped_reader reader(filename);
+    io::fastx::record_t rec;
+    while (reader.next(rec)) res.push_back({std::string(rec.name), std::string(rec.comment), std::string(rec.sequence), std::string(rec.quality)});
+    return res;
+}
+
+/*
+ * Records of all the batches, sorted by position in the file.
+ */
+std::vector<owned_record> read_scheduled(std::string const& filename, std::size_t nthreads, std::size_t chunk_bytes)
+{
+    io::fastx::chunk_scheduler scheduler(filename, nthreads, chunk_bytes, 3);
+    std::vector<std::vector<std::pair<std::size_t, owned_record>>> per_thread(scheduler.get_nthreads());
+    scheduler.run([&](std::size_t tid, io::fastx::batch_t const& batch) {
+        for (std::size_t i = 0; i < batch.records.size(); ++i) {
+            auto const& rec = batch.records[i];
+            per_thread.at(tid).push_back({
+                batch.index * (1ULL << 32) + i,
+                {std::string(rec.name), std::string(rec.comment), std::string(rec.sequence), std::string(rec.quality)}
+            });
+        }
+    });
+    std::vector<std::pair<std::size_t, owned_record>> all;
+    for (auto& v : per_thread) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end(), [](auto const& a, auto const& b) {return a.first < b.first;});
+    std::vector<owned_record> res;
+    for (auto& r : all) res.push_back(std::move(r.second));
+    return res;
+}
+
+void write_file(std::string const& filename, std::string const& content)
+{
+    std::ofstream out(filename, std::ios::binary);
+    out << content;
+}
+
+void check_against_kseq(std::string const& filename, std::string const& name)
+{
+    if (read_kseq(filename) != read_mapped(filename)) throw std::runtime_error("[fastx reader] FAIL (" + name + ")");
+}
+
+int main(int argc, char* argv[])
+{
+    argparse::ArgumentParser parser(argv[0]);
+    parser.add_argument("-i", "--input")
+        .help("input fasta file (possibly gzipped)")
+        .required();
+    parser.add_argument("-d", "--tmp-dir")
+        .help("temporary directory")
+        .default_value(std::string("."));
+    parser.parse_args(argc, argv);
+    std::string input_filename = parser.get<std::string>("--input");
+    std::string tmp_dir = parser.get<std::string>("--tmp-dir");
+
+    const std::string single_line = tmp_dir + "/tmp.fastx_single.fa";
+    const std::string multi_line = tmp_dir + "/tmp.fastx_multi.fa";
+    const std::string fastq = tmp_dir + "/tmp.fastx.fq";
+    const std::string edge = tmp_dir + "/tmp.fastx_edge.txt";
+
+    { // re-format the input in single-line FASTA, 60-column FASTA and FASTQ
+        auto records = read_kseq(input_filename);
+        std::ofstream sout(single_line), mout(multi_line), qout(fastq);
+        for (auto const& r : records) {
+            std::string header = r.name + (r.comment.empty() ? "" : " " + r.comment);
+            sout << ">" << header << "\n" << r.sequence << "\n";
+            mout << ">" << header << "\n";
+            for (std::size_t i = 0; i < r.sequence.size(); i += 60) mout << r.sequence.substr(i, 60) << "\n";
+            qout << "@" << header << "\n" << r.sequence << "\n+\n" << std::string(r.sequence.size(), '@') << "\n";
+        }
+    }
+    check_against_kseq(single_line, "single-line FASTA");
+    check_against_kseq(multi_line, "multi-line FASTA");
+    check_against_kseq(fastq, "FASTQ");
+    if (read_mapped(single_line) != read_mapped(multi_line)) throw std::runtime_error("[fastx reader] FAIL (single vs multi-line)");
+
+    for (auto const& filename : {single_line, multi_line, fastq}) {
+        auto expected = read_mapped(filename);
+        for (std::size_t chunk_bytes : {std::size_t(1), std::size_t(100), std::size_t(5000), std::size_t(1) << 30}) {
+            if (read_scheduled(filename, 4, chunk_bytes) != expected) throw std::runtime_error("[fastx scheduler] FAIL (" + filename + ", chunks of " + std::to_string(chunk_bytes) + " bytes)");
+        }
+    }
+    { // quality lines starting with '@' must not be taken for record starts
+        std::string content;
+        for (std::size_t i = 0; i < 500; ++i) content += "@r" + std::to_string(i) + "\nACGT\n+\n" + (i % 2 ? "@@II" : "II@I") + "\n";
+        write_file(edge, content);
+        if (read_scheduled(edge, 3, 64) != read_kseq(edge)) throw std::runtime_error("[fastx scheduler] FAIL (qualities starting with @)");
+    }
+    write_file(edge, "");
+    if (not read_scheduled(edge, 2, 10).empty()) throw std::runtime_error("[fastx scheduler] FAIL (empty file)");
+    try { // exceptions thrown by the workers reach the caller
+        io::fastx::chunk_scheduler scheduler(single_line, 2, 100);
+        scheduler.run([](std::size_t, io::fastx::batch_t const&) {throw std::logic_error("worker error");});
+        throw std::runtime_error("[fastx scheduler] FAIL (exception not propagated)");
+    } catch (std::logic_error const&) {}
+
+    // corner cases
+    write_file(edge, "");
+    check_against_kseq(edge, "empty file");
+    write_file(edge, ">a first comment\nACGT\nAC\n\nGT\n>b\n>c\tcomment\nTTTT");
+    check_against_kseq(edge, "blank lines, empty sequence and no final newline");
+    write_file(edge, "garbage\n>a\nACGT\n@q x\nAC\nGT\n+q x\nI@\nII\n>z\nN\n");
+    check_against_kseq(edge, "mixed FASTA/FASTQ");
+    write_file(edge, ">a x\r\nAC\r\nGT\r\n>b\r\nTT\r\n");
+    {
+        auto records = read_mapped(edge);
+        if (records.size() != 2 or records[0].name != "a" or records[0].comment != "x" or records[0].sequence != "ACGT" or records[1].sequence != "TT") {
+            throw std::runtime_error("[fastx reader] FAIL (CRLF)");
+        }
+    }
+    write_file(edge, "@a\nACGT\n+\nII\n");
+    try {
+        read_mapped(edge);
+        throw std::runtime_error("[fastx reader] FAIL (truncated quality not detected)");
+    } catch (std::runtime_error const& e) {
+        if (std::string(e.what()).find("different length") == std::string::npos) throw;
+    }
+
+    { // single-line records are views of the mapped file
+        io::fastx::mapped_reader reader(single_line);
+        io::fastx::record_t rec;
+        std::ifstream in(single_line);
+        std::string first_line;
+        std::getline(in, first_line);
+        if (reader.next(rec) and rec.sequence.data() != rec.name.data() + first_line.size()) throw std::runtime_error("[fastx reader] FAIL (copy of single-line record)");
+    }
+
+    // throughput: both readers touch every base
+    volatile std::size_t dummy = 0;
+    logging_tools::micro_timer timer;
+    for (auto const& filename : {single_line, multi_line}) {
+        std::size_t kseq_bases = 0, mapped_bases = 0;
+        timer.start();
+        {
+            gzFile fp = gzopen(filename.c_str(), "r");
+            kseq_t* seq = kseq_init(fp);
+            while (kseq_read(seq) >= 0) for (std::size_t i = 0; i < seq->seq.l; ++i) kseq_bases += (seq->seq.s[i] != 'N');
+            kseq_destroy(seq);
+            gzclose(fp);
+        }
+        auto kseq_time = timer.stop(false);
+        timer.start();
+        {
+            io::fastx::mapped_reader reader(filename);
+            io::fastx::record_t rec;
+            while (reader.next(rec)) for (char c : rec.sequence) mapped_bases += (c != 'N');
+        }
+        auto mapped_time = timer.stop(false);
+        if (kseq_bases != mapped_bases) throw std::runtime_error("[fastx reader] FAIL (number of bases)");
+        dummy = dummy + mapped_bases;
+        std::cerr << filename << ": kseq " << kseq_time << " us, mapped reader " << mapped_time << " us\n";
+    }
+
+    { // k-mers counted on the worker threads
+        std::size_t sequential_kmers = 0;
+        std::atomic<std::size_t> parallel_kmers(0);
+        timer.start();
+        io::fastx::mapped_reader reader(multi_line);
+        io::fastx::record_t rec;
+        while (reader.next(rec)) {
+            auto view = wrapper::kmer_view_from_cstr<uint64_t>(rec.sequence.data(), rec.sequence.size(), 31, true);
+            for (auto itr = view.cbegin(); itr != view.cend(); ++itr) sequential_kmers += bool((*itr).value);
+        }
+        auto sequential_time = timer.stop(false);
+        timer.start();
+        io::fastx::chunk_scheduler scheduler(multi_line, 4, 1 << 16);
+        scheduler.run([&](std::size_t, io::fastx::batch_t const& batch) {
+            std::size_t count = 0;
+            for (auto const& r : batch.records) {
+                auto view = wrapper::kmer_view_from_cstr<uint64_t>(r.sequence.data(), r.sequence.size(), 31, true);
+                for (auto itr = view.cbegin(); itr != view.cend(); ++itr) count += bool((*itr).value);
+            }
+            parallel_kmers += count;
+        });
+        auto parallel_time = timer.stop(false);
+        if (sequential_kmers != parallel_kmers) throw std::runtime_error("[fastx scheduler] FAIL (number of k-mers)");
+        std::cerr << "k-mers: sequential " << sequential_time << " us, scheduler (4 threads) " << parallel_time << " us\n";
+    }
+
+    for (auto const& filename : {single_line, multi_line, fastq, edge}) std::remove(filename.c_str());
+    std::cerr << "Finish\n";
+    return 0;
+}
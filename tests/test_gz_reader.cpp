@@ -0,0 +1,193 @@
+/**
+ * threaded gzip/BGZF reader test (comparison with gzread)
+ */
+
+#include <zlib.h>
+extern "C" {
+    #include "kseq.h"
+}
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <argparse/argparse.hpp>
+#include "../include/gz_reader.hpp"
+#include "../include/logtools.hpp"
+
+KSEQ_INIT(gzFile, gzread)
+
+namespace threaded {
+KSEQ_INIT(io::gz::threaded_reader*, io::gz::read)
+}
+
+std::string read_all_gz(std::string const& filename)
+{
+    std::string res;
+    gzFile fp = gzopen(filename.c_str(), "rb");
+    if (not fp) throw std::runtime_error("Unable to open " + filename);
+    char buffer[1 << 16];
+    int n;
+    while ((n = gzread(fp, buffer, sizeof(buffer))) > 0) res.append(buffer, n);
+    gzclose(fp);
+    return res;
+}
+
+std::string read_all_threaded(std::string const& filename, std::size_t nthreads, std::size_t buffer_size, unsigned read_size)
+{
+    std::string res;
+    io::gz::threaded_reader reader(filename, nthreads, buffer_size);
+    std::vector<char> buffer(read_size);
+    int n;
+    while ((n = reader.read(buffer.data(), read_size)) > 0) res.append(buffer.data(), n);
+    return res;
+}
+
+/*
+ * Minimal bgzip: independent raw deflate blocks of at most 65280 bytes with the BC extra field,
+ * followed by the empty end-of-file block.
+ */
+void write_bgzf(std::string const& filename, std::string const& content)
+{
+    std::ofstream out(filename, std::ios::binary);
+    auto put16 = [&](uint16_t v) {out.put(v & 0xff); out.put(v >> 8);};
+    auto put32 = [&](uint32_t v) {put16(v & 0xffff); put16(v >> 16);};
+    auto write_block = [&](char const* data, std::size_t len) {
+        std::vector<uint8_t> cdata(compressBound(len) + 64);
+        z_stream strm;
+        std::memset(&strm, 0, sizeof(strm));
+        deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        strm.avail_in = len;
+        strm.next_out = cdata.data();
+        strm.avail_out = cdata.size();
+        if (deflate(&strm, Z_FINISH) != Z_STREAM_END) throw std::runtime_error("deflate failed");
+        std::size_t clen = strm.total_out;
+        deflateEnd(&strm);
+        const uint8_t header[] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0};
+        out.write(reinterpret_cast<char const*>(header), sizeof(header));
+        put16(static_cast<uint16_t>(clen + 25));
+        out.write(reinterpret_cast<char const*>(cdata.data()), clen);
+        put32(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<Bytef const*>(data), len));
+        put32(len);
+    };
+    for (std::size_t i = 0; i < content.size(); i += 65280) write_block(content.data() + i, std::min(std::size_t(65280), content.size() - i));
+    write_block(nullptr, 0);
+}
+
+void write_gzip(std::string const& filename, std::string const& content)
+{
+    gzFile fp = gzopen(filename.c_str(), "wb");
+    if (content.size()) gzwrite(fp, content.data(), content.size());
+    gzclose(fp);
+}
+
+void check(std::string const& filename, std::string const& expected, bool bgzf, std::string const& name)
+{
+    {
+        io::gz::threaded_reader reader(filename, 2);
+        if (reader.is_bgzf() != bgzf) throw std::runtime_error("[gz reader] FAIL (" + name + ", format detection)");
+    }
+    for (std::size_t nthreads : {1, 4}) {
+        for (std::size_t buffer_size : {std::size_t(1000), std::size_t(1) << 20}) {
+            for (unsigned read_size : {777u, 1u << 16}) {
+                if (read_all_threaded(filename, nthreads, buffer_size, read_size) != expected) {
+                    throw std::runtime_error("[gz reader] FAIL (" + name + ", " + std::to_string(nthreads) + " threads, buffers of " + std::to_string(buffer_size) + " bytes, reads of " + std::to_string(read_size) + " bytes)");
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    argparse::ArgumentParser parser(argv[0]);
+    parser.add_argument("-i", "--input")
+        .help("input fasta file (possibly gzipped)")
+        .required();
+    parser.add_argument("-d", "--tmp-dir")
+        .help("temporary directory")
+        .default_value(std::string("."));
+    parser.parse_args(argc, argv);
+    std::string input_filename = parser.get<std::string>("--input");
+    std::string tmp_dir = parser.get<std::string>("--tmp-dir");
+
+    const std::string gzip_file = tmp_dir + "/tmp.gz_reader.fa.gz";
+    const std::string bgzf_file = tmp_dir + "/tmp.gz_reader.fa.bgz";
+    const std::string plain_file = tmp_dir + "/tmp.gz_reader.fa";
+
+    std::string content = read_all_gz(input_filename);
+    {
+        std::mt19937_64 gen(42);
+        std::string random_seq(3 << 20, 'A');
+        for (auto& c : random_seq) c = "ACGT"[gen() % 4];
+        content += ">random\n" + random_seq + "\n";
+    }
+    write_gzip(gzip_file, content);
+    write_bgzf(bgzf_file, content);
+    std::ofstream(plain_file, std::ios::binary) << content;
+    check(gzip_file, content, false, "gzip");
+    check(bgzf_file, content, true, "BGZF");
+    check(plain_file, content, false, "uncompressed");
+    { // tiny buffers and reads
+        auto prefix = content.substr(0, 200000);
+        write_gzip(gzip_file, prefix);
+        write_bgzf(bgzf_file, prefix);
+        for (auto const& filename : {gzip_file, bgzf_file}) {
+            if (read_all_threaded(filename, 3, 1, 1) != prefix) throw std::runtime_error("[gz reader] FAIL (" + filename + ", 1-byte buffers)");
+        }
+    }
+    write_bgzf(bgzf_file, "");
+    check(bgzf_file, "", true, "empty BGZF");
+    write_gzip(gzip_file, "");
+    check(gzip_file, "", false, "empty gzip");
+
+    write_bgzf(bgzf_file, content);
+    { // corrupted block: the error reaches the consumer
+        std::fstream f(bgzf_file, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(100000);
+        f.put('x');
+        f.put('y');
+    }
+    try {
+        read_all_threaded(bgzf_file, 4, 1 << 16, 1 << 16);
+        throw std::logic_error("[gz reader] FAIL (corruption not detected)");
+    } catch (std::runtime_error const&) {}
+    { // early destruction with the pipeline still full
+        io::gz::threaded_reader reader(bgzf_file, 4, 1000);
+        char c;
+        reader.read(&c, 1);
+    }
+
+    // kseq on top of the threaded reader, timed against gzread
+    write_bgzf(bgzf_file, content);
+    write_gzip(gzip_file, content);
+    logging_tools::micro_timer timer;
+    for (auto const& filename : {gzip_file, bgzf_file}) {
+        std::size_t expected_bases = 0, bases = 0;
+        timer.start();
+        {
+            gzFile fp = gzopen(filename.c_str(), "r");
+            kseq_t* seq = kseq_init(fp);
+            while (kseq_read(seq) >= 0) expected_bases += seq->seq.l;
+            kseq_destroy(seq);
+            gzclose(fp);
+        }
+        auto gzread_time = timer.stop(false);
+        timer.start();
+        {
+            io::gz::threaded_reader reader(filename, 4);
+            threaded::kseq_t* seq = threaded::kseq_init(&reader);
+            while (threaded::kseq_read(seq) >= 0) bases += seq->seq.l;
+            threaded::kseq_destroy(seq);
+        }
+        auto threaded_time = timer.stop(false);
+        if (bases != expected_bases) throw std::runtime_error("[gz reader] FAIL (kseq)");
+        std::cerr << filename << ": gzread " << gzread_time << " us, threaded reader " << threaded_time << " us\n";
+    }
+
+    for (auto const& filename : {gzip_file, bgzf_file, plain_file}) std::remove(filename.c_str());
+    std::cerr << "Finish\n";
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Hash functions test
+ */
+
+#include <random>
+#include <vector>
+#include <iostream>
+#include <unordered_set>
+#include "../include/hash.hpp"
+#include "../include/logtools.hpp"
+
+template <class HashFunction>
+std::size_t throughput(std::vector<uint64_t> const& keys, uint64_t seed, std::size_t rounds)
+{
+    volatile uint64_t dummy = 0;
+    HashFunction hasher;
+    logging_tools::micro_timer timer;
+    timer.start();
+    for (std::size_t r = 0; r < rounds; ++r) {
+        uint64_t acc = 0;
+        for (auto key : keys) acc ^= hasher(key, seed + r);
+        dummy = dummy + acc;
+    }
+    return timer.stop(false);
+}
+
+template <class HashFunction>
+std::size_t batch_throughput(std::vector<uint64_t> const& keys, uint64_t seed, std::size_t rounds)
+{
+    volatile uint64_t dummy = 0;
+    std::vector<uint64_t> out(keys.size());
+    logging_tools::micro_timer timer;
+    timer.start();
+    for (std::size_t r = 0; r < rounds; ++r) {
+        HashFunction::hash_batch(keys.data(), out.data(), keys.size(), seed + r);
+        dummy = dummy + out[r];
+    }
+    return timer.stop(false);
+}
+
+void check_kernel(hash::detail::batch_kernel_t kernel, hash::detail::batch_kernel_t reference, std::vector<uint64_t> const& keys, std::size_t width, std::string const& name)
+{
+    for (std::size_t n : {std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(8), std::size_t(9), std::size_t(31), std::size_t(1000)}) {
+        std::vector<uint64_t> expected(width * n), out(width * n);
+        reference(keys.data(), expected.data(), n, 42);
+        kernel(keys.data(), out.data(), n, 42);
+        if (expected != out) throw std::runtime_error("[hash_batch] FAIL (" + name + " kernel, n = " + std::to_string(n) + ")");
+    }
+}
+
+int main()
+{
+    const std::size_t n = 1000000;
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> keys(n);
+    for (auto& key : keys) key = gen();
+    keys[0] = 0;
+    keys[1] = ~uint64_t(0);
+
+    for (uint64_t z : keys) if (hash::unremix(hash::remix(z)) != z) throw std::runtime_error("[unremix] FAIL");
+
+    for (uint64_t seed : {uint64_t(0), uint64_t(1), uint64_t(42), ~uint64_t(0)}) {
+        std::unordered_set<uint64_t> hashes;
+        for (uint64_t key : keys) {
+            auto h = hash::invertible_hash64::hash(key, seed);
+            if (hash::invertible_hash64::invert(h, seed) != key) throw std::runtime_error("[invertible_hash64] FAIL (inversion)");
+            hashes.insert(h);
+        }
+        if (hashes.size() != n) throw std::runtime_error("[invertible_hash64] FAIL (collisions)");
+    }
+    if (hash::invertible_hash64::hash(uint64_t(0), 0) == 0) throw std::runtime_error("[invertible_hash64] FAIL (seed 0 is the identity)");
+    if (hash::invertible_hash64::hash(uint32_t(12345), 7) != hash::invertible_hash64::hash(uint64_t(12345), 7)) throw std::runtime_error("[invertible_hash64] FAIL (key width)");
+
+    { // avalanche: flipping one input bit should flip about half of the output bits
+        std::size_t flipped = 0, trials = 0;
+        for (std::size_t i = 0; i < 10000; ++i) {
+            for (std::size_t b = 0; b < 64; ++b) {
+                auto h1 = hash::invertible_hash64::hash(keys[i], 3);
+                auto h2 = hash::invertible_hash64::hash(keys[i] ^ (uint64_t(1) << b), 3);
+                flipped += __builtin_popcountll(h1 ^ h2);
+                ++trials;
+            }
+        }
+        double avg = static_cast<double>(flipped) / trials;
+        if (avg < 31 or avg > 33) throw std::runtime_error("[invertible_hash64] FAIL (avalanche = " + std::to_string(avg) + ")");
+    }
+
+    { // batch hashing
+        std::vector<uint64_t> out(n);
+        std::vector<std::array<uint64_t, 2>> out2(n);
+        for (uint64_t seed : {uint64_t(0), uint64_t(42), ~uint64_t(0)}) {
+            hash::hash64::hash_batch(keys.data(), out.data(), n, seed);
+            for (std::size_t i = 0; i < n; ++i) if (out[i] != hash::hash64::hash(keys[i], seed)) throw std::runtime_error("[hash64::hash_batch] FAIL");
+            hash::double_hash64::hash_batch(keys.data() + 1, out2.data(), n - 1, seed); // unaligned start
+            for (std::size_t i = 0; i < n - 1; ++i) if (out2[i] != hash::double_hash64::hash(keys[i + 1], seed)) throw std::runtime_error("[double_hash64::hash_batch] FAIL");
+            hash::invertible_hash64::hash_batch(keys.data(), out.data(), n, seed);
+            for (std::size_t i = 0; i < n; ++i) if (out[i] != hash::invertible_hash64::hash(keys[i], seed)) throw std::runtime_error("[invertible_hash64::hash_batch] FAIL");
+        }
+        std::vector<uint32_t> small_keys(keys.begin(), keys.begin() + 1000);
+        hash::hash64::hash_batch(small_keys.data(), out.data(), small_keys.size(), 7);
+        for (std::size_t i = 0; i < small_keys.size(); ++i) if (out[i] != hash::hash64::hash(small_keys[i], 7)) throw std::runtime_error("[hash64::hash_batch] FAIL (32-bit keys)");
+
+#ifdef BIOLIB_X86_DISPATCH
+        using namespace hash::detail;
+        if (cpu::has_avx2()) {
+            check_kernel(murmur_batch_avx2<false>, murmur_batch_scalar<false>, keys, 1, "murmur AVX2");
+            check_kernel(murmur_batch_avx2<true>, murmur_batch_scalar<true>, keys, 2, "double murmur AVX2");
+            check_kernel(remix_batch_avx2, remix_batch_scalar, keys, 1, "remix AVX2");
+        }
+        if (cpu::has_avx512()) {
+            check_kernel(murmur_batch_avx512<false>, murmur_batch_scalar<false>, keys, 1, "murmur AVX-512");
+            check_kernel(murmur_batch_avx512<true>, murmur_batch_scalar<true>, keys, 2, "double murmur AVX-512");
+            check_kernel(remix_batch_avx512, remix_batch_scalar, keys, 1, "remix AVX-512");
+        }
+#endif
+    }
+
+    const std::size_t rounds = 10;
+    auto murmur_time = throughput<hash::hash64>(keys, 42, rounds);
+    auto mixer_time = throughput<hash::invertible_hash64>(keys, 42, rounds);
+    auto murmur_batch_time = batch_throughput<hash::hash64>(keys, 42, rounds);
+    auto mixer_batch_time = batch_throughput<hash::invertible_hash64>(keys, 42, rounds);
+    std::cerr << "hash64 (MurmurHash3): " << murmur_time << " us, invertible_hash64: " << mixer_time << " us for " << n * rounds << " keys\n";
+    std::cerr << "batch hash64: " << murmur_batch_time << " us, batch invertible_hash64: " << mixer_batch_time << " us\n";
+
+    std::cerr << "PASS : hash\n";
+    return 0;
+}
@@ -1,7 +1,13 @@
 #include <iostream>
 #include <numeric>
+#include <random>
+#include <limits>
+#include <filesystem>
 #include "../include/io.hpp"
 #include "../include/logtools.hpp"
+#include "../include/elias_fano.hpp"
+#include "../include/partitioned_elias_fano.hpp"
+#include "../include/rank_select_interleaved.hpp"
 #include "../bundled/prettyprint.hpp"
 
 class test_t
@@ -18,6 +24,9 @@ class test_t
         int value;
 };
 
+bool check_mapped_loading();
+bool check_corrupted_files();
+
 int main()
 {
     test_t source, sink;
@@ -59,5 +68,163 @@ int main()
             return 1; 
         }
     }
+
+    { // aligned format: std::vectors are still copied
+        {
+            std::ofstream ofs("test_io_payload.bin", std::ios::binary);
+            io::aligned_saver saver(ofs); // test_t has no const visit()
+            saver.visit(source.vec);
+            saver.visit(source.str);
+            saver.visit(source.value);
+        }
+        test_t mapped_sink;
+        io::mapped_loader reader("test_io_payload.bin");
+        mapped_sink.visit(reader);
+        std::remove("test_io_payload.bin");
+        if (mapped_sink.vec != source.vec or mapped_sink.str != source.str or mapped_sink.value != source.value) {
+            std::cerr << "Failed (aligned format)" << std::endl;
+            return 1;
+        }
+    }
+    if (not check_mapped_loading()) return 1;
+    if (not check_corrupted_files()) return 1;
+    std::cerr << "PASS (mapped loading)" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
+
+template <typename T, std::size_t A>
+bool is_mapped_and_aligned(memory::map::backed_vector<T, A> const& vec)
+{
+    return vec.is_view() and reinterpret_cast<std::uintptr_t>(vec.data()) % io::alignment == 0;
+}
+
+/*
+ * Succinct structures loaded from a mapping must be equal to the stored ones, point inside the (aligned) mapping
+ * and copy themselves before being modified.
+ */
+bool check_mapped_loading()
+{
+    std::mt19937_64 gen(42);
+    std::vector<std::size_t> sequence;
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < 1000000; ++i) sequence.push_back(sum += gen() % 100);
+    bit::ef::array ef(sequence.begin(), sequence.end());
+    bit::ef::partitioned_array pef(sequence.begin(), sequence.end());
+    bit::vector<uint64_t> bv(1000003);
+    for (std::size_t i = 0; i < bv.size(); i += 1 + gen() % 10) bv.set(i);
+
+    io::store_aligned(ef, "test_io_ef.bin");
+    io::store_aligned(pef, "test_io_pef.bin");
+    io::store_aligned(bv, "test_io_bv.bin");
+    logging_tools::micro_timer timer;
+    timer.start();
+    auto mapped_ef = io::load_mapped<bit::ef::array>("test_io_ef.bin");
+    auto load_time = timer.stop(false);
+    auto mapped_pef = io::load_mapped<bit::ef::partitioned_array>("test_io_pef.bin");
+    auto mapped_bv = io::load_mapped<bit::vector<uint64_t>>("test_io_bv.bin");
+    for (auto name : {"test_io_ef.bin", "test_io_pef.bin", "test_io_bv.bin"}) std::remove(name); // the mappings stay valid
+    std::cerr << "Elias-Fano of " << ef.size() << " elements mapped in " << load_time << " us\n";
+
+    if (mapped_ef != ef or mapped_pef != pef or mapped_bv != bv) {
+        std::cerr << "Failed (mapped structures differ)" << std::endl;
+        return false;
+    }
+    for (std::size_t i = 0; i < sequence.size(); i += 101) {
+        if (mapped_ef.at(i) != sequence[i] or mapped_pef.at(i) != sequence[i]) {
+            std::cerr << "Failed (access to mapped structures)" << std::endl;
+            return false;
+        }
+    }
+    if (not is_mapped_and_aligned(mapped_bv.vector_data())) {
+        std::cerr << "Failed (bit vector not mapped)" << std::endl;
+        return false;
+    }
+    bit::packed::vector<uint64_t> pv(13);
+    for (std::size_t i = 0; i < 1000; ++i) pv.push_back(i * 7);
+    io::store_aligned(pv, "test_io_pv.bin");
+    auto mapped_pv = io::load_mapped<bit::packed::vector<uint64_t>>("test_io_pv.bin");
+    std::remove("test_io_pv.bin");
+    for (std::size_t i = 0; i < pv.size(); ++i) {
+        if (static_cast<uint64_t>(mapped_pv[i]) != i * 7) { // read through the non-const proxy
+            std::cerr << "Failed (packed vector proxy)" << std::endl;
+            return false;
+        }
+    }
+    if (not is_mapped_and_aligned(mapped_pv.vector_data())) {
+        std::cerr << "Failed (reading through the packed vector proxy copied the mapping)" << std::endl;
+        return false;
+    }
+    bit::rs::interleaved_array<true, true> rs(bv);
+    io::store_aligned(rs, "test_io_rs.bin");
+    auto mapped_rs = io::load_mapped<bit::rs::interleaved_array<true, true>>("test_io_rs.bin");
+    std::remove("test_io_rs.bin");
+    if (mapped_rs != rs or mapped_rs.rank1(bv.size()) != rs.rank1(bv.size()) or mapped_rs.select1(rs.size1() / 2) != rs.select1(rs.size1() / 2)) {
+        std::cerr << "Failed (mapped interleaved rank/select)" << std::endl;
+        return false;
+    }
+    if (not is_mapped_and_aligned(mapped_rs.line_data())) {
+        std::cerr << "Failed (interleaved lines not mapped)" << std::endl;
+        return false;
+    }
+    auto copy = mapped_bv;
+    copy.set(1);
+    copy.clear(0);
+    if (not is_mapped_and_aligned(mapped_bv.vector_data()) or copy.vector_data().is_view() or mapped_bv != bv or copy.at(0)) {
+        std::cerr << "Failed (copy on write)" << std::endl;
+        return false;
+    }
+    return true;
+}
+/*
+ * Overwrites the first length of the file (the number of words of a bit::vector, or of elements of a std::vector).
+ */
+void corrupt_length(std::string const& filename, std::size_t length)
+{
+    std::fstream fs(filename, std::ios::binary | std::ios::in | std::ios::out);
+    fs.write(reinterpret_cast<char const*>(&length), sizeof(length));
+}
+
+/*
+ * Truncated files and huge lengths (whose size in bytes overflows) must be rejected before mapping or allocating anything.
+ */
+bool check_corrupted_files()
+{
+    const std::string filename = "test_io_corrupted.bin";
+    auto rejected = [&](auto load) {
+        try {
+            load();
+        } catch (std::runtime_error const&) {
+            return true;
+        }
+        return false;
+    };
+    auto load_bit_vector = [&]() {io::load_mapped<bit::vector<uint64_t>>(filename);};
+    auto load_std_vector = [&]() {
+        std::vector<uint32_t> vec;
+        io::mapped_loader reader(filename);
+        reader.visit(vec);
+    };
+    bool ok = true;
+
+    bit::vector<uint64_t> bv(100);
+    bv.set(42);
+    io::store_aligned(bv, filename);
+    for (std::size_t length : {std::size_t(1) << 61 | 2, std::size_t(3), std::numeric_limits<std::size_t>::max()}) {
+        io::store_aligned(bv, filename);
+        corrupt_length(filename, length);
+        ok = ok and rejected(load_bit_vector);
+    }
+    io::store_aligned(bv, filename);
+    std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 1); // bsize cut
+    ok = ok and rejected(load_bit_vector);
+
+    std::vector<uint32_t> vec(10, 7);
+    for (std::size_t length : {std::size_t(1) << 62 | 1, std::size_t(11), std::numeric_limits<std::size_t>::max()}) {
+        io::store_aligned(vec, filename);
+        corrupt_length(filename, length);
+        ok = ok and rejected(load_std_vector);
+    }
+    std::remove(filename.c_str());
+    if (not ok) std::cerr << "Failed (corrupted file accepted)" << std::endl;
+    return ok;
+}
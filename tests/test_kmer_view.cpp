@@ -8,12 +8,15 @@ extern "C" {
 }
 
 #include <string>
+#include <vector>
 #include <argparse/argparse.hpp>
 #include "../include/kmer_view.hpp"
+#include "../include/wide_kmer.hpp"
 
 KSEQ_INIT(gzFile, gzread)
 
 typedef uint64_t kmer_t;
+typedef kmer::wide<2> wide_kmer_t;
 
 int main(int argc, char* argv[])
 {
@@ -31,13 +34,56 @@ int main(int argc, char* argv[])
     seq = kseq_init(fp);
 
     volatile kmer_t dummy;
+    std::vector<kmer_t> kmers;
+    std::vector<uint32_t> positions;
 
     while (kseq_read(seq) >= 0) {
         auto view = wrapper::kmer_view_from_cstr<kmer_t>(seq->seq.s, seq->seq.l, 15, true);
+        kmers.resize(seq->seq.l);
+        positions.resize(seq->seq.l);
+        auto n = view.extract(kmers.data(), positions.data(), kmers.size());
+        std::size_t i = 0;
         for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
-            if ((*itr).value) dummy = *((*itr).value);
+            if ((*itr).value) {
+                dummy = *((*itr).value);
+                if (i >= n or kmers[i] != *((*itr).value) or positions[i] != (*itr).position) throw std::runtime_error("[extract] FAIL");
+                ++i;
+            }
             dummy = dummy;
         }
+        if (i != n) throw std::runtime_error("[extract] FAIL (count)");
+
+        std::vector<uint64_t> words(packing::packed_size(seq->seq.l)), ref_words(words.size());
+        std::vector<uint64_t> masks(packing::mask_size(seq->seq.l)), ref_masks(masks.size());
+        packing::encode(seq->seq.s, seq->seq.l, words.data(), masks.data());
+        packing::detail::encode_scalar(seq->seq.s, seq->seq.l, ref_words.data(), ref_masks.data());
+        if (words != ref_words or masks != ref_masks) throw std::runtime_error("[packing] FAIL");
+
+        auto packed_view = wrapper::packed_kmer_view_from_cstr<kmer_t>(seq->seq.s, seq->seq.l, 15, true);
+        auto pitr = packed_view.cbegin();
+        for (auto itr = view.cbegin(); itr != view.cend(); ++itr, ++pitr) {
+            if (pitr == packed_view.cend() or (*itr).value != (*pitr).value or (*itr).position != (*pitr).position) throw std::runtime_error("[packed view] FAIL");
+        }
+        if (pitr != packed_view.cend()) throw std::runtime_error("[packed view] FAIL (length)");
+        if (packed_view.extract(kmers.data(), nullptr, kmers.size()) != n) throw std::runtime_error("[packed view] FAIL (extract)");
+
+        auto small_wide_view = wrapper::kmer_view_from_cstr<wide_kmer_t>(seq->seq.s, seq->seq.l, 15, true);
+        std::vector<wide_kmer_t> wide_kmers(seq->seq.l);
+        if (small_wide_view.extract(wide_kmers.data(), nullptr, wide_kmers.size()) != n) throw std::runtime_error("[wide k-mer] FAIL (count)");
+        for (std::size_t j = 0; j < n; ++j) if (wide_kmers[j] != wide_kmer_t(kmers[j])) throw std::runtime_error("[wide k-mer] FAIL (k = 15)");
+
+        const uint8_t wide_k = 63;
+        auto forward_view = wrapper::kmer_view_from_cstr<wide_kmer_t>(seq->seq.s, seq->seq.l, wide_k, false);
+        auto canonical_view = wrapper::kmer_view_from_cstr<wide_kmer_t>(seq->seq.s, seq->seq.l, wide_k, true);
+        auto citr = canonical_view.cbegin();
+        for (auto fitr = forward_view.cbegin(); fitr != forward_view.cend(); ++fitr, ++citr) {
+            if ((*fitr).value) {
+                auto fwd = *((*fitr).value);
+                auto rc = kmer::reverse_complement(fwd, wide_k);
+                if (kmer::reverse_complement(rc, wide_k) != fwd) throw std::runtime_error("[wide k-mer] FAIL (reverse complement)");
+                if (not (*citr).value or *((*citr).value) != (rc < fwd ? rc : fwd)) throw std::runtime_error("[wide k-mer] FAIL (canonical)");
+            }
+        }
     }
     if (seq) kseq_destroy(seq);
     gzclose(fp);
@@ -8,15 +8,54 @@ extern "C" {
 }
 
 #include <string>
+#include <vector>
 #include <argparse/argparse.hpp>
 #include "../include/hash.hpp"
+#include "../include/kmer_view.hpp"
 #include "../include/minimizer_view.hpp"
+#include "../include/logtools.hpp"
 
 KSEQ_INIT(gzFile, gzread)
 
 typedef uint64_t kmer_t;
 typedef uint64_t mmer_t;
 
+struct reference_minimizer {
+    mmer_t value;
+    std::size_t position;
+};
+
+/*
+ * Rescan-based minimizers: the minimum of every window is recomputed from scratch.
+ */
+std::vector<reference_minimizer> rescan_minimizers(char const* seq, std::size_t len, uint8_t k, uint8_t m, uint64_t seed, bool canonical)
+{
+    struct mmer {
+        mmer_t value;
+        std::size_t position;
+        uint64_t hash;
+    };
+    std::vector<mmer> mmers;
+    auto mview = wrapper::kmer_view_from_cstr<mmer_t>(seq, len, m, canonical);
+    for (auto itr = mview.cbegin(); itr != mview.cend(); ++itr) {
+        auto ctx = *itr;
+        if (ctx.value) mmers.push_back({*ctx.value, ctx.position, hash::hash64::hash(*ctx.value, seed)});
+    }
+    std::vector<reference_minimizer> res;
+    const std::size_t w = k - m + 1;
+    std::size_t last = std::numeric_limits<std::size_t>::max();
+    for (std::size_t i = 0; i + w <= mmers.size(); ++i) {
+        if (mmers[i + w - 1].position - mmers[i].position != w - 1) continue; // window spanning a break
+        std::size_t min_idx = i;
+        for (std::size_t j = i + 1; j < i + w; ++j) if (mmers[j].hash < mmers[min_idx].hash) min_idx = j;
+        if (mmers[min_idx].position != last) {
+            res.push_back({mmers[min_idx].value, mmers[min_idx].position});
+            last = mmers[min_idx].position;
+        }
+    }
+    return res;
+}
+
 int main(int argc, char* argv[])
 {
     gzFile fp;
@@ -32,19 +71,44 @@ int main(int argc, char* argv[])
     if ((fp = gzopen(input_filename.c_str(), "r")) == NULL) throw std::runtime_error("Unable to open the input file " + input_filename + "\n");
     seq = kseq_init(fp);
 
-    volatile kmer_t dummy;
+    volatile mmer_t dummy = 0;
+    logging_tools::micro_timer timer;
+    std::size_t view_time = 0, rescan_time = 0;
 
     while (kseq_read(seq) >= 0) {
-        auto view = wrapper::minimizer_view_from_cstr<kmer_t, mmer_t, hash::hash64>(seq->seq.s, seq->seq.l, (uint8_t)15, (uint8_t)10, 42, false);
-        for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
-            auto val = *itr;
-            std::cerr << val.value << " | " << val.position << " | " << val.id << std::endl;
+        for (bool canonical : {false, true}) {
+            for (auto [k, m] : {std::pair<uint8_t, uint8_t>{15, 10}, {31, 7}, {31, 31}, {63, 15}}) {
+                timer.start();
+                auto expected = rescan_minimizers(seq->seq.s, seq->seq.l, k, m, 42, canonical);
+                rescan_time += timer.stop(false);
+
+                timer.start();
+                auto view = wrapper::minimizer_view_from_cstr<kmer_t, mmer_t, hash::hash64>(seq->seq.s, seq->seq.l, k, m, 42, canonical);
+                std::size_t i = 0;
+                for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
+                    auto const& val = *itr;
+                    if (i >= expected.size() or val.value != expected[i].value or val.position != expected[i].position) throw std::runtime_error("[minimizer view] FAIL");
+                    if (itr.kmer_start() > val.position or val.position + m > itr.kmer_start() + k) throw std::runtime_error("[minimizer view] FAIL (k-mer start)");
+                    dummy = dummy + val.value;
+                    ++i;
+                }
+                view_time += timer.stop(false);
+                if (i != expected.size()) throw std::runtime_error("[minimizer view] FAIL (number of minimizers)");
+
+                auto packed_view = wrapper::packed_minimizer_view_from_cstr<kmer_t, mmer_t, hash::hash64>(seq->seq.s, seq->seq.l, k, m, 42, canonical);
+                i = 0;
+                for (auto itr = packed_view.cbegin(); itr != packed_view.cend(); ++itr, ++i) {
+                    if (i >= expected.size() or (*itr).value != expected[i].value) throw std::runtime_error("[packed minimizer view] FAIL");
+                }
+                if (i != expected.size()) throw std::runtime_error("[packed minimizer view] FAIL (number of minimizers)");
+            }
         }
     }
     if (seq) kseq_destroy(seq);
     gzclose(fp);
 
+    std::cerr << "minimizer view: " << view_time << " us, rescan: " << rescan_time << " us\n";
     std::cerr << "Finish\n";
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+/**
+ * Rolling hash view test
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "../include/kmer_view.hpp"
+#include "../include/nthash_view.hpp"
+#include "../include/hash_sampler.hpp"
+#include "../include/minimizer_sampler.hpp"
+#include "../include/logtools.hpp"
+
+typedef uint64_t kmer_t;
+
+uint64_t direct_hash(std::string const& s, std::size_t start, uint8_t k, bool canonical)
+{
+    uint64_t forward = 0, reverse = 0;
+    for (std::size_t i = 0; i < k; ++i) {
+        auto c = constants::seq_nt4_table[static_cast<uint8_t>(s[start + i])];
+        forward ^= wrapper::nthash::rol(wrapper::nthash::seed_table[c], k - 1 - i);
+        reverse ^= wrapper::nthash::rol(wrapper::nthash::seed_table[3 ^ c], i);
+    }
+    return canonical ? forward + reverse : forward;
+}
+
+std::string reverse_complement(std::string const& s)
+{
+    std::string rc(s.rbegin(), s.rend());
+    for (auto& c : rc) {
+        auto code = constants::seq_nt4_table[static_cast<uint8_t>(c)];
+        if (code < 4) c = constants::bases[3 ^ code];
+    }
+    return rc;
+}
+
+int main()
+{
+    std::mt19937 gen(42);
+    std::string seq(100000, 'A');
+    for (auto& c : seq) c = "ACGTacgtN"[gen() % (gen() % 1000 ? 8 : 9)];
+    const std::string rc = reverse_complement(seq);
+
+    for (uint8_t k : {1, 15, 31, 64, 65, 100}) {
+        for (bool canonical : {false, true}) {
+            auto view = wrapper::nthash_view_from_string(seq, k, canonical);
+            auto packed_view = wrapper::packed_nthash_view_from_cstr(seq.c_str(), seq.size(), k, canonical);
+            auto pitr = packed_view.cbegin();
+            std::size_t count = 0;
+            for (auto itr = view.cbegin(); itr != view.cend(); ++itr, ++pitr) {
+                auto kmer = *itr;
+                if (pitr == packed_view.cend() or (*pitr).has_value() != kmer.has_value()) throw std::runtime_error("[packed ntHash view] FAIL");
+                if (not kmer) continue;
+                if ((*pitr)->hash != kmer->hash) throw std::runtime_error("[packed ntHash view] FAIL (hash)");
+                if (kmer->hash != direct_hash(seq, kmer->position, k, canonical)) throw std::runtime_error("[ntHash view] FAIL (rolling != direct)");
+                ++count;
+            }
+            if (pitr != packed_view.cend()) throw std::runtime_error("[packed ntHash view] FAIL (length)");
+            std::size_t expected = 0;
+            auto kview = wrapper::kmer_view_from_string<kmer_t>(seq, k < 32 ? k : 31, false);
+            for (auto itr = kview.cbegin(); k < 32 and itr != kview.cend(); ++itr) if ((*itr).value) ++expected;
+            if (k < 32 and count != expected) throw std::runtime_error("[ntHash view] FAIL (number of k-mers)");
+        }
+    }
+
+    { // canonical hashes do not depend on the strand
+        const uint8_t k = 31;
+        auto fview = wrapper::nthash_view_from_string(seq, k, true);
+        auto rview = wrapper::nthash_view_from_string(rc, k, true);
+        std::vector<uint64_t> rc_hashes(seq.size(), 0);
+        for (auto itr = rview.cbegin(); itr != rview.cend(); ++itr) if (*itr) rc_hashes[seq.size() - k - (*itr)->position] = (*itr)->hash;
+        for (auto itr = fview.cbegin(); itr != fview.cend(); ++itr) {
+            if (*itr and (*itr)->hash != rc_hashes[(*itr)->position]) throw std::runtime_error("[ntHash view] FAIL (canonical)");
+        }
+    }
+
+    { // samplers
+        const uint8_t k = 21;
+        auto view = wrapper::nthash_view_from_string(seq, k, true);
+        hash::rolling_hash64 hasher(k);
+        sampler::hash_sampler fracminhash(view.cbegin(), view.cend(), hasher, 0, 0.1);
+        std::size_t sampled = 0, total = 0;
+        for (auto itr = fracminhash.cbegin(); itr != fracminhash.cend(); ++itr) ++sampled;
+        for (auto itr = view.cbegin(); itr != view.cend(); ++itr) if (*itr) ++total;
+        double ratio = static_cast<double>(sampled) / total;
+        if (ratio < 0.08 or ratio > 0.12) throw std::runtime_error("[ntHash view] FAIL (FracMinHash sampling rate = " + std::to_string(ratio) + ")");
+
+        sampler::minimizer_sampler minimizers(view.cbegin(), view.cend(), hasher, 42, 10);
+        for (auto itr = minimizers.cbegin(); itr != minimizers.cend(); ++itr) {
+            if (*itr and (*itr)->hash != direct_hash(seq, (*itr)->position, k, true)) throw std::runtime_error("[ntHash view] FAIL (minimizer sampler)");
+        }
+    }
+
+    { // rolling vs. Murmur-hashing every k-mer
+        const uint8_t k = 31;
+        volatile uint64_t dummy = 0;
+        logging_tools::micro_timer timer;
+        timer.start();
+        auto kview = wrapper::kmer_view_from_string<kmer_t>(seq, k, true);
+        for (auto itr = kview.cbegin(); itr != kview.cend(); ++itr) if ((*itr).value) dummy = dummy + hash::hash64::hash(*(*itr).value, 42);
+        auto murmur_time = timer.stop(false);
+        timer.start();
+        auto view = wrapper::nthash_view_from_string(seq, k, true);
+        for (auto itr = view.cbegin(); itr != view.cend(); ++itr) if (*itr) dummy = dummy + (*itr)->hash;
+        auto rolling_time = timer.stop(false);
+        std::cerr << "k-mer view + murmur: " << murmur_time << " us, ntHash view: " << rolling_time << " us\n";
+    }
+
+    std::cerr << "PASS : ntHash view\n";
+    return 0;
+}
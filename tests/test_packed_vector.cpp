@@ -175,6 +175,14 @@ void check_packed_vector(size_t seed, size_t vector_size)
 
     for (std::size_t i = 0; i < vector_size; ++i) {
         assert(static_cast<T>(pv.at(i)) == check.at(i));
+        if (pv.get(i) != check.at(i)) throw std::runtime_error("[packed vector] FAIL (get)");
+    }
+    {
+        std::vector<uint64_t> unpacked(vector_size);
+        for (std::size_t from : {std::size_t(0), std::size_t(1), std::size_t(7), vector_size / 3}) {
+            pv.unpack(from, vector_size - from, unpacked.data());
+            for (std::size_t i = from; i < vector_size; ++i) if (unpacked[i - from] != check.at(i)) throw std::runtime_error("[packed vector] FAIL (unpack)");
+        }
     }
 
     {
@@ -0,0 +1,139 @@
+/**
+ * parallel driver test
+ */
+
+#include <zlib.h>
+extern "C" {
+    #include "kseq.h"
+}
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <argparse/argparse.hpp>
+#include "../include/hash.hpp"
+#include "../include/kmer_view.hpp"
+#include "../include/minimizer_view.hpp"
+#include "../include/parallel_driver.hpp"
+#include "../include/logtools.hpp"
+
+KSEQ_INIT(gzFile, gzread)
+
+typedef uint64_t kmer_t;
+typedef uint64_t mmer_t;
+typedef wrapper::parallel_minimizer_t<kmer_t, mmer_t, hash::hash64> minimizer_t;
+
+template <typename T>
+void check_same(std::vector<T> const& expected, std::vector<T> const& result, std::string const& name)
+{
+    if (expected.size() != result.size()) throw std::runtime_error("[" + name + "] FAIL (size)");
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i].value != result[i].value or expected[i].position != result[i].position or expected[i].id != result[i].id) {
+            throw std::runtime_error("[" + name + "] FAIL at " + std::to_string(i));
+        }
+    }
+}
+
+void check(std::string const& seq, std::size_t nthreads, std::size_t chunk_size, std::size_t& sequential_time, std::size_t& parallel_time)
+{
+    logging_tools::micro_timer timer;
+    wrapper::parallel_driver driver(seq.data(), seq.size(), nthreads, chunk_size);
+    for (bool canonical : {false, true}) {
+        for (auto [k, m] : {std::pair<uint8_t, uint8_t>{15, 10}, {31, 15}, {31, 31}}) {
+            { // k-mers
+                timer.start();
+                std::vector<wrapper::kmer_context_t<kmer_t>> expected;
+                auto view = wrapper::kmer_view_from_cstr<kmer_t>(seq.data(), seq.size(), k, canonical);
+                for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
+                    auto kmer = *itr;
+                    if (not kmer.value) continue;
+                    kmer.id = expected.size(); // ids are ranks among the valid k-mers
+                    expected.push_back(kmer);
+                }
+                sequential_time += timer.stop(false);
+
+                timer.start();
+                std::vector<wrapper::kmer_context_t<kmer_t>> ordered;
+                driver.for_each_kmer_ordered<kmer_t>(k, canonical, [&](wrapper::kmer_context_t<kmer_t> const& kmer) {ordered.push_back(kmer);});
+                parallel_time += timer.stop(false);
+                check_same(expected, ordered, "ordered k-mers");
+
+                std::vector<std::vector<wrapper::kmer_context_t<kmer_t>>> per_thread(driver.get_nthreads());
+                driver.for_each_kmer<kmer_t>(k, canonical, [&](std::size_t tid, wrapper::kmer_context_t<kmer_t> const& kmer) {per_thread.at(tid).push_back(kmer);});
+                std::vector<wrapper::kmer_context_t<kmer_t>> unordered;
+                for (auto const& v : per_thread) unordered.insert(unordered.end(), v.begin(), v.end());
+                std::sort(unordered.begin(), unordered.end(), [](auto const& a, auto const& b) {return a.position < b.position;});
+                check_same(expected, unordered, "unordered k-mers");
+            }
+            { // minimizers
+                timer.start();
+                std::vector<minimizer_t> expected;
+                auto view = wrapper::minimizer_view_from_cstr<kmer_t, mmer_t, hash::hash64>(seq.data(), seq.size(), k, m, 42, canonical);
+                for (auto itr = view.cbegin(); itr != view.cend(); ++itr) expected.push_back({(*itr).value, (*itr).position, (*itr).id});
+                sequential_time += timer.stop(false);
+
+                timer.start();
+                std::vector<minimizer_t> ordered;
+                driver.for_each_minimizer_ordered<kmer_t, mmer_t, hash::hash64>(k, m, 42, canonical, [&](minimizer_t const& mm) {ordered.push_back(mm);});
+                parallel_time += timer.stop(false);
+                check_same(expected, ordered, "ordered minimizers");
+
+                std::vector<std::vector<minimizer_t>> per_thread(driver.get_nthreads());
+                driver.for_each_minimizer<kmer_t, mmer_t, hash::hash64>(k, m, 42, canonical, [&](std::size_t tid, minimizer_t const& mm) {per_thread.at(tid).push_back(mm);});
+                std::vector<minimizer_t> unordered;
+                for (auto const& v : per_thread) unordered.insert(unordered.end(), v.begin(), v.end());
+                std::sort(unordered.begin(), unordered.end(), [](auto const& a, auto const& b) {return a.position < b.position;});
+                check_same(expected, unordered, "unordered minimizers");
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    gzFile fp;
+    kseq_t* seq;
+
+    argparse::ArgumentParser parser(argv[0]);
+    parser.add_argument("-i", "--input")
+        .help("input fasta file")
+        .required();
+    parser.add_argument("-t", "--threads")
+        .help("number of threads")
+        .scan<'d', std::size_t>()
+        .default_value(std::size_t(4));
+    parser.parse_args(argc, argv);
+    std::string input_filename = parser.get<std::string>("--input");
+    std::size_t nthreads = parser.get<std::size_t>("--threads");
+
+    std::size_t sequential_time = 0, parallel_time = 0;
+    std::string concatenated;
+    if ((fp = gzopen(input_filename.c_str(), "r")) == NULL) throw std::runtime_error("Unable to open the input file " + input_filename + "\n");
+    seq = kseq_init(fp);
+    while (kseq_read(seq) >= 0) {
+        std::string s(seq->seq.s, seq->seq.l);
+        check(s, nthreads, 1000, sequential_time, parallel_time);
+        concatenated += s;
+    }
+    if (seq) kseq_destroy(seq);
+    gzclose(fp);
+    check(concatenated, nthreads, 1 << 14, sequential_time, parallel_time);
+
+    { // random sequence with clusters of N's, tiny chunks so that breaks fall on chunk boundaries
+        std::mt19937_64 gen(42);
+        std::string random_seq(1 << 18, 'A');
+        for (auto& c : random_seq) c = "ACGT"[gen() % 4];
+        for (std::size_t i = 0; i < 200; ++i) {
+            auto p = gen() % random_seq.size();
+            auto len = gen() % 40;
+            for (std::size_t j = p; j < std::min(p + len, random_seq.size()); ++j) random_seq[j] = 'N';
+        }
+        check(random_seq, nthreads, 37, sequential_time, parallel_time);
+        check(random_seq.substr(0, 20), nthreads, 1, sequential_time, parallel_time); // shorter than some k
+    }
+
+    std::cerr << "sequential: " << sequential_time << " us, parallel (" << nthreads << " threads): " << parallel_time << " us\n";
+    std::cerr << "Finish\n";
+    return 0;
+}
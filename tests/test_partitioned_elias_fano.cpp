@@ -0,0 +1,187 @@
+/**
+ * partitioned Elias-Fano test (comparison with std::vector and bit::ef::array)
+ */
+
+#include <random>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "../include/elias_fano.hpp"
+#include "../include/partitioned_elias_fano.hpp"
+#include "../include/io.hpp"
+#include "../include/logtools.hpp"
+
+std::vector<std::size_t> get_uniform_sequence(std::mt19937_64& gen, std::size_t size, std::size_t max_delta);
+std::vector<std::size_t> get_clustered_sequence(std::mt19937_64& gen, std::size_t size);
+void check(std::mt19937_64& gen, std::vector<std::size_t> const& sequence, std::string const& name);
+void check_small_sequences();
+
+int main()
+{
+    std::mt19937_64 gen(42);
+    check(gen, get_uniform_sequence(gen, 1000000, 500), "uniform gaps");
+    check(gen, get_uniform_sequence(gen, 1000000, 3), "small gaps with duplicates");
+    check(gen, get_clustered_sequence(gen, 1000000), "clustered");
+    check_small_sequences();
+    std::cerr << "Everything is OK\n";
+    return 0;
+}
+
+std::vector<std::size_t> get_uniform_sequence(std::mt19937_64& gen, std::size_t size, std::size_t max_delta)
+{
+    std::uniform_int_distribution<std::size_t> distrib(0, max_delta);
+    std::vector<std::size_t> sequence;
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < size; ++i) sequence.push_back(sum += distrib(gen));
+    return sequence;
+}
+
+/*
+ * Posting-list-like sequence: dense clusters (runs, bitmaps) separated by long jumps and sparse stretches.
+ */
+std::vector<std::size_t> get_clustered_sequence(std::mt19937_64& gen, std::size_t size)
+{
+    std::vector<std::size_t> sequence;
+    std::size_t v = 0;
+    while (sequence.size() < size) {
+        v += gen() % (1 << 20);
+        std::size_t len = 1 + gen() % 5000;
+        switch (gen() % 3) {
+            case 0: for (std::size_t i = 0; i < len; ++i) sequence.push_back(++v); break; // consecutive
+            case 1: for (std::size_t i = 0; i < len; ++i) sequence.push_back(v += 1 + gen() % 3); break; // dense
+            default: for (std::size_t i = 0; i < len; ++i) sequence.push_back(v += gen() % 10000); // sparse
+        }
+    }
+    sequence.resize(size);
+    return sequence;
+}
+
+std::size_t expected_lower_bound(std::vector<std::size_t> const& sequence, std::size_t s)
+{
+    return std::lower_bound(sequence.begin(), sequence.end(), s) - sequence.begin();
+}
+
+std::size_t expected_upper_bound(std::vector<std::size_t> const& sequence, std::size_t s)
+{
+    return std::upper_bound(sequence.begin(), sequence.end(), s) - sequence.begin();
+}
+
+void check_find(bit::ef::partitioned_array const& pef, std::vector<std::size_t> const& sequence, std::size_t s)
+{
+    auto lb = expected_lower_bound(sequence, s);
+    std::size_t lt = lb - 1; // -1 if none
+    if (pef.lt_find(s) != lt) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (lt_find of " + std::to_string(s) + ")");
+    if (lb and pef.lt_find(s, true) != expected_lower_bound(sequence, sequence[lt])) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (lt_find ignoring duplicates)");
+    auto gt = expected_upper_bound(sequence, s);
+    if (pef.gt_find(s) != gt) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (gt_find of " + std::to_string(s) + ")");
+    if (gt != sequence.size() and pef.gt_find(s, true) != expected_upper_bound(sequence, sequence[gt]) - 1) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (gt_find ignoring duplicates)");
+}
+
+void check(std::mt19937_64& gen, std::vector<std::size_t> const& sequence, std::string const& name)
+{
+    logging_tools::micro_timer timer;
+    bit::ef::array ef(sequence.begin(), sequence.end());
+    timer.start();
+    bit::ef::partitioned_array pef(sequence.begin(), sequence.end());
+    auto build_time = timer.stop(false);
+    if (pef.size() != sequence.size()) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (size)");
+    if (pef.front() != sequence.front() or pef.back() != sequence.back()) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (front/back)");
+
+    for (std::size_t i = 0; i < sequence.size(); ++i) {
+        if (pef.at(i) != sequence[i]) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (at " + std::to_string(i) + ")");
+    }
+    {
+        std::size_t i = 0;
+        for (auto v : pef) if (v != sequence.at(i++)) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (iterator)");
+        if (i != sequence.size()) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (iterator end)");
+    }
+    {
+        auto itr = bit::ef::partitioned_array::const_iterator(pef, pef.size() - 1);
+        for (std::size_t i = 0; i < 10000; ++i, --itr) if (*itr != sequence[sequence.size() - 1 - i]) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (reverse iterator)");
+    }
+    for (std::size_t dummy = 0; dummy < 100; ++dummy) {
+        std::size_t i = gen() % sequence.size();
+        std::size_t j = std::min(sequence.size(), i + gen() % 5000);
+        auto stop = bit::ef::partitioned_array::const_iterator(pef, j);
+        if (stop - pef.cbegin() != static_cast<std::ptrdiff_t>(j)) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (iterator difference)");
+        for (auto itr = bit::ef::partitioned_array::const_iterator(pef, i); itr != stop; ++itr, ++i) {
+            if (*itr != sequence[i]) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (iterator from random position)");
+        }
+    }
+
+    for (std::size_t dummy = 0; dummy < 10000; ++dummy) {
+        check_find(pef, sequence, gen() % (sequence.back() + 2));
+        auto v = sequence[gen() % sequence.size()];
+        check_find(pef, sequence, v);
+        if (v) check_find(pef, sequence, v - 1);
+        check_find(pef, sequence, v + 1);
+    }
+
+    std::string sname = "tmp.pef.bin";
+    auto copy = pef;
+    io::store(copy, sname);
+    auto loaded = io::load<bit::ef::partitioned_array>(sname);
+    std::remove(sname.c_str());
+    if (loaded != pef) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (store/load)");
+
+    volatile std::size_t dummy = 0;
+    timer.start();
+    for (std::size_t i = 0; i < sequence.size(); ++i) dummy = dummy + ef.at(i);
+    auto ef_at_time = timer.stop(false);
+    timer.start();
+    for (std::size_t i = 0; i < sequence.size(); ++i) dummy = dummy + pef.at(i);
+    auto pef_at_time = timer.stop(false);
+    timer.start();
+    for (auto v : ef) dummy = dummy + v;
+    auto ef_scan_time = timer.stop(false);
+    timer.start();
+    for (auto v : pef) dummy = dummy + v;
+    auto pef_scan_time = timer.stop(false);
+
+    std::cerr << name << ": " << sequence.size() << " elements up to " << sequence.back() << "\n"
+              << "\tElias-Fano: " << static_cast<double>(ef.bit_size()) / sequence.size() << " bits/element, at " << ef_at_time << " us, scan " << ef_scan_time << " us\n"
+              << "\tpartitioned Elias-Fano: " << static_cast<double>(pef.bit_size()) / sequence.size() << " bits/element (" << pef.partitions() << " partitions), "
+              << "built in " << build_time << " us, at " << pef_at_time << " us, scan " << pef_scan_time << " us\n";
+}
+
+void check_small_sequences()
+{
+    std::vector<std::vector<std::size_t>> sequences = {
+        {0},
+        {7},
+        {0, 0, 0},
+        {1, 2, 3, 4, 5},
+        {0, 1, 2, 3, 4},
+        {2, 2, 2, 2, 2, 2, 6, 6, 6, 6, 6, 13, 13, 13, 13, 13, 13, 13}, // cumulative sequence of the bit::ef::array example
+        {std::numeric_limits<std::size_t>::max() - 1, std::numeric_limits<std::size_t>::max()}
+    };
+    std::vector<std::size_t> long_run;
+    for (std::size_t i = 0; i < 10 * bit::ef::partitioned_array::max_partition_size; ++i) long_run.push_back(i + 100);
+    sequences.push_back(long_run);
+    for (auto const& sequence : sequences) {
+        bit::ef::partitioned_array pef(sequence.begin(), sequence.size());
+        for (std::size_t i = 0; i < sequence.size(); ++i) if (pef.at(i) != sequence[i]) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (small sequence, at)");
+        for (auto v : sequence) {
+            check_find(pef, sequence, v);
+            if (v) check_find(pef, sequence, v - 1);
+            if (v != std::numeric_limits<std::size_t>::max()) check_find(pef, sequence, v + 1);
+        }
+    }
+    bit::ef::partitioned_array example(sequences[5].begin(), sequences[5].end());
+    if (example.lt_find(6) != 5 or example.gt_find(6) != 11 or example.lt_find(6, true) != 0 or example.gt_find(6, true) != 17) {
+        throw std::runtime_error("[Partitioned Elias-Fano] FAIL (simple example)");
+    }
+    bit::ef::partitioned_array empty(sequences[0].begin(), std::size_t(0));
+    if (empty.size() != 0 or empty.begin() != empty.end() or empty.gt_find(10) != 0) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (empty)");
+    if (empty != bit::ef::partitioned_array()) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (empty equality)");
+    std::vector<std::size_t> unsorted = {3, 1};
+    try {
+        bit::ef::partitioned_array bad(unsorted.begin(), unsorted.end());
+        throw std::logic_error("[Partitioned Elias-Fano] FAIL (unsorted sequence not detected)");
+    } catch (std::runtime_error const&) {}
+    bit::ef::partitioned_array long_pef(long_run.begin(), long_run.end());
+    if (long_pef.bit_size() > bit::ef::array(long_run.begin(), long_run.end()).bit_size()) throw std::runtime_error("[Partitioned Elias-Fano] FAIL (runs are not cheaper)");
+    std::cerr << "Small sequences OK\n";
+}
@@ -34,7 +34,7 @@ void check_vector_popcount(size_t seed, size_t vector_size, size_t insertions)
         bvec.set(rp);
     }
     uint8_t const * const plain_vec_view = reinterpret_cast<uint8_t const * const>(bvec.data());
-    std::vector<T> const& vec_vec_view = bvec.vector_data();
+    auto const& vec_vec_view = bvec.vector_data();
 
     // std::cerr << "nblocks = " << vec_vec_view.size() << "\n";
     auto popvecvec = bit::popcount(vec_vec_view, vec_vec_view.size());
@@ -3,16 +3,26 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <tuple>
 
 #include "../include/bit_vector.hpp"
 #include "../include/rank_select.hpp"
+#include "../include/rank_select_interleaved.hpp"
 #include "../include/io.hpp"
 
 #include "../include/constants.hpp"
 
-template <typename T, std::size_t, std::size_t, bool, bool>
+template <typename T, std::size_t, std::size_t, bool, bool, std::size_t = 0, std::size_t = 0>
 void check_rs(size_t, size_t, size_t);
+template <class RankSelect>
+void check_batches(RankSelect const&, std::size_t);
 int test_for(size_t insertions, size_t multiplier, size_t seed);
+void benchmark(std::size_t vector_size, std::size_t multiplier, std::size_t seed);
+template <bool, bool>
+void check_interleaved(bit::vector<uint64_t> const&);
+void check_interleaved_for(std::size_t vector_size, std::size_t multiplier, std::size_t seed);
+void benchmark_layouts(std::size_t vector_size, std::size_t multiplier, std::size_t seed);
+void benchmark_select_samples(std::size_t vector_size, std::size_t multiplier, std::size_t seed);
 
 int main()
 {
@@ -22,6 +32,15 @@ int main()
     if(!err) err = test_for(1000, 10, 42);
     if(!err) err = test_for(1000, 100, 42);
     if(!err) err = test_for(1000, 1000, 42); // very sparse
+    if(!err) benchmark(1 << 24, 2, 42);
+    if(!err) benchmark(1 << 24, 100, 42);
+    for (std::size_t multiplier : {1, 2, 10, 1000, 100000}) {
+        for (std::size_t vector_size : {0, 1, 384, 385, 448, 449, 1000000}) check_interleaved_for(vector_size, multiplier, 42);
+    }
+    if(!err) benchmark_layouts(1ULL << 28, 2, 42);
+    if(!err) benchmark_layouts(1ULL << 28, 50, 42);
+    if(!err) benchmark_select_samples(1ULL << 28, 2, 42);
+    if(!err) benchmark_select_samples(1ULL << 28, 50, 42);
     return err;
 }
 
@@ -55,14 +74,19 @@ int test_for(size_t insertions, size_t multiplier, size_t seed)
     check_rs<uint16_t, block_span_bit_size, super_block_block_size, false, false>(seed, binary_vector_size, insertions);
     check_rs<uint32_t, block_span_bit_size, super_block_block_size, false, false>(seed, binary_vector_size, insertions);
     check_rs<uint64_t, block_span_bit_size, super_block_block_size, false, false>(seed, binary_vector_size, insertions);
+    check_rs<uint16_t, 100, 3, true, true>(seed, binary_vector_size, insertions); // blocks spanning several words
+    check_rs<uint32_t, 64, 8, true, false>(seed, binary_vector_size, insertions);
     check_rs<uint64_t, 64, 8, false, false>(seed, binary_vector_size, insertions); // this should be faster since specialised
     check_rs<uint64_t, 64, 8, true, true>(seed, binary_vector_size, insertions); // this should be faster since specialised
+    check_rs<uint64_t, 64, 8, true, true, 64, 64>(seed, binary_vector_size, insertions); // select samples
+    check_rs<uint64_t, 64, 8, false, false, 1, 3>(seed, binary_vector_size, insertions);
+    check_rs<uint16_t, block_span_bit_size, super_block_block_size, false, true, 32, 7>(seed, binary_vector_size, insertions);
 
     std::cerr << "Everything is OK\n";
     return 0;
 }
 
-template <typename T, std::size_t bbs, std::size_t sbbs, bool with_select1_hints, bool with_select0_hints>
+template <typename T, std::size_t bbs, std::size_t sbbs, bool with_select1_hints, bool with_select0_hints, std::size_t select1_sample_rate, std::size_t select0_sample_rate>
 void check_rs(size_t seed, size_t vector_size, size_t insertions)
 {
     std::cerr << "----------------------------------------------------------------\n";
@@ -92,9 +116,9 @@ void check_rs(size_t seed, size_t vector_size, size_t insertions)
     // }
     // std::cerr << "\n";
 
-    bit::rs::array<decltype(bvec), bbs, sbbs, with_select1_hints, with_select0_hints> dummy(std::move(bvec));
+    bit::rs::array<decltype(bvec), bbs, sbbs, with_select1_hints, with_select0_hints, select1_sample_rate, select0_sample_rate> dummy(std::move(bvec));
     bvec.clear();
-    bit::rs::array<decltype(bvec), bbs, sbbs, with_select1_hints, with_select0_hints> rs_vec(std::move(bvec));
+    bit::rs::array<decltype(bvec), bbs, sbbs, with_select1_hints, with_select0_hints, select1_sample_rate, select0_sample_rate> rs_vec(std::move(bvec));
     {
         std::string sname = "tmp.bin";
         // auto copy = rs_vec;
@@ -128,6 +152,7 @@ void check_rs(size_t seed, size_t vector_size, size_t insertions)
         // std::cerr << "select [" << i << "] = " << idx << "(true answer = " << inserted.at(i) << ")\n";
         if (idx != inserted.at(i)) throw std::runtime_error("[select1] FAIL");
     }
+    check_batches(rs_vec, seed);
 
     {
         auto missing = vector_size - inserted.size();
@@ -146,4 +171,208 @@ void check_rs(size_t seed, size_t vector_size, size_t insertions)
     std::cerr << "rank/select size = " << rs_vec.bit_size() << "\n";
     std::cerr << "rank/select overhead = " << rs_vec.bit_overhead() << "\n";
     std::cerr << "****************************************************************\n";
-}
\ No newline at end of file
+}
+/*
+ * Batched queries (shorter and longer than the prefetch pipeline) must give the same answers as single queries.
+ */
+template <class RankSelect>
+void check_batches(RankSelect const& rs_vec, std::size_t seed)
+{
+    std::mt19937_64 gen(seed);
+    for (std::size_t n : {0, 5, 1000}) {
+        std::vector<std::size_t> positions, ranks, out(n);
+        for (std::size_t i = 0; i < n; ++i) positions.push_back(gen() % (rs_vec.size() + 1));
+        rs_vec.rank1_batch(positions.data(), out.data(), n);
+        for (std::size_t i = 0; i < n; ++i) if (out[i] != rs_vec.rank1(positions[i])) throw std::runtime_error("[rank1_batch] FAIL");
+        if (rs_vec.size1() == 0) continue;
+        for (std::size_t i = 0; i < n; ++i) ranks.push_back(gen() % rs_vec.size1());
+        rs_vec.select1_batch(ranks.data(), out.data(), n);
+        for (std::size_t i = 0; i < n; ++i) if (out[i] != rs_vec.select1(ranks[i])) throw std::runtime_error("[select1_batch] FAIL");
+    }
+}
+
+template <class RankSelect>
+std::tuple<std::size_t, std::size_t, std::size_t> time_queries(RankSelect const& rs_vec, std::vector<std::size_t> const& positions, std::vector<std::size_t> const& ranks)
+{
+    logging_tools::micro_timer timer;
+    std::size_t checksum = 0;
+    timer.start();
+    for (auto p : positions) checksum += rs_vec.rank1(p);
+    auto rank_time = timer.stop(false);
+    timer.start();
+    for (auto r : ranks) checksum += rs_vec.select1(r);
+    auto select_time = timer.stop(false);
+    return {rank_time, select_time, checksum};
+}
+
+/*
+ * The generic array (here with blocks of 128 bits over 64-bit words and with 32-bit words) must stay 
+ * within a small factor of the specialisation for 64-bit words.
+ */
+void benchmark(std::size_t vector_size, std::size_t multiplier, std::size_t seed)
+{
+    const std::size_t nqueries = 1000000;
+    std::mt19937_64 gen(seed);
+    bit::vector<uint64_t> bv64(vector_size, false);
+    bit::vector<uint32_t> bv32(vector_size, false);
+    for (std::size_t i = 0; i < vector_size / multiplier; ++i) {
+        auto p = gen() % vector_size;
+        bv64.set(p);
+        bv32.set(p);
+    }
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, true, true> specialised(bit::vector<uint64_t>{bv64});
+    bit::rs::array<bit::vector<uint64_t>, 128, 4, true, true> generic64(std::move(bv64));
+    bit::rs::array<bit::vector<uint32_t>, 64, 8, true, true> generic32(std::move(bv32));
+    std::vector<std::size_t> positions, ranks;
+    for (std::size_t i = 0; i < nqueries; ++i) {
+        positions.push_back(gen() % vector_size);
+        ranks.push_back(gen() % specialised.size1());
+    }
+    auto [srank, sselect, schecksum] = time_queries(specialised, positions, ranks);
+    auto [grank64, gselect64, gchecksum64] = time_queries(generic64, positions, ranks);
+    auto [grank32, gselect32, gchecksum32] = time_queries(generic32, positions, ranks);
+    if (schecksum != gchecksum64 or schecksum != gchecksum32) throw std::runtime_error("[benchmark] FAIL (different answers)");
+    std::cerr << "1 bit every " << multiplier << ", " << nqueries << " queries:\n";
+    std::cerr << "\trank1:   specialised " << srank << " us, generic (64-bit words) " << grank64 << " us, generic (32-bit words) " << grank32 << " us\n";
+    std::cerr << "\tselect1: specialised " << sselect << " us, generic (64-bit words) " << gselect64 << " us, generic (32-bit words) " << gselect32 << " us\n";
+}
+
+template <bool with_select1_hints, bool with_select0_hints>
+void check_interleaved(bit::vector<uint64_t> const& bvec)
+{
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, false, false> reference(bit::vector<uint64_t>{bvec});
+    bit::rs::interleaved_array<with_select1_hints, with_select0_hints> rs_vec(bvec);
+    {
+        std::string sname = "tmp.bin";
+        io::store(rs_vec, sname);
+        if (io::load<decltype(rs_vec)>(sname) != rs_vec) throw std::runtime_error("[interleaved] FAIL (store/load)");
+        std::remove(sname.c_str());
+    }
+    if (rs_vec.size() != bvec.size() or rs_vec.size1() != reference.size1()) throw std::runtime_error("[interleaved] FAIL (size1)");
+    for (std::size_t i = 0; i <= rs_vec.size(); ++i) {
+        if (rs_vec.rank1(i) != reference.rank1(i)) throw std::runtime_error("[interleaved] FAIL (rank1)");
+        if (i < rs_vec.size() and rs_vec.at(i) != bvec.at(i)) throw std::runtime_error("[interleaved] FAIL (at)");
+    }
+    for (std::size_t i = 0; i < rs_vec.size1(); ++i) {
+        if (rs_vec.select1(i) != reference.select1(i)) throw std::runtime_error("[interleaved] FAIL (select1)");
+    }
+    for (std::size_t i = 0; i < rs_vec.size0(); ++i) {
+        if (rs_vec.select0(i) != reference.select0(i)) throw std::runtime_error("[interleaved] FAIL (select0)");
+    }
+    check_batches(rs_vec, 42);
+}
+
+void check_interleaved_for(std::size_t vector_size, std::size_t multiplier, std::size_t seed)
+{
+    std::mt19937_64 gen(seed);
+    bit::vector<uint64_t> bvec(vector_size, false);
+    for (std::size_t i = 0; i < vector_size; ++i) if (gen() % multiplier == 0) bvec.set(i);
+    check_interleaved<true, true>(bvec);
+    check_interleaved<false, false>(bvec);
+    if (multiplier == 1) { // dense vector built by resize
+        bit::vector<uint64_t> ones(vector_size, true);
+        for (std::size_t i = 0; i < vector_size; i += 3) ones.clear(i);
+        check_interleaved<true, true>(ones);
+    }
+}
+
+/*
+ * Random queries on a vector much larger than the caches: counters and payload of the interleaved layout share 
+ * the same cache line.
+ */
+void benchmark_layouts(std::size_t vector_size, std::size_t multiplier, std::size_t seed)
+{
+    const std::size_t nqueries = 1000000;
+    std::mt19937_64 gen(seed);
+    bit::vector<uint64_t> bvec(vector_size, false);
+    for (std::size_t i = 0; i < vector_size / multiplier; ++i) bvec.set(gen() % vector_size);
+    bit::rs::interleaved_array<true, true> interleaved(bvec);
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, true, true> specialised(std::move(bvec));
+    std::vector<std::size_t> positions, ranks;
+    for (std::size_t i = 0; i < nqueries; ++i) {
+        positions.push_back(gen() % vector_size);
+        ranks.push_back(gen() % specialised.size1());
+    }
+    auto [srank, sselect, schecksum] = time_queries(specialised, positions, ranks);
+    auto [irank, iselect, ichecksum] = time_queries(interleaved, positions, ranks);
+    if (schecksum != ichecksum) throw std::runtime_error("[benchmark] FAIL (different answers)");
+    auto dependent_rank = [&](auto const& rs_vec) { // latency-bound: each query depends on the previous answer
+        logging_tools::micro_timer timer;
+        std::size_t prev = 0;
+        timer.start();
+        for (auto p : positions) prev = rs_vec.rank1((p + prev) % rs_vec.size());
+        return std::make_pair(timer.stop(false), prev);
+    };
+    auto dependent_select = [&](auto const& rs_vec) {
+        logging_tools::micro_timer timer;
+        std::size_t prev = 0;
+        timer.start();
+        for (auto r : ranks) prev = rs_vec.select1((r + prev) % rs_vec.size1());
+        return std::make_pair(timer.stop(false), prev);
+    };
+    auto [sdep, slast] = dependent_rank(specialised);
+    auto [idep, ilast] = dependent_rank(interleaved);
+    if (slast != ilast) throw std::runtime_error("[benchmark] FAIL (different answers)");
+    auto [sdeps, slasts] = dependent_select(specialised);
+    auto [ideps, ilasts] = dependent_select(interleaved);
+    if (slasts != ilasts) throw std::runtime_error("[benchmark] FAIL (different answers)");
+    std::cerr << vector_size << " bits, " << nqueries << " queries:\n";
+    std::cerr << "\trank1:   specialised " << srank << " us, interleaved " << irank << " us\n";
+    std::cerr << "\tdependent rank1: specialised " << sdep << " us, interleaved " << idep << " us\n";
+    std::cerr << "\tselect1: specialised " << sselect << " us, interleaved " << iselect << " us\n";
+    std::cerr << "\tdependent select1: specialised " << sdeps << " us, interleaved " << ideps << " us\n";
+    std::cerr << "\toverhead: specialised " << specialised.bit_overhead() << " bits, interleaved " << interleaved.bit_overhead() << " bits\n";
+
+    auto batched = [&](auto const& rs_vec) { // same queries, answered by rank1_batch/select1_batch
+        logging_tools::micro_timer timer;
+        std::vector<std::size_t> out(nqueries);
+        std::size_t checksum = 0;
+        timer.start();
+        rs_vec.rank1_batch(positions.data(), out.data(), nqueries);
+        auto rank_time = timer.stop(false);
+        for (auto r : out) checksum += r;
+        timer.start();
+        rs_vec.select1_batch(ranks.data(), out.data(), nqueries);
+        auto select_time = timer.stop(false);
+        for (auto r : out) checksum += r;
+        return std::make_tuple(rank_time, select_time, checksum);
+    };
+    auto [sbrank, sbselect, sbchecksum] = batched(specialised);
+    auto [ibrank, ibselect, ibchecksum] = batched(interleaved);
+    if (sbchecksum != schecksum or ibchecksum != schecksum) throw std::runtime_error("[benchmark] FAIL (different batch answers)");
+    std::cerr << "\tbatched rank1:   specialised " << sbrank << " us, interleaved " << ibrank << " us\n";
+    std::cerr << "\tbatched select1: specialised " << sbselect << " us, interleaved " << ibselect << " us\n";
+}
+
+template <class RankSelect>
+void time_select(RankSelect const& rs_vec, std::vector<std::size_t> const& ranks, std::string const& name)
+{
+    logging_tools::micro_timer timer;
+    std::size_t checksum = 0;
+    timer.start();
+    for (auto r : ranks) checksum += rs_vec.select1(r);
+    auto select_time = timer.stop(false);
+    std::cerr << "\t" << name << ": select1 " << select_time << " us, overhead " << static_cast<double>(rs_vec.bit_overhead()) / rs_vec.size() << " bits/bit (" << checksum << ")\n";
+}
+
+/*
+ * Space/time trade-off of the select samples (64-bit specialisation).
+ */
+void benchmark_select_samples(std::size_t vector_size, std::size_t multiplier, std::size_t seed)
+{
+    const std::size_t nqueries = 1000000;
+    std::mt19937_64 gen(seed);
+    bit::vector<uint64_t> bvec(vector_size, false);
+    for (std::size_t i = 0; i < vector_size / multiplier; ++i) bvec.set(gen() % vector_size);
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, true, false> hints(bit::vector<uint64_t>{bvec});
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, false, false, 64> samples64(bit::vector<uint64_t>{bvec});
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, false, false, 256> samples256(bit::vector<uint64_t>{bvec});
+    bit::rs::array<bit::vector<uint64_t>, 64, 8, false, false, 1024> samples1024(std::move(bvec));
+    std::vector<std::size_t> ranks;
+    for (std::size_t i = 0; i < nqueries; ++i) ranks.push_back(gen() % hints.size1());
+    std::cerr << vector_size << " bits, 1 bit every " << multiplier << ", " << nqueries << " queries:\n";
+    time_select(hints, ranks, "hints");
+    time_select(samples64, ranks, "samples every 64 ones");
+    time_select(samples256, ranks, "samples every 256 ones");
+    time_select(samples1024, ranks, "samples every 1024 ones");
+}
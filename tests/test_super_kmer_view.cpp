@@ -1,5 +1,5 @@
-/* 
- * super-k-mer view test and comparison to C version
+/*
+ * super-k-mer view and partitioner test
  */
 
 #include <zlib.h>
@@ -8,30 +8,107 @@ extern "C" {
 }
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include <argparse/argparse.hpp>
-#include "../include/super_kmer_view.hpp"
 #include "../include/hash.hpp"
+#include "../include/kmer_view.hpp"
+#include "../include/super_kmer_view.hpp"
+#include "../include/super_kmer_partitioner.hpp"
 
 KSEQ_INIT(gzFile, gzread)
 
 typedef __uint128_t kmer_t;
 typedef uint64_t mm_t;
 
-int main(int argc, char *argv[]) 
+int main(int argc, char *argv[])
 {
     gzFile fp;
     kseq_t* seq;
-    std::string input_filename;
-    uint8_t k, m;
+
+    argparse::ArgumentParser parser(argv[0]);
+    parser.add_argument("-i", "--input")
+        .help("input fasta file")
+        .required();
+    parser.add_argument("-d", "--tmp-dir")
+        .help("temporary directory for the partitioner buckets")
+        .default_value(std::string("."));
+    parser.parse_args(argc, argv);
+    std::string input_filename = parser.get<std::string>("--input");
+    std::string tmp_dir = parser.get<std::string>("--tmp-dir");
+
+    const uint8_t k = 31, m = 15;
+    const uint64_t seed = 42;
+    const std::size_t nbuckets = 16;
+    std::vector<std::string> expected_super_kmers;
+    partition::super_kmer_partitioner<kmer_t, mm_t, hash::hash64> partitioner(tmp_dir, "skv_test", nbuckets, k, m, seed, true, 4096);
 
     if ((fp = gzopen(input_filename.c_str(), "r")) == NULL) throw std::runtime_error("Unable to open the input file " + input_filename + "\n");
     seq = kseq_init(fp);
     while (kseq_read(seq) >= 0) {
-        wrapper::super_kmer_view<kmer_t, mm_t, hash::hash64> view(seq->seq.s, seq->seq.l, k, m, false);
-        for (auto itr = view.cbegin(); itr != view.cend(); ++itr) {
-            // TODO
+        for (bool canonical : {false, true}) {
+            std::vector<std::size_t> kmer_positions;
+            auto kview = wrapper::kmer_view_from_cstr<kmer_t>(seq->seq.s, seq->seq.l, k, canonical);
+            for (auto itr = kview.cbegin(); itr != kview.cend(); ++itr) if ((*itr).value) kmer_positions.push_back((*itr).position);
+
+            std::size_t nkmers = 0;
+            auto view = wrapper::super_kmer_view_from_cstr<kmer_t, mm_t, hash::hash64>(seq->seq.s, seq->seq.l, k, m, seed, canonical);
+            auto packed_view = wrapper::packed_super_kmer_view_from_cstr<kmer_t, mm_t, hash::hash64>(seq->seq.s, seq->seq.l, k, m, seed, canonical);
+            auto pitr = packed_view.cbegin();
+            for (auto itr = view.cbegin(); itr != view.cend(); ++itr, ++pitr) {
+                auto const& sk = *itr;
+                if (sk.length < k) throw std::runtime_error("[super-k-mer view] FAIL (too short)");
+                // super-k-mers tile the valid k-mers in order
+                for (std::size_t i = 0; i < sk.length - k + 1; ++i, ++nkmers) {
+                    if (nkmers >= kmer_positions.size() or kmer_positions[nkmers] != sk.start + i) throw std::runtime_error("[super-k-mer view] FAIL (k-mer coverage)");
+                }
+                // the minimizer is shared by all the k-mers of the super-k-mer
+                if (sk.minimizer_position < sk.start or sk.minimizer_position + m > sk.start + k) throw std::runtime_error("[super-k-mer view] FAIL (minimizer position)");
+                auto first_window = wrapper::minimizer_view_from_cstr<kmer_t, mm_t, hash::hash64>(seq->seq.s + sk.start, k, k, m, seed, canonical);
+                auto last_window = wrapper::minimizer_view_from_cstr<kmer_t, mm_t, hash::hash64>(seq->seq.s + sk.start + sk.length - k, k, k, m, seed, canonical);
+                if ((*first_window.cbegin()).value != sk.minimizer or (*last_window.cbegin()).value != sk.minimizer) throw std::runtime_error("[super-k-mer view] FAIL (minimizer)");
+                if (pitr == packed_view.cend() or (*pitr).start != sk.start or (*pitr).length != sk.length or (*pitr).minimizer != sk.minimizer) throw std::runtime_error("[packed super-k-mer view] FAIL");
+                if (canonical) expected_super_kmers.emplace_back(seq->seq.s + sk.start, sk.length);
+            }
+            if (pitr != packed_view.cend()) throw std::runtime_error("[packed super-k-mer view] FAIL (number of super-k-mers)");
+            if (nkmers != kmer_positions.size()) throw std::runtime_error("[super-k-mer view] FAIL (number of k-mers)");
         }
+        partitioner.add(seq->seq.s, seq->seq.l);
     }
     if (seq) kseq_destroy(seq);
     gzclose(fp);
-}
\ No newline at end of file
+
+    partitioner.flush();
+    std::vector<std::string> partitioned_super_kmers;
+    std::unordered_map<mm_t, std::size_t> minimizer_buckets; // k-mer counting relies on each minimizer having a single bucket
+    std::size_t total = 0;
+    for (std::size_t b = 0; b < partitioner.nbuckets(); ++b) {
+        partition::bucket_reader reader(partitioner.bucket_filename(b));
+        std::string sk;
+        std::size_t count = 0;
+        while (reader.next(sk)) {
+            if (sk.size() < k) throw std::runtime_error("[super-k-mer partitioner] FAIL (too short)");
+            auto first_window = wrapper::minimizer_view_from_cstr<kmer_t, mm_t, hash::hash64>(sk.c_str(), k, k, m, seed, true);
+            auto last_window = wrapper::minimizer_view_from_cstr<kmer_t, mm_t, hash::hash64>(sk.c_str() + sk.size() - k, k, k, m, seed, true);
+            const mm_t minimizer = (*first_window.cbegin()).value;
+            if ((*last_window.cbegin()).value != minimizer) throw std::runtime_error("[super-k-mer partitioner] FAIL (minimizer of the record)");
+            if (partitioner.bucket_of(minimizer) != b) throw std::runtime_error("[super-k-mer partitioner] FAIL (wrong bucket)");
+            auto [mitr, inserted] = minimizer_buckets.emplace(minimizer, b);
+            if (not inserted and mitr->second != b) throw std::runtime_error("[super-k-mer partitioner] FAIL (minimizer in two buckets)");
+            partitioned_super_kmers.push_back(sk);
+            ++count;
+        }
+        if (count != partitioner.size(b)) throw std::runtime_error("[super-k-mer partitioner] FAIL (bucket size)");
+        total += count;
+    }
+    for (auto& sk : expected_super_kmers) std::transform(sk.begin(), sk.end(), sk.begin(), ::toupper);
+    std::sort(expected_super_kmers.begin(), expected_super_kmers.end());
+    std::sort(partitioned_super_kmers.begin(), partitioned_super_kmers.end());
+    if (expected_super_kmers != partitioned_super_kmers) throw std::runtime_error("[super-k-mer partitioner] FAIL (round trip)");
+    partitioner.remove_files();
+
+    std::cerr << total << " super-k-mers in " << partitioner.nbuckets() << " buckets\n";
+    std::cerr << "Finish\n";
+    return 0;
+}